@@ -0,0 +1,85 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <stdint.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <opencv4/opencv2/core.hpp>
+
+#define DEFAULT_POOL_IDLE_BYTES (256u << 20) // Idle bytes kept for reuse, least recently returned buffers go first
+
+struct BufferStats
+{
+    uint64_t hits;     // Requests served with an idle buffer
+    uint64_t misses;   // Requests which had to allocate
+    uint64_t evicted;  // Idle buffers freed to stay under the idle limit
+    size_t bytesInUse; // Handed out and not yet returned
+    size_t bytesIdle;  // Kept for reuse
+    size_t peakBytes;  // Highest bytesInUse + bytesIdle, the pool's memory footprint
+};
+
+/**
+ * @brief Recycles pixel and encoded byte buffers across requests.
+ * @details Image buffers are handed out through OpenCV's allocator hook: a
+ *          cv::Mat from acquire() draws its storage from the pool the first
+ *          time any OpenCV call creates it, and returns it when the last
+ *          reference is released, however far the matrix travelled. Idle
+ *          buffers are keyed by byte size (size times the type's element
+ *          size), so every frame of a given geometry reuses the same storage.
+ *          Byte buffers work the same way for encoders writing into a
+ *          std::vector: their capacity is kept while they are idle.
+ *
+ *          Once warm, a steady stream of same-sized requests allocates no
+ *          pixel or payload memory. The pool must outlive every buffer it
+ *          handed out.
+ */
+class BufferPool : public cv::MatAllocator
+{
+public:
+    // Constructors
+    BufferPool() : BufferPool(DEFAULT_POOL_IDLE_BYTES) {};
+    BufferPool(size_t idleLimit);
+
+    // Deconstructor
+    ~BufferPool();
+
+    // Mutators
+    cv::Mat acquire();                        // Empty matrix, allocates from the pool once created
+    cv::Mat acquire(cv::Size size, int type); // Matrix already holding a pooled buffer
+    std::shared_ptr<std::vector<uint8_t>> acquireBytes(size_t capacity); // Empty vector with at least this capacity
+    void trim();                              // Frees every idle buffer
+
+    // Accessors
+    size_t getIdleLimit() const { return this->idleLimit; }
+    BufferStats getStats();
+
+    // cv::MatAllocator
+    cv::UMatData *allocate(int dims, const int *sizes, int type, void *data, size_t *step, cv::AccessFlag flags,
+                           cv::UMatUsageFlags usage) const override;
+    bool allocate(cv::UMatData *data, cv::AccessFlag flags, cv::UMatUsageFlags usage) const override;
+    void deallocate(cv::UMatData *data) const override;
+
+private:
+    struct Idle
+    {
+        uint8_t *pixels;                             // Image storage, from cv::fastMalloc
+        std::unique_ptr<std::vector<uint8_t>> bytes; // Byte buffer
+        uint64_t returned;                           // Recency stamp for eviction
+    };
+
+    size_t idleLimit;
+
+    // Everything below is guarded by mutex, allocator callbacks are const
+    mutable std::mutex mutex;
+    mutable std::multimap<size_t, Idle> images;  // By byte size
+    mutable std::multimap<size_t, Idle> vectors; // By capacity
+    mutable uint64_t returns;
+    mutable BufferStats stats;
+
+    void release(std::multimap<size_t, Idle> &idle, size_t size, Idle buffer) const;
+    void evict() const;
+    void freeIdle(Idle &buffer) const;
+};
+#endif
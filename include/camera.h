@@ -7,6 +7,8 @@
 #include <iomanip>
 #include <format>
 #include <openssl/evp.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
 #include <nlohmann/json.hpp>
 #include <opencv4/opencv2/core.hpp>
 #include <opencv4/opencv2/imgproc.hpp>
@@ -54,6 +56,10 @@ enum SatColor
     BLUE
 };
 
+// Set by the server in the frame count when it honours a "pipeline" request:
+// frames then arrive back-to-back and are acknowledged once per batch
+#define PIPELINE_ACCEPTED 0x40000000
+
 
 bool checkHashJSON( nlohmann::json, std::string="" );
 
@@ -143,6 +149,26 @@ int countChar( const std::string& input, char delim );
 //     return camHeader;
 // }
 
+/**
+ * @brief Writes every byte described by an iovec array to a blocking socket.
+ * @param fd The connected socket to write to.
+ * @param iov The buffers to send, in order. Entries are advanced in place on partial writes.
+ * @param count The number of entries in iov.
+ * @return true if every byte was written, false if the socket failed or closed.
+ * @details Header fields and payload are gathered into as few writev() calls as
+ * the kernel allows; the call loops on partial writes and EINTR.
+ */
+bool sendAll(int fd, iovec *iov, int count);
+
+/**
+ * @brief Reads exactly 'size' bytes from a blocking socket.
+ * @param fd The connected socket to read from.
+ * @param buffer Destination for the received bytes.
+ * @param size The number of bytes to receive.
+ * @return true if every byte was received, false if the socket failed or closed first.
+ */
+bool recvAll(int fd, void *buffer, size_t size);
+
 /**
  * @brief Generates and returns the MD5 Checksum
  * @param string: The string to return the hash of
@@ -0,0 +1,94 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+#include <opencv4/opencv2/core.hpp>
+#include <opencv4/opencv2/videoio.hpp>
+
+#include "v4l2-device.h"
+
+#define DEFAULT_CAPTURE_DEVICE 0
+#define DEFAULT_RING_SLOTS 4
+#define CAPTURE_POLL_MS 100 // Longest wait on a V4L2 device before released buffers are handed back
+
+/**
+ * @brief Long-lived capture subsystem which owns the camera device.
+ * @details A single background thread continuously grabs frames from the
+ *          device into a fixed ring of pre-allocated cv::Mat slots. Readers
+ *          copy the most recently published slot out without ever touching
+ *          the device, so any number of clients share one capture stream.
+ *
+ *          With a V4L2 source (setSource) the slots are the driver's mmap
+ *          buffers themselves: a buffer is handed back to the driver once it is
+ *          neither the newest frame nor pinned by a reader, and readers convert
+ *          straight out of it (see convertCapture). Either way a reader only
+ *          copies or converts the region it asks for.
+ */
+class CameraCapture
+{
+public:
+    // Constructors
+    CameraCapture() : device(DEFAULT_CAPTURE_DEVICE), format{}, ring(DEFAULT_RING_SLOTS), head(0), generation(0), running(false), opened(false) {};
+    CameraCapture(int device, size_t slots) : device(device), format{}, ring(slots < 3 ? 3 : slots), head(0), generation(0), running(false), opened(false) {};
+
+    // Deconstructor
+    ~CameraCapture();
+
+    // Mutators
+    bool start(); // Open device and launch capture thread
+    void stop();  // Stop capture thread and release device
+    void setSource(const std::string &path, const CaptureFormat &format); // Capture from a V4L2 device instead of VideoCapture
+
+    // Accessors
+    uint64_t latestFrame(cv::Mat &out, const cv::Rect &roi = cv::Rect());  // Copy newest frame (or a region of it), returns its generation
+    uint64_t waitNextFrame(uint64_t after, cv::Mat &out, std::chrono::milliseconds timeout, const cv::Rect &roi = cv::Rect()); // Block for a frame newer than 'after'
+
+    uint64_t getGeneration() const { return this->generation.load(); }
+    cv::Size getFrameSize() const { return this->frameSize; } // Geometry of every frame, valid once started
+    const CaptureFormat &getFormat() const { return this->format; } // Negotiated V4L2 format, pixelFormat 0 for VideoCapture
+    bool isOpened() const { return this->opened.load(); }
+    bool isRunning() const { return this->running.load(); }
+
+private:
+    struct Slot
+    {
+        cv::Mat frame;      // BGR frame, or the raw view of a V4L2 buffer
+        uint64_t generation;
+        int readers;
+        bool queued;        // V4L2 buffer owned by the driver
+    };
+
+    int device;
+    cv::VideoCapture cap;
+    std::string source;     // V4L2 device path, empty: cv::VideoCapture on 'device'
+    CaptureFormat format;
+    V4l2Device v4l2;
+    cv::Size frameSize;
+
+    std::vector<Slot> ring;
+    size_t head;                  // Index of the most recently published slot
+    std::atomic<uint64_t> generation;
+    std::mutex ringMutex;
+    std::condition_variable frameReady;
+    std::condition_variable slotFreed;
+
+    std::atomic<bool> running;
+    std::atomic<bool> opened;
+    std::thread worker;
+
+    bool openCapture();
+    bool openDevice();
+    void captureLoop();
+    void deviceLoop();
+    size_t acquireWriteSlot();
+    uint64_t copySlot(size_t index, cv::Mat &out, const cv::Rect &roi, std::unique_lock<std::mutex> &lock);
+};
+#endif
@@ -13,7 +13,14 @@
 #include <netinet/in.h>
 #include <unistd.h>
 #include <array>
+#include <poll.h>
+#include <chrono>
 #include "camera.h"
+#include "protocol.h"
+#include "multicast.h"
+#include "denoise.h"
+#include "image-kernels.h"
+#include "lossless-codec.h"
 
 /** TODO List: Client
  *  TODO: Create Finite State Machine to keep track of which stage application is in
@@ -34,6 +41,9 @@
 
 
 
+#define MCAST_RECV_TIMEOUT_MS 200 // No chunk of a pending frame for this long before missing chunks are NACKed
+#define MCAST_REQUEST_TIMEOUT_MS 5000 // Longest a multicast request waits for its frames, whatever else the group carries
+
 enum state
 {
     IDLE_STAGE, // Idle Stage, wait for call from user
@@ -46,17 +56,40 @@ class Client
 {
 public:
     // Constructor
-    Client() : serverAddr("255.255.255.255"), serverPort(39554), state(IDLE_STAGE), clientSocket(socket(AF_INET, SOCK_STREAM, 0)) {};
-    Client(int port) : serverAddr("255.255.255.255"), serverPort(port), state(IDLE_STAGE), clientSocket(socket(AF_INET, SOCK_STREAM, 0)) {};
+    Client() : serverAddr("255.255.255.255"), serverPort(39554), state(IDLE_STAGE), clientSocket(socket(AF_INET, SOCK_STREAM, 0)), sequence(0), lastRequest(0), mcastSocket(-1), streamRequest(0), subscribed(false), planes(false), lossless(false), denoise(-1), region{}, delivered{}, delta(false), keyframe(false) {};
+    Client(int port) : serverAddr("255.255.255.255"), serverPort(port), state(IDLE_STAGE), clientSocket(socket(AF_INET, SOCK_STREAM, 0)), sequence(0), lastRequest(0), mcastSocket(-1), streamRequest(0), subscribed(false), planes(false), lossless(false), denoise(-1), region{}, delivered{}, delta(false), keyframe(false) {};
 
     // Deconstructor
     ~Client();
     
     // Mutators
     void connectToServer();
+    void disconnect();      // Close the session, connectToServer() may be called again
 
-    void sendRequestSrv();
+    void sendRequestSrv(const std::vector<int> &colors = {SatColor::RED, SatColor::GREEN, SatColor::BLUE});
+    std::vector<cv::Mat> requestFrames(const std::vector<int> &colors = {SatColor::RED, SatColor::GREEN, SatColor::BLUE});
+    std::vector<cv::Mat> requestMatrices(const std::vector<ColorMatrix> &matrices);
     std::vector<cv::Mat> recvFrames();
+    std::vector<cv::Mat> requestMulticast(const std::vector<int> &colors = {SatColor::RED, SatColor::GREEN, SatColor::BLUE});
+
+    // Streaming subscription
+    void subscribe(int fps, const std::vector<int> &colors = {SatColor::RED, SatColor::GREEN, SatColor::BLUE});
+    std::vector<cv::Mat> nextStreamFrames(StreamStatus &status); // Blocks for the next pushed frame set
+    StreamStatus unsubscribe();                                  // Final delivered/dropped counts
+    nlohmann::json sendControl(const nlohmann::json &message);
+
+    // Plane transport: single-band frames travel as one 8-bit plane and are re-tinted here
+    void setPlaneTransport(bool enabled) { this->planes = enabled; }
+    void setLosslessCodec(bool enabled) { this->lossless = enabled; } // Accept the native lossless codec in place of PNG
+    void setDenoise(DenoiseMode mode) { this->denoise = mode; } // Quality/latency of the server's denoise, its default otherwise
+    void setRegion(int x, int y, int width = 0, int height = 0, double scale = 1.0); // Crop/downscale of later requests
+    void clearRegion() { this->region = RegionInfo{}; }                               // Back to full frames
+    RegionInfo getDeliveredRegion() const { return this->delivered; } // Geometry of the last frames received, scale 0 if full
+    void setDeltaTransport(bool enabled);                   // Let the server send changes against the last frames received
+    void requestKeyframe() { this->keyframe = true; }       // Next request is answered with full frames
+    static cv::Mat expandPlane(const cv::Mat &plane, uint8_t channels);  // Gray plane onto CHANNEL_* bits of a BGR image
+    static cv::Mat compositeFrames(const std::vector<cv::Mat> &frames);  // Saturating sum, e.g. R + G + B views
+    static std::vector<int> parseColors(const std::string &letters);     // "rgb", "g", "br"... to SatColor frames, in order
     
     void setServerPort(int socket);
     void setServerAddress(const std::string&);
@@ -68,6 +101,7 @@ public:
     uint8_t getCurrentState() const { return this->state; }
     std::string getServerAddress() const;
     int getServerPort() const;
+    uint32_t getLastRequestId() const { return this->lastRequest; }
 
 private:
     uint8_t state;
@@ -75,5 +109,30 @@ private:
     int clientSocket;
     sockaddr_in server;
     std::string serverAddr;
+    uint32_t sequence;      // Sequence number of the next message sent
+    uint32_t lastRequest;   // Sequence number of the last capture request, echoed by its frames
+    int mcastSocket;        // UDP socket joined to the server's group, -1 until first multicast request
+    FrameAssembler assembler;
+    uint32_t streamRequest; // Sequence number of the active MSG_SUBSCRIBE
+    bool subscribed;
+    bool planes;            // Request WIRE_FLAG_PLANES delivery
+    bool lossless;          // Request WIRE_FLAG_LOSSLESS delivery
+    int denoise;            // DenoiseMode sent with WIRE_FLAG_DENOISE, -1 for the server default
+    RegionInfo region;      // Sent with WIRE_FLAG_REGION (host order), scale 0 for full frames
+    RegionInfo delivered;   // Echoed by the server with the last frames received
+    bool delta;             // Request WIRE_FLAG_DELTA delivery
+    bool keyframe;          // Send WIRE_FLAG_KEYFRAME with the next request
+    std::vector<cv::Mat> previous; // Last frames received by index, as transmitted, references of FRAME_DELTA_* frames
+
+    void joinMulticast();
+    std::vector<uint8_t> buildCaptureRequest(const std::vector<int> &colors);
+    uint16_t transportFlags() const;
+    void appendOptions(std::vector<uint8_t> &payload) const;
+    cv::Mat decodeFrame(const uint8_t *data, size_t size, uint8_t planes);
+    cv::Mat decodeFrame(const FrameInfo &info, const uint8_t *data, size_t size);
+    size_t readFrameRegion(const WireHeader &header, const std::vector<uint8_t> &payload);
+
+    void sendMessage(uint8_t type, uint16_t flags, const uint8_t *payload, size_t length);
+    void recvMessage(WireHeader &header, std::vector<uint8_t> &payload);
 };
 #endif
\ No newline at end of file
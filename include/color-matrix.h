@@ -0,0 +1,104 @@
+#ifndef COLOR_MATRIX_H
+#define COLOR_MATRIX_H
+
+#include <stdint.h>
+
+#define COLOR_MATRIX_WIRE_SIZE 48   // 12 x int32 Q16.16, network byte order
+#define COLOR_MATRIX_LIMIT 8.0f     // Coefficients must lie strictly within +/- this
+#define COLOR_OFFSET_LIMIT 1024.0f  // Offsets must lie within +/- this
+
+// Output channels as bits, e.g. the channels a single-band matrix writes
+enum ColorChannelBits
+{
+    CHANNEL_RED = 0x01,
+    CHANNEL_GREEN = 0x02,
+    CHANNEL_BLUE = 0x04
+};
+
+/**
+ * @brief 3x4 affine color transform applied to every pixel of a frame.
+ * @details Rows produce the output R, G and B channels; columns weight the input
+ *          R, G and B channels, the last column is a constant offset in 0-255 units:
+ *
+ *              out[c] = m[c][0] * R + m[c][1] * G + m[c][2] * B + m[c][3]
+ *
+ *          saturated to 0-255. A 3x3 matrix is the same with a zero offset column.
+ */
+struct ColorMatrix
+{
+    float m[3][4];
+
+    bool operator==(const ColorMatrix &) const = default;
+
+    static ColorMatrix identity()
+    {
+        return scale(255, 255, 255);
+    }
+
+    // Per-channel weights as carried by a Filter, 255 keeps a channel and 0 removes it
+    static ColorMatrix scale(uint8_t red, uint8_t green, uint8_t blue)
+    {
+        ColorMatrix matrix{};
+        matrix.m[0][0] = red / 255.0f;
+        matrix.m[1][1] = green / 255.0f;
+        matrix.m[2][2] = blue / 255.0f;
+        return matrix;
+    }
+
+    // Every coefficient and offset within what the fixed-point kernel represents
+    bool inRange() const
+    {
+        for (int row = 0; row < 3; row++)
+        {
+            for (int col = 0; col < 3; col++)
+            {
+                if (!(m[row][col] > -COLOR_MATRIX_LIMIT && m[row][col] < COLOR_MATRIX_LIMIT))
+                {
+                    return false;
+                }
+            }
+            if (!(m[row][3] >= -COLOR_OFFSET_LIMIT && m[row][3] <= COLOR_OFFSET_LIMIT))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Tests whether the matrix computes one band and tints it onto some channels.
+     * @details True when every output row is either all zero or identical to the
+     *          others, e.g. scale(255, 0, 0), a luma row copied to all three channels,
+     *          or a custom band written to green only. Such a frame is fully
+     *          described by one 8-bit plane plus the channel bits.
+     * @param row Receives the first non-zero row, which computes the band
+     * @return CHANNEL_* bits of the non-zero rows, 0 if the matrix is not single-band
+     */
+    uint8_t bandChannels(int &row) const
+    {
+        uint8_t channels = 0;
+        row = -1;
+        for (int r = 0; r < 3; r++)
+        {
+            bool zero = m[r][0] == 0 && m[r][1] == 0 && m[r][2] == 0 && m[r][3] == 0;
+            if (zero)
+            {
+                continue;
+            }
+            if (row < 0)
+            {
+                row = r;
+            }
+            for (int col = 0; col < 4; col++)
+            {
+                if (m[r][col] != m[row][col])
+                {
+                    return 0;
+                }
+            }
+            channels |= 1 << r;
+        }
+        return channels;
+    }
+};
+#endif
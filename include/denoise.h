@@ -0,0 +1,61 @@
+#ifndef DENOISE_H
+#define DENOISE_H
+
+#include <stdint.h>
+#include <string>
+#include <opencv4/opencv2/core.hpp>
+#include <opencv4/opencv2/imgproc.hpp>
+
+/** Denoise
+ *  Edge-preserving smoothing applied to every capture before filtering. The
+ *  original 50 px bilateral filter is kept as the reference; the other modes
+ *  approximate it at a fraction of the cost:
+ *
+ *      none       capture as-is
+ *      pyramid    reference filter at 1/4 scale, upsampled; softest edges
+ *      guided     fast guided filter on luma, coefficients fitted at 1/4 scale
+ *      grid       bilateral grid, closest to the reference
+ *      bilateral  reference cv::bilateralFilter(50, 25, 25), seconds per frame at 1080p
+ *
+ *  Benchmark measures each mode on this machine, the server reports the
+ *  latency it observes per mode in its stats.
+ *
+ *  Mode values are part of the wire protocol (WIRE_FLAG_DENOISE).
+ */
+
+#define DENOISE_SIGMA_SPACE 16   // Pixels, spatial extent of the approximations
+#define DENOISE_SIGMA_COLOR 25   // Intensity levels, edges stronger than this are kept
+#define DENOISE_SUBSAMPLE 4      // Scale factor of the guided and pyramid modes
+#define DENOISE_REFERENCE_DIAMETER 50
+
+enum DenoiseMode
+{
+    DENOISE_NONE = 0,
+    DENOISE_BILATERAL = 1, // Reference, exact and slow
+    DENOISE_GRID = 2,
+    DENOISE_GUIDED = 3,
+    DENOISE_PYRAMID = 4,
+    DENOISE_MODES
+};
+
+/**
+ * @brief Applies an edge-preserving denoise to a BGR frame.
+ * @param input CV_8UC3 image
+ * @param output Receives a CV_8UC3 image of the same size, may alias input only for DENOISE_NONE
+ * @param mode Quality/latency tradeoff
+ * @param scratch Allocator for the mode's intermediate images (e.g. a BufferPool), null for OpenCV's default
+ * @return false if the input is not CV_8UC3 or the mode is unknown
+ */
+bool denoiseFrame(const cv::Mat &input, cv::Mat &output, DenoiseMode mode, cv::MatAllocator *scratch = nullptr);
+
+/**
+ * @brief Name of a mode as used in JSON requests and stats, "unknown" if out of range.
+ */
+const char *denoiseName(DenoiseMode mode);
+
+/**
+ * @brief Looks up a mode by its name.
+ * @return false if the name is unknown
+ */
+bool parseDenoiseMode(const std::string &name, DenoiseMode &mode);
+#endif
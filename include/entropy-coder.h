@@ -0,0 +1,251 @@
+#ifndef ENTROPY_CODER_H
+#define ENTROPY_CODER_H
+
+#include <stdint.h>
+#include <array>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+/** Entropy Coding
+ *  Byte-alphabet coders for frame planes and residuals. Every coder builds its
+ *  model from the histogram of the buffer it is about to encode, serializes the
+ *  model compactly (writeTable) and decodes into a caller supplied span.
+ *
+ *  Entropy frame: coder (1 byte), symbol count and coded byte count (4 bytes
+ *  each, big endian), the coder's table, the coded bytes. The coder byte lets
+ *  the receiver decode any frame without negotiating.
+ */
+
+#define CODER_SYMBOLS 256        // Byte alphabet
+#define PREFIX_MAX_CODE_BITS 24  // Longest prefix code, skewed histograms are flattened until they fit
+#define PREFIX_LOOKUP_BITS 11    // Bits resolved per primary table probe, longer codes take a second probe
+#define PREFIX_TABLE_MIN_RUN 3   // Shortest run of repeated lengths writeTable() stores as a run
+#define PREFIX_TABLE_MAX_RUN (PREFIX_TABLE_MIN_RUN + 63)
+#define TANS_TABLE_LOG 11        // tANS states, 2^TANS_TABLE_LOG
+#define ENTROPY_FRAME_HEADER 9   // Coder byte, symbol count and coded byte count
+
+enum CoderId : uint8_t
+{
+    CODER_SHANNON_FANO = 0,
+    CODER_HUFFMAN = 1,
+    CODER_TANS = 2,
+    CODERS
+};
+
+/**
+ * @brief Common interface of the entropy coders.
+ */
+class EntropyCoder
+{
+public:
+    virtual ~EntropyCoder() = default;
+
+    virtual CoderId id() const = 0;
+
+    /**
+     * @brief Builds the model from the histogram of a buffer, e.g. a frame plane.
+     * @throws std::invalid_argument If the buffer is empty
+     */
+    virtual void buildTable(std::span<const uint8_t> input) = 0;
+
+    /**
+     * @brief Appends the serialized model.
+     */
+    virtual void writeTable(std::vector<uint8_t> &output) const = 0;
+
+    /**
+     * @brief Reads a model written by writeTable().
+     * @return Bytes consumed, 0 if the table is truncated or invalid
+     */
+    virtual size_t readTable(std::span<const uint8_t> input) = 0;
+
+    /**
+     * @brief Appends the coded bytes, every input byte must occur in the model.
+     * @return Number of bits written
+     * @throws std::invalid_argument If a byte is not in the model
+     */
+    virtual size_t encode(std::span<const uint8_t> input, std::vector<uint8_t> &output) const = 0;
+
+    /**
+     * @brief Decodes exactly output.size() bytes.
+     * @return false if the input is truncated or corrupt
+     */
+    virtual bool decode(std::span<const uint8_t> packed, std::span<uint8_t> output) const = 0;
+};
+
+/**
+ * @brief Code of one byte value: the low 'length' bits of 'bits', most significant first.
+ */
+struct SymbolCode
+{
+    uint32_t bits;
+    uint8_t length; // 0: the symbol does not occur
+};
+
+/**
+ * @brief Decoder table entry for one bit pattern.
+ * @details A primary entry with a length holds a symbol. One without a length
+ *          points at a secondary table of 2^subBits entries for the codes
+ *          longer than PREFIX_LOOKUP_BITS sharing its prefix; neither means no
+ *          code starts with the pattern.
+ */
+struct DecodeEntry
+{
+    uint32_t value; // Symbol, or offset of the secondary table
+    uint8_t length; // Full code length
+    uint8_t subBits;
+};
+
+/**
+ * @brief Canonical prefix code, the common half of Shannon-Fano and Huffman.
+ * @details Subclasses only choose the code lengths. Codes are then numbered in
+ *          order of (length, byte value), so the 256 lengths define the code.
+ *          Codes are packed most significant bit first; decoding is one probe
+ *          of a PREFIX_LOOKUP_BITS table per symbol, two for longer codes.
+ *
+ *          Table format, per byte value, in bits: 0 same length as the previous
+ *          value; 10s one longer (s=0) or shorter (s=1); 110 rrrrrr the previous
+ *          length for PREFIX_TABLE_MIN_RUN + r values; 111 lllll a literal
+ *          length. The first value's previous length is 0, the bits are zero
+ *          padded to a byte. Smooth plane histograms take a few dozen bytes.
+ */
+class PrefixCoder : public EntropyCoder
+{
+public:
+    PrefixCoder() : table{}, longest(1) {};
+
+    void buildTable(std::span<const uint8_t> input) override;
+    void writeTable(std::vector<uint8_t> &output) const override;
+    size_t readTable(std::span<const uint8_t> input) override;
+    size_t encode(std::span<const uint8_t> input, std::vector<uint8_t> &output) const override;
+    bool decode(std::span<const uint8_t> packed, std::span<uint8_t> output) const override;
+
+    /**
+     * @brief Code length of every byte value, 0 for unused ones.
+     */
+    std::array<uint8_t, CODER_SYMBOLS> getLengths() const;
+
+    /**
+     * @brief Rebuilds the canonical table (and decoder) from code lengths.
+     * @return false if a length exceeds PREFIX_MAX_CODE_BITS, no byte has a
+     *         code, or the lengths cannot form a prefix code
+     */
+    bool setLengths(const std::array<uint8_t, CODER_SYMBOLS> &lengths);
+
+    const std::array<SymbolCode, CODER_SYMBOLS> &getTable() const { return this->table; }
+
+protected:
+    /**
+     * @brief Chooses a code length for every counted symbol (two or more of them).
+     * @return Longest length assigned; over PREFIX_MAX_CODE_BITS the counts are
+     *         flattened and the lengths chosen again
+     */
+    virtual int buildLengths(const std::array<uint64_t, CODER_SYMBOLS> &counts, std::array<uint8_t, CODER_SYMBOLS> &lengths) const = 0;
+
+private:
+    std::array<SymbolCode, CODER_SYMBOLS> table;
+    std::vector<DecodeEntry> lookup;    // 2^PREFIX_LOOKUP_BITS entries
+    std::vector<DecodeEntry> secondary; // Secondary tables, back to back
+    uint8_t longest;                    // Longest code in the table
+
+    void canonicalize();
+    void buildDecoder();
+};
+
+/**
+ * @brief Optimal prefix code, lengths from the Huffman tree of the counts.
+ */
+class HuffmanCoder : public PrefixCoder
+{
+public:
+    CoderId id() const override { return CODER_HUFFMAN; }
+
+protected:
+    int buildLengths(const std::array<uint64_t, CODER_SYMBOLS> &counts, std::array<uint8_t, CODER_SYMBOLS> &lengths) const override;
+};
+
+/**
+ * @brief Table-based asymmetric numeral system coder.
+ * @details Counts are normalized to 2^TANS_TABLE_LOG and spread over the
+ *          state table, so a symbol costs a fractional number of bits close
+ *          to its information content, unlike any prefix code.
+ *
+ *          Symbols are encoded last to first with bits written least
+ *          significant first, then the final states and a terminating 1 bit;
+ *          the decoder reads the stream backwards from that bit. Even and odd
+ *          positions have a state each, two independent chains the decoder
+ *          runs side by side. Decoding must end in the initial states with
+ *          every bit consumed.
+ *
+ *          Table format, per byte value, in bits: 0 rrrrr a run of r + 1 unused
+ *          values; 1 nnnn and n - 1 bits, a normalized count of n significant
+ *          bits (the leading 1 implied). Zero padded to a byte.
+ */
+class TansCoder : public EntropyCoder
+{
+public:
+    TansCoder() : frequencies{} {};
+
+    CoderId id() const override { return CODER_TANS; }
+    void buildTable(std::span<const uint8_t> input) override;
+    void writeTable(std::vector<uint8_t> &output) const override;
+    size_t readTable(std::span<const uint8_t> input) override;
+    size_t encode(std::span<const uint8_t> input, std::vector<uint8_t> &output) const override;
+    bool decode(std::span<const uint8_t> packed, std::span<uint8_t> output) const override;
+
+    const std::array<uint16_t, CODER_SYMBOLS> &getFrequencies() const { return this->frequencies; }
+
+private:
+    struct State
+    {
+        uint16_t base; // Next state before the bits read are added
+        uint8_t symbol;
+        uint8_t bits;
+    };
+
+    std::array<uint16_t, CODER_SYMBOLS> frequencies; // Normalized, sum 2^TANS_TABLE_LOG
+    std::array<uint32_t, CODER_SYMBOLS> first;       // Offset of the symbol's states in 'next'
+    std::array<uint32_t, CODER_SYMBOLS> threshold;   // State from which the symbol emits the longer bit count
+    std::array<uint8_t, CODER_SYMBOLS> shift;        // Longer bit count
+    std::vector<uint16_t> next;                      // Encoder transitions, grouped by symbol
+    std::vector<State> states;                       // Decoder table
+
+    bool buildStates();
+};
+
+/**
+ * @brief New coder of the given kind, nullptr for an unknown id.
+ */
+std::unique_ptr<EntropyCoder> makeEntropyCoder(CoderId id);
+
+/**
+ * @brief Short name of a coder, e.g. "huffman".
+ */
+const char *coderName(CoderId id);
+
+/**
+ * @brief Looks up a coder by its name.
+ * @return false if the name is unknown
+ */
+bool parseCoderName(const std::string &name, CoderId &id);
+
+/**
+ * @brief Entropy codes a buffer into a self-describing entropy frame.
+ * @param coder Coder to use, its table is rebuilt for this input
+ * @param input Bytes to code, must not be empty
+ * @param output Frame bytes are appended
+ */
+void packEntropyFrame(EntropyCoder &coder, std::span<const uint8_t> input, std::vector<uint8_t> &output);
+
+/**
+ * @brief Decodes an entropy frame with whichever coder its header names.
+ * @param frame Frame as written by packEntropyFrame(), possibly followed by other data
+ * @param output Receives the decoded bytes
+ * @param limit Largest symbol count accepted, bounds what a corrupt header can allocate
+ * @return Bytes of the frame consumed, 0 if it is truncated, corrupt or over the limit
+ */
+size_t unpackEntropyFrame(std::span<const uint8_t> frame, std::vector<uint8_t> &output, size_t limit = UINT32_MAX);
+#endif
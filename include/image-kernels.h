@@ -0,0 +1,150 @@
+#ifndef IMAGE_KERNELS_H
+#define IMAGE_KERNELS_H
+
+#include <stdint.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <opencv4/opencv2/core.hpp>
+
+#include "camera.h"
+#include "color-matrix.h"
+#include "protocol.h"
+
+/** Image Kernels
+ *  Hot per-pixel loops of the compute stage, written as single passes over the
+ *  input. x86 builds carry SSE2/SSE4.1/AVX2 variants selected at runtime, so the
+ *  binary runs on any x86-64 CPU without special compiler flags; every kernel
+ *  has a scalar fallback which defines its exact output.
+ *
+ *  Every kernel cuts the image into tiles of about KERNEL_TILE_BYTES and spreads
+ *  them over OpenCV's thread pool (cv::setNumThreads). The tiling depends on the
+ *  image size only, so results are identical whatever the thread count.
+ */
+
+#define KERNEL_TILE_BYTES (64 * 1024) // Input bytes per parallel tile, fits a core's L2 with its outputs
+
+enum KernelIsa
+{
+    ISA_SCALAR,
+    ISA_SSE2,
+    ISA_SSE41,
+    ISA_AVX2
+};
+
+/**
+ * @brief Widest instruction set the kernels will use on this CPU.
+ */
+KernelIsa detectKernelIsa();
+
+/**
+ * @brief Returns true if every weight of the filter is 0 or 255, i.e. it only keeps or zeroes channels.
+ */
+bool isChannelMask(const Filter &filter);
+
+/**
+ * @brief Converts a matrix which only keeps or zeroes channels into the equivalent Filter.
+ * @return false if the matrix mixes, scales or offsets channels
+ */
+bool asChannelMask(const ColorMatrix &matrix, Filter &filter);
+
+/**
+ * @brief Applies several channel-mask filters to a BGR image in one read of the input.
+ * @details Replaces copy + split + zero planes + merge per filter: each input
+ *          byte is loaded once and ANDed with every filter's repeating B,G,R mask.
+ * @param input CV_8UC3 image, need not be continuous
+ * @param filters Channel masks (see isChannelMask), RGB order as in Filter
+ * @param outputs Receives one CV_8UC3 image per filter, existing buffers of the right size are reused
+ * @param isa Instruction set to use, clamped to what the CPU supports
+ * @return false if the input is not CV_8UC3 or a filter is not a channel mask
+ */
+bool separateChannels(const cv::Mat &input, const std::vector<Filter> &filters, std::vector<cv::Mat> &outputs,
+                      KernelIsa isa = ISA_AVX2);
+
+/**
+ * @brief Applies several 3x4 color matrices to a BGR image in one read of the input.
+ * @details Coefficients are quantized to signed Q3.12 and offsets to Q12, every
+ *          ISA produces bit-identical results. The SIMD path deinterleaves 16
+ *          pixels once, then evaluates every matrix on them with 16-bit
+ *          multiply-adds before re-interleaving each output.
+ * @param input CV_8UC3 image, need not be continuous
+ * @param matrices Transforms, each within ColorMatrix::inRange()
+ * @param outputs Receives one CV_8UC3 image per matrix
+ * @param isa Instruction set to use, clamped to what the CPU supports (SSE4.1 and up vectorize)
+ * @return false if the input is not CV_8UC3 or a matrix is out of range
+ */
+bool transformColors(const cv::Mat &input, const std::vector<ColorMatrix> &matrices, std::vector<cv::Mat> &outputs,
+                     KernelIsa isa = ISA_AVX2);
+
+/**
+ * @brief Computes the band of several single-band matrices as 8-bit planes, one read of the input.
+ * @details Same arithmetic as transformColors() but only the band row of each
+ *          matrix is evaluated and stored, a third of the output bytes. The
+ *          full frame is the plane written to the matrix's bandChannels().
+ * @param input CV_8UC3 image, need not be continuous
+ * @param matrices Single-band transforms (see ColorMatrix::bandChannels), each within ColorMatrix::inRange()
+ * @param planes Receives one CV_8UC1 image per matrix
+ * @param isa Instruction set to use, clamped to what the CPU supports
+ * @return false if the input is not CV_8UC3 or a matrix is out of range or not single-band
+ */
+bool extractPlanes(const cv::Mat &input, const std::vector<ColorMatrix> &matrices, std::vector<cv::Mat> &planes,
+                   KernelIsa isa = ISA_AVX2);
+
+/**
+ * @brief Cuts a requested region out of a capture and downscales it, ahead of every per-pixel stage.
+ * @details Width and height are clamped to the capture's edge (0 reaches it).
+ *          The crop is a view of the capture; downscaling averages pixels
+ *          (INTER_AREA) and output sizes round to the nearest pixel, at least 1.
+ * @param capture Full frame
+ * @param region Requested geometry in host order, receives the geometry delivered
+ * @param output Receives the crop, downscaled unless the scale is REGION_SCALE_ONE
+ * @return false if the origin is outside the capture or the scale is out of range
+ */
+bool cropRegion(const cv::Mat &capture, RegionInfo &region, cv::Mat &output);
+
+/**
+ * @brief The clamping half of cropRegion, for sources which crop while reading (CameraCapture).
+ * @param capture Size of the full frame
+ * @param region Requested geometry in host order, receives the geometry delivered
+ * @param rect Receives the region within the capture
+ * @return false if the origin is outside the capture or the scale is out of range
+ */
+bool regionRect(cv::Size capture, RegionInfo &region, cv::Rect &rect);
+
+/**
+ * @brief The downscaling half of cropRegion.
+ * @param crop Region as cut by regionRect
+ * @param region Delivered geometry from regionRect
+ * @param output Receives the crop itself at REGION_SCALE_ONE, otherwise the downscaled region
+ */
+void scaleRegion(const cv::Mat &crop, const RegionInfo &region, cv::Mat &output);
+
+/**
+ * @brief Residual of a frame against the previous one at the same position, for delta transport.
+ * @details Per byte (frame - reference) mod 256: unchanged pixels become 0 and
+ *          small changes stay near 0 or 255, which compresses far better than
+ *          the frame itself. applyDelta() inverts it exactly.
+ * @param frame Current 8-bit image
+ * @param reference Previous image of the same size and type
+ * @param residual Receives an image of the same size and type
+ * @return false if the images are not 8-bit or differ in size or type
+ */
+bool deltaEncode(const cv::Mat &frame, const cv::Mat &reference, cv::Mat &residual);
+
+/**
+ * @brief Rebuilds a frame from the previous one and a deltaEncode() residual.
+ * @param frame Receives the rebuilt image, may be the residual itself
+ * @return false if the images are not 8-bit or differ in size or type
+ */
+bool applyDelta(const cv::Mat &reference, const cv::Mat &residual, cv::Mat &frame);
+
+/**
+ * @brief MD5 digest of an image's pixels, hashed tile by tile in parallel.
+ * @details Each tile's pixel bytes are hashed on their own, the digest is the MD5
+ *          of the tile digests in order. Stable across thread counts and row
+ *          padding, but not the MD5 of the raw pixel buffer.
+ * @param image Any 8-bit image
+ * @return 32 lowercase hex digits
+ */
+std::string frameDigest(const cv::Mat &image);
+#endif
@@ -0,0 +1,92 @@
+#ifndef LOSSLESS_CODEC_H
+#define LOSSLESS_CODEC_H
+
+#include <stdint.h>
+#include <span>
+#include <vector>
+#include <opencv4/opencv2/core.hpp>
+
+#include "entropy-coder.h"
+
+/** Lossless Codec
+ *  Predictive lossless coding of 8-bit frames, in place of PNG for the frames
+ *  and delta residuals the server sends. Every pixel is predicted from its
+ *  left (a), upper (b), upper left (c) and upper right (d) neighbours and only
+ *  the residual, (pixel - prediction) mod 256, is entropy coded. Filtered frames
+ *  are smooth, so residuals cluster around 0 and code in a few bits per pixel.
+ *
+ *  Each band of LOSSLESS_BAND_ROWS rows of a plane picks the predictor with the
+ *  smallest residuals. Pixels of the first row are predicted from their left
+ *  neighbour, those of the first column from the one above, whatever the band
+ *  chose. BGR images are coded as the planes G, B - G and R - G when that
+ *  removes what the channels have in common (sensor, graphics), as G, B and R
+ *  when their noise is independent; the encoder estimates which on a few rows.
+ *
+ *  Residuals are split by context, the activity |d - b| + |b - c| + |e - b| of
+ *  the rows above (e two rows above): flat areas get a table of their own whose
+ *  residuals take a bit or two, instead of sharing one with edges and texture.
+ *  Contexts never depend on the row being decoded, so they are worked out a
+ *  row at a time. First row and column pixels form context 0.
+ *
+ *  Planes are cut into slices of LOSSLESS_SLICE_ROWS rows, coded independently
+ *  (the first row of a slice as the first row of an image), so slices are
+ *  encoded and decoded concurrently on OpenCV's thread pool. As with the image
+ *  kernels, the cut depends on the image size only.
+ *
+ *  Container, big endian:
+ *      u32 LOSSLESS_MAGIC, u8 channels, u8 flags (LOSSLESS_SUBTRACT_GREEN),
+ *      u16 width, u16 height, u8 band rows, u16 slice rows
+ *      u32 byte size of every slice, plane by plane
+ *      per slice: one LosslessPredictor byte per band, a u8 mask of the contexts
+ *      used, then an entropy frame (see entropy-coder.h) of each used context's
+ *      residuals in raster order, lowest context first
+ *
+ *  The entropy frames name their coder, so decoding needs nothing but the bytes.
+ */
+
+#define LOSSLESS_MAGIC 0x564F594C // "VOYL"
+#define LOSSLESS_HEADER 13        // Magic, channels, flags, width, height, band and slice rows
+#define LOSSLESS_SUBTRACT_GREEN 0x01 // Flag: BGR planes are G, B - G and R - G
+#define LOSSLESS_BAND_ROWS 16     // Rows sharing one predictor
+#define LOSSLESS_SLICE_ROWS 128   // Rows coded independently, a multiple of LOSSLESS_BAND_ROWS
+#define LOSSLESS_CONTEXTS 8       // Residual contexts, one bit each in the plane's mask
+#define LOSSLESS_DEFAULT_CODER CODER_TANS
+#define LOSSLESS_EXTENSION ".voyl" // FlightKey::encoding of frames coded with this codec
+
+enum LosslessPredictor : uint8_t
+{
+    PREDICT_LEFT = 0,    // a
+    PREDICT_UP = 1,      // b
+    PREDICT_AVERAGE = 2, // (a + b) / 2, averages out sensor noise
+    PREDICT_PAETH = 3,   // Whichever of a, b, c is closest to a + b - c, as PNG
+    PREDICT_MED = 4,     // Median edge detector of LOCO-I: min(a, b) or max(a, b) across an edge, a + b - c otherwise
+    PREDICTORS
+};
+
+/**
+ * @brief Encodes an image into a lossless container.
+ * @param image CV_8UC1 or CV_8UC3 image, at most 65535 pixels wide and high
+ * @param output Container bytes are appended
+ * @param coder Entropy coder of the residuals
+ * @return false if the image is empty, too large or of another type
+ */
+bool encodeLossless(const cv::Mat &image, std::vector<uint8_t> &output, CoderId coder = LOSSLESS_DEFAULT_CODER);
+
+/**
+ * @brief Decodes a container written by encodeLossless().
+ * @param input Container bytes
+ * @param image Receives a CV_8UC1 or CV_8UC3 image, allocated with its own allocator if it has one
+ * @return false if the input is not a container, or is truncated or corrupt
+ */
+bool decodeLossless(std::span<const uint8_t> input, cv::Mat &image);
+
+/**
+ * @brief Returns true if the bytes start like a lossless container, to tell them from PNG.
+ */
+bool isLosslessImage(std::span<const uint8_t> input);
+
+/**
+ * @brief Short name of a predictor, e.g. "paeth".
+ */
+const char *predictorName(LosslessPredictor predictor);
+#endif
@@ -0,0 +1,212 @@
+#ifndef MULTICAST_H
+#define MULTICAST_H
+
+#include <stdint.h>
+#include <cerrno>
+#include <cstddef>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "protocol.h"
+
+/** Multicast Distribution
+ *  Encoded frames are sent once to a UDP multicast group, split into datagrams
+ *  that fit a 1500 byte Ethernet MTU. All header fields are network byte order:
+ *
+ *      0       4   5   6   7   8       12  14  16      20  22  24      28
+ *      +-------+---+---+---+---+-------+---+---+-------+---+---+-------+
+ *      | magic |ver|knd|fec|col|frameId|idx|cnt| size  |len|rsv| crc32 |  payload ...
+ *      +-------+---+---+---+---+-------+---+---+-------+---+---+-------+
+ *
+ *  Every data chunk but the last carries exactly MCAST_CHUNK_PAYLOAD bytes. With
+ *  FEC enabled, each group of 'fec' data chunks is followed by one XOR parity
+ *  chunk, repairing any single loss in the group without a round trip. Holes
+ *  left after that are requested with MSG_NACK over the TCP session and
+ *  re-multicast from the sender's retain window, so one retransmission serves
+ *  every receiver which lost the same chunk.
+ */
+
+#define MCAST_MAGIC 0x564F594D // "VOYM"
+#define MCAST_HEADER_SIZE 28
+#define MCAST_MTU 1500
+#define MCAST_CHUNK_PAYLOAD (MCAST_MTU - 20 - 8 - MCAST_HEADER_SIZE) // Minus IPv4 and UDP headers
+#define MCAST_DEFAULT_FEC 8  // Data chunks per parity chunk, 0 disables FEC
+#define MCAST_RETAIN 32      // Frames the sender keeps for retransmission
+#define MCAST_MAX_PARTIAL 64 // Incomplete frames a receiver tracks before evicting the oldest
+#define MCAST_NACK_ROUNDS 3  // Retransmission requests before a receiver gives up on a frame
+
+enum ChunkKind
+{
+    CHUNK_DATA = 0,
+    CHUNK_PARITY = 1
+};
+
+// Datagram header as it appears on the wire
+struct __attribute__((packed)) ChunkHeader
+{
+    uint32_t magic;
+    uint8_t version;
+    uint8_t kind;      // ChunkKind
+    uint8_t fecGroup;  // Data chunks covered by each parity chunk, 0: no FEC
+    uint8_t color;     // Filter which produced the frame
+    uint32_t frameId;  // Assigned by the sender, unique within its retain window
+    uint16_t index;    // Data: chunk index, parity: FEC group index
+    uint16_t count;    // Data chunks in the frame
+    uint32_t frameSize;
+    uint16_t length;   // Payload bytes in this datagram
+    uint16_t reserved;
+    uint32_t checksum; // CRC-32 of the payload
+};
+static_assert(sizeof(ChunkHeader) == MCAST_HEADER_SIZE, "ChunkHeader must be packed");
+
+// Entry of a MSG_MCAST_INDEX payload (u16 count, then count entries), network byte order
+struct __attribute__((packed)) McastFrameRef
+{
+    uint32_t frameId;
+    uint32_t frameSize;
+    uint8_t color;
+    uint8_t planes; // As FrameInfo::planes
+    uint8_t reserved[2];
+};
+static_assert(sizeof(McastFrameRef) == 12, "McastFrameRef must be packed");
+
+struct McastStats
+{
+    uint64_t framesSent;
+    uint64_t datagramsSent;
+    uint64_t parityDatagrams;
+    uint64_t retransmitted; // Chunks re-multicast in answer to NACKs
+};
+
+/**
+ * @brief Number of data chunks needed for a frame of 'size' bytes.
+ */
+size_t chunkCount(size_t size);
+
+/**
+ * @brief Splits one encoded frame into datagrams, data chunks and their parity chunks.
+ * @param frameId Identifier stamped on every chunk
+ * @param color Filter which produced the frame
+ * @param data Encoded frame
+ * @param size Frame length, at most UINT16_MAX chunks
+ * @param fecGroup Data chunks per parity chunk, 0 for none
+ * @return The datagrams in transmission order
+ */
+std::vector<std::vector<uint8_t>> chunkFrame(uint32_t frameId, uint8_t color, const uint8_t *data, size_t size, uint8_t fecGroup);
+
+/**
+ * @brief Multicasts frames and keeps the most recent ones for NACK retransmission.
+ * @details send() runs on the compute stage, retransmit() on IO threads.
+ */
+class MulticastSender
+{
+public:
+    MulticastSender(const std::string &group, int port, uint8_t fecGroup = MCAST_DEFAULT_FEC, int ttl = 1);
+    ~MulticastSender();
+
+    uint32_t send(uint8_t color, std::shared_ptr<const std::vector<uint8_t>> frame); // Returns the frame id
+    size_t retransmit(uint32_t frameId, const std::vector<uint16_t> &chunks);      // Returns chunks resent
+
+    // Accessors
+    std::string getGroup() const { return this->group; }
+    int getPort() const { return this->port; }
+    uint8_t getFecGroup() const { return this->fecGroup; }
+    McastStats getStats();
+
+private:
+    struct Retained
+    {
+        uint8_t color;
+        std::shared_ptr<const std::vector<uint8_t>> data;
+    };
+
+    int sock;
+    std::string group;
+    int port;
+    uint8_t fecGroup;
+    sockaddr_in dest;
+
+    std::mutex sendMutex;
+    uint32_t nextId;
+    std::map<uint32_t, Retained> retained;
+    McastStats stats;
+
+    bool sendDatagram(const std::vector<uint8_t> &datagram);
+};
+
+/**
+ * @brief Reassembles frames from datagrams, repairing single losses per FEC group.
+ * @details Not thread-safe, owned by one receiving thread.
+ */
+class FrameAssembler
+{
+public:
+    enum Result
+    {
+        CHUNK_REJECTED, // Not a chunk, corrupt, or for an evicted frame
+        CHUNK_ACCEPTED,
+        FRAME_COMPLETE  // This chunk (or a repair it enabled) finished the frame
+    };
+
+    void expect(uint32_t frameId, uint32_t frameSize, uint8_t color); // Track a frame announced over TCP
+    Result accept(const uint8_t *datagram, size_t size);
+    bool isComplete(uint32_t frameId) const;
+    std::vector<uint16_t> missing(uint32_t frameId) const; // Data chunks still absent, for MSG_NACK
+    bool takeFrame(uint32_t frameId, std::vector<uint8_t> &out);
+
+    // Accessors
+    uint64_t getRepaired() const { return this->repaired; }
+    uint64_t getCorrupt() const { return this->corrupt; }
+
+private:
+    struct Partial
+    {
+        uint32_t frameSize;
+        uint16_t count;
+        uint8_t color;
+        uint8_t fecGroup;
+        size_t received;
+        std::vector<uint8_t> data;
+        std::vector<bool> have;
+        std::map<uint16_t, std::vector<uint8_t>> parity; // Keyed by FEC group index
+    };
+
+    std::map<uint32_t, Partial> partials;
+    uint64_t repaired = 0;
+    uint64_t corrupt = 0;
+
+    Partial &track(uint32_t frameId, uint32_t frameSize, uint8_t color);
+    bool repair(Partial &frame, uint16_t group);
+};
+
+/**
+ * @brief Encodes the MSG_MCAST_INDEX payload announcing multicast frames.
+ */
+std::vector<uint8_t> buildMcastIndex(const std::vector<McastFrameRef> &refs);
+
+/**
+ * @brief Decodes a MSG_MCAST_INDEX payload into host byte order refs.
+ * @return false if the payload is malformed
+ */
+bool readMcastIndex(const uint8_t *data, size_t size, std::vector<McastFrameRef> &refs);
+
+/**
+ * @brief Encodes a MSG_NACK payload: u32 frame id, u16 count, count x u16 chunk index.
+ */
+std::vector<uint8_t> buildNack(uint32_t frameId, const std::vector<uint16_t> &chunks);
+
+/**
+ * @brief Decodes a MSG_NACK payload.
+ * @return false if the payload is malformed
+ */
+bool readNack(const uint8_t *data, size_t size, uint32_t &frameId, std::vector<uint16_t> &chunks);
+#endif
@@ -0,0 +1,231 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stdint.h>
+#include <cstring>
+#include <vector>
+#include <arpa/inet.h>
+
+#include "color-matrix.h"
+
+/** Wire Protocol v1
+ *  Every message starts with a fixed 20 byte header, all fields network byte order:
+ *
+ *      0       4   5   6       8       12      16      20
+ *      +-------+---+---+-------+-------+-------+-------+
+ *      | magic |ver|typ| flags |  seq  |length | crc32 |  payload ...
+ *      +-------+---+---+-------+-------+-------+-------+
+ *
+ *  MSG_CAPTURE_REQUEST: u8 count, count x u8 SatColor
+ *                       (WIRE_FLAG_COLOR_MATRIX: u8 count, count x ColorMatrix as 12 x i32 Q16.16)
+ *                       (WIRE_FLAG_DENOISE: followed by u8 DenoiseMode)
+ *                       (WIRE_FLAG_REGION: followed by RegionInfo)
+ *  MSG_FRAME:           FrameInfo, (WIRE_FLAG_REGION: RegionInfo delivered,) encoded image
+ *                       (FRAME_DELTA_*: residual against the previous frame at the same index)
+ *  MSG_ACK:             u32 frames received
+ *  MSG_CONTROL/ERROR:   JSON text
+ *  MSG_MCAST_INDEX:     u16 count, count x McastFrameRef (frames sent to the multicast group)
+ *                       (WIRE_FLAG_REGION: followed by the RegionInfo delivered)
+ *  MSG_NACK:            u32 frame id, u16 count, count x u16 chunk index (see multicast.h)
+ *  MSG_SUBSCRIBE:       u16 target fps, then a capture request payload
+ *  MSG_UNSUBSCRIBE:     empty
+ *  MSG_STREAM_STATUS:   StreamStatus, ahead of every pushed frame set and once after unsubscribing
+ *
+ *  The magic never matches the size_t prefix of a legacy JSON request, so both
+ *  protocols are served on the same port.
+ */
+
+#define WIRE_MAGIC 0x564F5931 // "VOY1"
+#define WIRE_VERSION 1
+#define WIRE_HEADER_SIZE 20
+#define WIRE_MAX_REQUEST (1 << 20) // Largest client payload the server will buffer
+#define WIRE_MAX_FRAME (256u << 20) // Largest frame payload the client will accept
+#define REGION_SCALE_ONE 256 // RegionInfo::scale of a full resolution frame
+
+enum MessageType
+{
+    MSG_CAPTURE_REQUEST = 1,
+    MSG_FRAME = 2,
+    MSG_ACK = 3,
+    MSG_CONTROL = 4,
+    MSG_ERROR = 5,
+    MSG_MCAST_INDEX = 6,
+    MSG_NACK = 7,
+    MSG_SUBSCRIBE = 8,
+    MSG_UNSUBSCRIBE = 9,
+    MSG_STREAM_STATUS = 10
+};
+
+enum WireFlags
+{
+    WIRE_FLAG_PIPELINE = 0x0001, // Request: stream frames back-to-back, one MSG_ACK per batch
+    WIRE_FLAG_MULTICAST = 0x0002, // Request: deliver frames on the multicast group, answer with MSG_MCAST_INDEX
+    WIRE_FLAG_STREAM = 0x0004,    // Frame: pushed by a subscription, never acknowledged
+    WIRE_FLAG_COLOR_MATRIX = 0x0008, // Request: one ColorMatrix per frame instead of a SatColor
+    WIRE_FLAG_PLANES = 0x0010,      // Request: send single-band frames as one 8-bit plane (see FrameInfo::planes)
+    WIRE_FLAG_DENOISE = 0x0020,     // Request: payload ends with a u8 DenoiseMode, server default otherwise
+    WIRE_FLAG_REGION = 0x0040,      // Request: crop/downscale trailer after the denoise byte; Frame/index: geometry delivered
+    WIRE_FLAG_DELTA = 0x0080,       // Request: the client keeps its last frames, the server may answer with FRAME_DELTA_PNG
+    WIRE_FLAG_KEYFRAME = 0x0100,    // Request: answer with full frames, e.g. after the client lost its previous ones
+    WIRE_FLAG_LOSSLESS = 0x0200     // Request: frames and deltas may use the native lossless codec (lossless-codec.h) instead of PNG
+};
+
+// FrameInfo::encoding
+enum FrameEncoding
+{
+    FRAME_PNG = 0,
+    FRAME_DELTA_PNG = 1,     // PNG of the per-byte residual against the session's previous frame at the same index
+    FRAME_LOSSLESS = 2,      // Lossless container (lossless-codec.h)
+    FRAME_DELTA_LOSSLESS = 3 // Lossless container of the residual, as FRAME_DELTA_PNG
+};
+
+enum WireStatus
+{
+    WIRE_OK,
+    WIRE_INCOMPLETE,  // Not enough bytes buffered yet
+    WIRE_BAD_MAGIC,
+    WIRE_BAD_VERSION,
+    WIRE_TOO_LARGE,
+    WIRE_BAD_CHECKSUM
+};
+
+// Header as it appears on the wire
+struct __attribute__((packed)) WireHeader
+{
+    uint32_t magic;
+    uint8_t version;
+    uint8_t type;
+    uint16_t flags;
+    uint32_t seq;
+    uint32_t length;   // Payload bytes following the header
+    uint32_t checksum; // CRC-32 of the payload
+};
+static_assert(sizeof(WireHeader) == WIRE_HEADER_SIZE, "WireHeader must be packed");
+
+// Leading descriptor of a MSG_FRAME payload, network byte order
+struct __attribute__((packed)) FrameInfo
+{
+    uint16_t index;   // Position in the response
+    uint16_t count;   // Frames in the response
+    uint8_t color;    // Filter which produced the frame
+    uint8_t encoding; // FrameEncoding
+    uint8_t planes;   // CHANNEL_* bits the frame's single gray plane is tinted onto, 0: full BGR image
+    uint8_t reserved;
+};
+static_assert(sizeof(FrameInfo) == 8, "FrameInfo must be packed");
+
+// Crop and downscale of a capture (WIRE_FLAG_REGION), network byte order. Requests
+// fill the first five fields; responses echo the geometry actually delivered,
+// clamped to the capture, whose size they add
+struct __attribute__((packed)) RegionInfo
+{
+    uint16_t x;             // Crop origin in capture pixels
+    uint16_t y;
+    uint16_t width;         // Crop size in capture pixels, 0: up to the capture's edge
+    uint16_t height;
+    uint16_t scale;         // Output over crop size in 1/REGION_SCALE_ONE, 1 to REGION_SCALE_ONE
+    uint16_t captureWidth;  // Full capture size, 0 in requests
+    uint16_t captureHeight;
+};
+static_assert(sizeof(RegionInfo) == 14, "RegionInfo must be packed");
+
+// MSG_STREAM_STATUS payload, network byte order
+struct __attribute__((packed)) StreamStatus
+{
+    uint32_t delivered; // Frame sets pushed to this subscriber, including the one that follows
+    uint32_t dropped;   // Frame sets skipped because the subscriber (or compute stage) fell behind
+};
+static_assert(sizeof(StreamStatus) == 8, "StreamStatus must be packed");
+
+/**
+ * @brief Computes (or continues) a CRC-32 (IEEE 802.3) over a byte range.
+ * @param data Bytes to checksum
+ * @param size Number of bytes
+ * @param crc Result of a previous call when checksumming in pieces, 0 to start
+ * @return The CRC-32 of everything passed so far
+ */
+uint32_t crc32(const uint8_t *data, size_t size, uint32_t crc = 0);
+
+/**
+ * @brief Returns true if the buffered bytes start with the v1 magic.
+ */
+bool isWireMessage(const uint8_t *data, size_t size);
+
+/**
+ * @brief Writes a header in network byte order into 'out' (WIRE_HEADER_SIZE bytes).
+ */
+void writeHeader(uint8_t *out, uint8_t type, uint16_t flags, uint32_t seq, uint32_t length, uint32_t checksum);
+
+/**
+ * @brief Decodes and validates a header without looking at the payload.
+ * @param data Start of the buffered bytes
+ * @param size Number of buffered bytes
+ * @param header Receives the header fields in host byte order
+ * @param maxPayload Largest payload length accepted
+ * @return WIRE_OK if the header is valid, WIRE_INCOMPLETE if fewer than
+ *         WIRE_HEADER_SIZE bytes are buffered, otherwise the reason it is invalid
+ */
+WireStatus decodeHeader(const uint8_t *data, size_t size, WireHeader &header, uint32_t maxPayload = WIRE_MAX_REQUEST);
+
+/**
+ * @brief Decodes the header at the front of a receive buffer, without copying the payload.
+ * @param data Start of the buffered bytes
+ * @param size Number of buffered bytes
+ * @param header Receives the header fields in host byte order
+ * @param maxPayload Largest payload length accepted
+ * @return WIRE_OK once header and whole payload are buffered, WIRE_INCOMPLETE
+ *         if more bytes are needed, otherwise the reason the message is invalid
+ */
+WireStatus parseHeader(const uint8_t *data, size_t size, WireHeader &header, uint32_t maxPayload = WIRE_MAX_REQUEST);
+
+/**
+ * @brief Builds a complete message (header + payload) for small control-path messages.
+ */
+std::vector<uint8_t> buildMessage(uint8_t type, uint16_t flags, uint32_t seq, const uint8_t *payload, size_t length);
+
+/**
+ * @brief Encodes a FrameInfo descriptor into network byte order.
+ */
+FrameInfo makeFrameInfo(uint16_t index, uint16_t count, uint8_t color, uint8_t encoding, uint8_t planes = 0);
+
+/**
+ * @brief Decodes a network byte order FrameInfo descriptor into host order.
+ */
+FrameInfo readFrameInfo(const uint8_t *data);
+
+/**
+ * @brief Appends a ColorMatrix as 12 network byte order Q16.16 values (COLOR_MATRIX_WIRE_SIZE bytes).
+ */
+void appendColorMatrix(std::vector<uint8_t> &out, const ColorMatrix &matrix);
+
+/**
+ * @brief Decodes COLOR_MATRIX_WIRE_SIZE bytes written by appendColorMatrix().
+ */
+ColorMatrix readColorMatrix(const uint8_t *data);
+
+/**
+ * @brief Encodes a RegionInfo into network byte order.
+ */
+RegionInfo makeRegionInfo(uint16_t x, uint16_t y, uint16_t width, uint16_t height, uint16_t scale,
+                          uint16_t captureWidth = 0, uint16_t captureHeight = 0);
+
+/**
+ * @brief Encodes a host order RegionInfo into network byte order.
+ */
+RegionInfo makeRegionInfo(const RegionInfo &region);
+
+/**
+ * @brief Decodes a network byte order RegionInfo into host order.
+ */
+RegionInfo readRegionInfo(const uint8_t *data);
+
+/**
+ * @brief Encodes a StreamStatus into network byte order.
+ */
+StreamStatus makeStreamStatus(uint32_t delivered, uint32_t dropped);
+
+/**
+ * @brief Decodes a network byte order StreamStatus into host order.
+ */
+StreamStatus readStreamStatus(const uint8_t *data);
+#endif
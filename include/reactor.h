@@ -0,0 +1,206 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <stdexcept>
+#include <unordered_map>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define DEFAULT_IO_THREADS 2
+#define REACTOR_MAX_EVENTS 64
+#define REACTOR_READ_CHUNK 65536
+#define REACTOR_INPUT_LIMIT (1 << 20) // Default cap on bytes buffered but not yet consumed
+#define REACTOR_MAX_IOV 64
+#define ZEROCOPY_THRESHOLD 65536 // Smaller buffers are cheaper to copy than to pin
+#define REACTOR_SWEEP_MS 1000     // Idle connection sweep interval
+
+/**
+ * @brief A contiguous run of bytes queued for transmission.
+ * @details The owner keeps the underlying buffer alive until the reactor has
+ *          written every byte, so encoded frames are never copied into the queue.
+ */
+struct OutChunk
+{
+    std::shared_ptr<const std::vector<uint8_t>> owner;
+    const uint8_t *data;
+    size_t size;
+};
+
+/**
+ * @brief Builds an OutChunk which takes ownership of a byte buffer.
+ */
+OutChunk makeChunk(std::vector<uint8_t> &&bytes);
+
+/**
+ * @brief Builds an OutChunk by copying a small trivially-copyable value (e.g. a header field).
+ */
+template <class T>
+OutChunk makeValueChunk(const T &value)
+{
+    const uint8_t *raw = reinterpret_cast<const uint8_t *>(&value);
+    return makeChunk(std::vector<uint8_t>(raw, raw + sizeof(T)));
+}
+
+/**
+ * @brief Buffers handed to the kernel by one MSG_ZEROCOPY sendmsg() call.
+ * @details Released only once the kernel reports the call's sequence number
+ *          complete on the socket error queue.
+ */
+struct ZeroCopyBatch
+{
+    uint32_t seq;
+    std::vector<std::shared_ptr<const std::vector<uint8_t>>> owners;
+};
+
+struct ReactorStats
+{
+    uint64_t sendCalls;      // sendmsg() calls issued
+    uint64_t bytesSent;
+    uint64_t zerocopyCalls;  // sendmsg() calls issued with MSG_ZEROCOPY
+    uint64_t zerocopyCopied; // Completions where the kernel fell back to copying
+};
+
+/**
+ * @brief Per-socket state owned by one IO thread.
+ * @details Protocol handlers derive from this to attach their own session state.
+ *          Every member is only touched on the owning IO thread; other threads
+ *          must go through Reactor::post().
+ */
+class Connection
+{
+public:
+    Connection(int fd) : fd(fd), loop(0), outOffset(0), closing(false), closed(false), zerocopy(false), zcNextSeq(0), lastActive(std::chrono::steady_clock::now()) {};
+    virtual ~Connection() = default;
+
+    int fd;
+    size_t loop;                  // Index of the owning IO thread
+    std::vector<uint8_t> inbuf;   // Bytes received but not yet consumed by the handler
+    std::deque<OutChunk> outq;    // Bytes waiting for the socket to become writable
+    size_t outOffset;             // Bytes of outq.front() already written
+    bool closing;                 // Close once outq drains
+    bool closed;
+
+    bool zerocopy;                      // SO_ZEROCOPY enabled and still worthwhile
+    uint32_t zcNextSeq;                 // Sequence number of the next MSG_ZEROCOPY call
+    std::deque<ZeroCopyBatch> zcPending; // Buffers the kernel may still be reading
+
+    std::chrono::steady_clock::time_point lastActive; // Last successful read or write
+};
+
+/**
+ * @brief Protocol callbacks invoked by the reactor on the connection's IO thread.
+ */
+class ConnectionHandler
+{
+public:
+    virtual ~ConnectionHandler() = default;
+
+    virtual std::shared_ptr<Connection> makeConnection(int fd) { return std::make_shared<Connection>(fd); }
+    virtual void onData(const std::shared_ptr<Connection> &conn) = 0;  // inbuf has new bytes
+    virtual void onDrained(const std::shared_ptr<Connection> &conn) {} // outq became empty
+    virtual void onClose(const std::shared_ptr<Connection> &conn) {}
+    virtual bool canExpire(const std::shared_ptr<Connection> &conn) { return true; } // Idle sweep may close it
+};
+
+/**
+ * @brief Edge-triggered epoll reactor multiplexing all client sockets.
+ * @details A small, fixed number of IO threads each own an epoll instance and
+ *          share the listening socket via EPOLLEXCLUSIVE. Sockets are non-blocking;
+ *          reads are drained until EAGAIN and writes are queued and resumed on
+ *          EPOLLOUT, so connection count no longer dictates thread count.
+ */
+class Reactor
+{
+public:
+    // Constructors
+    Reactor(ConnectionHandler &handler) : Reactor(handler, DEFAULT_IO_THREADS) {};
+    Reactor(ConnectionHandler &handler, size_t ioThreads);
+
+    // Deconstructor
+    ~Reactor();
+
+    // Listening Loop
+    void run(int listenFd); // Blocks, calling thread becomes IO thread 0
+    void stop();
+    void setIdleTimeout(std::chrono::milliseconds timeout); // 0 keeps idle connections forever
+    void setInputLimit(size_t bytes); // Largest inbuf before reading stops
+
+    // Thread-safe: run 'task' on the connection's IO thread (skipped if it has closed)
+    void post(const std::shared_ptr<Connection> &conn, std::function<void()> task);
+
+    // IO-thread only
+    void queue(const std::shared_ptr<Connection> &conn, OutChunk chunk);
+    void queue(const std::shared_ptr<Connection> &conn, std::vector<OutChunk> chunks); // One gathered write
+    void closeWhenDrained(const std::shared_ptr<Connection> &conn);
+    void close(const std::shared_ptr<Connection> &conn);
+
+    // Accessors
+    size_t getIoThreads() const { return this->loops.size(); }
+    size_t getConnectionCount() const { return this->connectionCount.load(); }
+    ReactorStats getStats() const;
+
+private:
+    struct EventLoop
+    {
+        int epollFd;
+        int wakeFd;
+        std::thread thread;
+        std::mutex postMutex;
+        std::vector<std::function<void()>> posted;
+        std::unordered_map<int, std::shared_ptr<Connection>> connections;
+    };
+
+    ConnectionHandler &handler;
+    std::vector<std::unique_ptr<EventLoop>> loops;
+    std::atomic<bool> running;
+    std::atomic<size_t> connectionCount;
+    int listenFd;
+    std::chrono::milliseconds idleTimeout;
+    size_t inputLimit;
+
+    std::atomic<uint64_t> sendCalls;
+    std::atomic<uint64_t> bytesSent;
+    std::atomic<uint64_t> zerocopyCalls;
+    std::atomic<uint64_t> zerocopyCopied;
+
+    void loopBody(size_t index);
+    void acceptAll(size_t index);
+    void readAll(const std::shared_ptr<Connection> &conn);
+    void flush(const std::shared_ptr<Connection> &conn);
+    void drainErrorQueue(const std::shared_ptr<Connection> &conn);
+    void runPosted(EventLoop &loop);
+    void sweepIdle(EventLoop &loop);
+};
+
+/**
+ * @brief Switches a file descriptor to non-blocking mode.
+ */
+bool setNonBlocking(int fd);
+
+/**
+ * @brief Appends the raw bytes of a trivially-copyable value to a buffer.
+ */
+template <class T>
+void appendValue(std::vector<uint8_t> &buffer, const T &value)
+{
+    const uint8_t *raw = reinterpret_cast<const uint8_t *>(&value);
+    buffer.insert(buffer.end(), raw, raw + sizeof(T));
+}
+#endif
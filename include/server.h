@@ -8,6 +8,12 @@
 #include <nlohmann/json.hpp>
 #include <openssl/evp.h>
 #include <thread>
+#include <memory>
+#include <mutex>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <optional>
 #include <opencv4/opencv2/core.hpp>
 #include <opencv4/opencv2/imgproc.hpp>
 #include <opencv4/opencv2/highgui.hpp>
@@ -17,7 +23,17 @@
 #include <unistd.h>
 
 #include "camera.h"
+#include "capture.h"
+#include "reactor.h"
+#include "worker-pool.h"
+#include "buffer-pool.h"
+#include "single-flight.h"
+#include "protocol.h"
+#include "multicast.h"
+#include "image-kernels.h"
+#include "denoise.h"
 #include "shannon-fano.h"
+#include "lossless-codec.h"
 
 /** TODO List: Server
  *  TODO: Create Finite State Machine to keep track of which stage application is in
@@ -57,12 +73,122 @@ enum state
     RST_STAGE  // Reset Stage
 };
 
-class Server
+// Per-connection protocol phase, driven by the reactor callbacks
+enum SessionPhase
+{
+    READ_REQUEST, // Waiting for the next request, binary sessions return here after every response
+    PROCESSING,   // Request handed to compute stage
+    WAIT_ACK,     // Frame sent, waiting for client acknowledgement
+    WAIT_BATCH,   // Every frame sent back-to-back, waiting for end-of-batch summary
+    STREAMING,    // Subscribed, frame sets pushed without acknowledgement until MSG_UNSUBSCRIBE
+    DONE          // Response complete, closing (legacy connections only)
+};
+
+// Wire format spoken on a connection, detected from its first bytes
+enum WireProtocol
+{
+    PROTO_UNKNOWN,
+    PROTO_LEGACY, // size_t prefixed JSON request, raw host-order response fields
+    PROTO_BINARY  // Versioned fixed-header messages, see protocol.h
+};
+
+#define LEGACY_ACK_SIZE sizeof(int)
+#define STREAM_MAX_FPS 60
+#define MAX_REQUEST_FILTERS UINT8_MAX // Frames per request, as bounded by the wire count byte
+#define STREAM_POLL_MS 5 // Re-check interval while a subscriber waits for a newer capture
+#define DEFAULT_IDLE_TIMEOUT std::chrono::seconds(30) // Idle binary sessions are closed after this
+#define DEFAULT_DENOISE DENOISE_GRID
+#define DEFAULT_KEYFRAME_INTERVAL 30 // Delta sessions get full frames at least every this many responses
+
+struct EncodedFrame
+{
+    int color;                                         // Index of the filter which produced the frame
+    std::shared_ptr<const std::vector<uint8_t>> data;  // PNG or lossless container, as encoding says
+    uint32_t checksum;                                 // CRC-32 of FrameInfo + data, for MSG_FRAME
+    uint32_t multicastId;                              // Frame id on the multicast group, 0 if not multicast
+    uint8_t planes;                                    // CHANNEL_* bits of a single-plane frame, 0: BGR frame
+    RegionInfo region;                                 // Geometry delivered (host order), scale 0 unless a region was requested
+    uint8_t encoding;                                  // FrameEncoding of data
+    cv::Mat pixels;                                    // Image as transmitted, reference of the session's next delta
+};
+
+// Encoded response shared by every request coalesced onto the same computation
+typedef std::shared_ptr<const std::vector<EncodedFrame>> FrameSet;
+
+// What a capture request asks for, whichever protocol it arrived on
+struct CaptureRequest
+{
+    std::vector<ColorMatrix> filters;
+    DenoiseMode denoise;
+    RegionInfo region; // Crop and downscale (host order), scale 0: the full frame
+};
+
+// Identifies interchangeable work: same captured frame, same filters, same encoding
+struct FlightKey
+{
+    uint64_t generation;
+    std::vector<int32_t> filters; // Q16.16 coefficients of every ColorMatrix, as on the wire
+    std::string encoding; // ".png" or LOSSLESS_EXTENSION
+    bool multicast; // Leader sends the result to the multicast group once
+    bool planes;    // Single-band filters are encoded as one 8-bit plane
+    uint8_t denoise; // DenoiseMode applied to the capture
+    std::array<uint16_t, 5> region; // x, y, width, height and scale as requested
+
+    auto operator<=>(const FlightKey &) const = default;
+};
+
+// Subscription state, shared between the stream scheduler and the connection's IO thread
+struct StreamState
+{
+    std::atomic<bool> active{false};   // Subscribed and connection open
+    std::atomic<bool> inflight{false}; // A frame set is being computed for this subscriber
+    std::atomic<uint32_t> delivered{0};
+    std::atomic<uint32_t> dropped{0};
+
+    // Guarded by Server::streamMutex
+    std::chrono::steady_clock::duration interval{};
+    std::chrono::steady_clock::time_point due{};
+    uint64_t generation = 0; // Capture generation last scheduled
+    CaptureRequest capture;
+    bool planes = false;
+    bool lossless = false;
+
+    // IO thread only
+    uint32_t seq = 0;        // MSG_SUBSCRIBE sequence number, echoed by pushed messages
+    FrameSet pending;        // Latest set waiting for the socket to drain, older ones are dropped
+};
+
+class ClientConnection : public Connection
+{
+public:
+    ClientConnection(int fd) : Connection(fd), phase(READ_REQUEST), protocol(PROTO_UNKNOWN), seq(0), nextFrame(0), pipelined(false), multicast(false), planes(false), lossless(false), delta(false), keyframe(false), sinceKeyframe(0), served(0) {};
+
+    uint8_t phase;
+    uint8_t protocol;
+    uint32_t seq;     // Sequence number of the request being answered
+    nlohmann::json request;
+    FrameSet frames;
+    size_t nextFrame;
+    bool pipelined;   // Client negotiated back-to-back delivery
+    bool multicast;   // Frames go to the multicast group, the session only gets an index
+    bool planes;      // Plane transport requested (WIRE_FLAG_PLANES)
+    bool lossless;    // Native lossless codec accepted (WIRE_FLAG_LOSSLESS)
+    bool delta;       // Client keeps its last frames (WIRE_FLAG_DELTA)
+    bool keyframe;    // Next response must be full frames
+    size_t sinceKeyframe;           // Responses carrying deltas since the last full set
+    std::vector<cv::Mat> reference; // Frames the client holds, by index; only touched while PROCESSING
+    std::vector<int32_t> referenceFilters;  // FlightKey::filters the references were computed with
+    std::array<uint16_t, 5> referenceRegion{}; // FlightKey::region of the references
+    size_t served;    // Responses completed on this connection
+    StreamState stream;
+};
+
+class Server : public ConnectionHandler
 {
 public:
     // Constructors
-    Server() : serverPort(39554), state(IDLE_STAGE), serverSocket(socket(AF_INET, SOCK_STREAM, 0)) {};
-    Server(int port) : serverPort(port), state(IDLE_STAGE), serverSocket(socket(AF_INET, SOCK_STREAM, 0)) {};
+    Server() : serverPort(39554), state(IDLE_STAGE), serverSocket(socket(AF_INET, SOCK_STREAM, 0)), ioThreads(DEFAULT_IO_THREADS), queueCapacity(0), overflowPolicy(REJECT_WHEN_FULL), idleTimeout(DEFAULT_IDLE_TIMEOUT), multicastPort(0), multicastFec(MCAST_DEFAULT_FEC), denoise(DEFAULT_DENOISE), keyframeInterval(DEFAULT_KEYFRAME_INTERVAL) {};
+    Server(int port) : serverPort(port), state(IDLE_STAGE), serverSocket(socket(AF_INET, SOCK_STREAM, 0)), ioThreads(DEFAULT_IO_THREADS), queueCapacity(0), overflowPolicy(REJECT_WHEN_FULL), idleTimeout(DEFAULT_IDLE_TIMEOUT), multicastPort(0), multicastFec(MCAST_DEFAULT_FEC), denoise(DEFAULT_DENOISE), keyframeInterval(DEFAULT_KEYFRAME_INTERVAL) {};
 
     // Mutators
     void setListeningAddress( const std::string& );
@@ -70,15 +196,31 @@ public:
 
     void setServerPort(const char *mAddr, int port); // Setup the server Address and Port
     void setupServer();                              // Create listening socket
-    cv::Mat getCameraFrame();                        // Access media and retrieve image
+    void setIoThreads(size_t threads);               // Number of reactor IO threads
+    void setAdmission(size_t capacity, OverflowPolicy policy); // Bound on queued requests
+    void setIdleTimeout(std::chrono::milliseconds timeout);    // Close sessions idle this long, 0 never
+    void setMulticast(const std::string &group, int port, uint8_t fecGroup = MCAST_DEFAULT_FEC); // Enable multicast delivery
+    void setDenoise(DenoiseMode mode);               // Denoise used when a request does not pick one
+    void setKeyframeInterval(size_t responses);      // Full frames at least every n responses of a delta session, 1: never deltas
+    void setCaptureSource(const std::string &spec);  // V4L2 device[:format[:WxH]] instead of the default camera
+    cv::Mat getCameraFrame(DenoiseMode mode, RegionInfo &region); // Access media and retrieve image
 
     // Accessors
     std::string getListeningAddress() const;
     int getListeningPort() const;
+    PoolStats getComputeStats();
+    BufferStats getBufferStats();
 
     // Listening Loop
     void serverLoop(); // Main server loop
 
+    // Reactor Callbacks
+    std::shared_ptr<Connection> makeConnection(int fd) override;
+    void onData(const std::shared_ptr<Connection> &conn) override;
+    bool canExpire(const std::shared_ptr<Connection> &conn) override;
+    void onDrained(const std::shared_ptr<Connection> &conn) override;
+    void onClose(const std::shared_ptr<Connection> &conn) override;
+
 private:
     std::string listenAddr;  // Listening address
     int serverPort;
@@ -88,9 +230,71 @@ private:
 
     int serverSocket;
 
+    BufferPool buffers;      // Pixel and payload buffers recycled across requests, outlives every frame
+    CameraCapture camera;    // Shared capture stream, owned for the server lifetime
+
+    size_t ioThreads;
+    size_t queueCapacity;
+    OverflowPolicy overflowPolicy;
+    std::chrono::milliseconds idleTimeout;
+    std::string multicastGroup;  // Empty: multicast delivery disabled
+    int multicastPort;
+    uint8_t multicastFec;
+    std::unique_ptr<MulticastSender> multicast;
+    DenoiseMode denoise;
+    size_t keyframeInterval;
+
+    // Measured denoise latency per mode, for the stats reply
+    std::array<std::atomic<uint64_t>, DENOISE_MODES> denoiseFrames{};
+    std::array<std::atomic<uint64_t>, DENOISE_MODES> denoiseMicros{};
+
+    // Delta transport savings, for the stats reply
+    std::atomic<uint64_t> deltaFrames{0};
+    std::atomic<uint64_t> deltaBytesSaved{0};
+
+    // Pipelined batch summaries from clients, for the stats reply
+    std::atomic<uint64_t> batchesAcked{0};
+    std::atomic<uint64_t> batchFramesMissed{0};
+
+    // Subscription scheduler
+    std::mutex streamMutex;
+    std::condition_variable streamWake;
+    std::vector<std::weak_ptr<ClientConnection>> subscribers;
+    std::thread streamThread;
+    bool streaming = false;
+    std::unique_ptr<Reactor> reactor;    // IO stage: multiplexes every client socket
+    std::unique_ptr<WorkerPool> compute; // Compute stage: work-stealing pool sized to the core count
+    SingleFlight<FlightKey, FrameSet> inflight; // Coalesces identical concurrent requests
+
     // Private Client Handle
-    void client_handle(int client_socket); // Client thread
-    bool imageProc(const cv::Mat &input, const std::vector<Filter> &filters, std::vector<std::pair<cv::Mat, std::string>> &ret_val);
-    std::vector<Filter> buildFilterArray( nlohmann::json& request );
+    void client_handle(FlightKey key, CaptureRequest request); // Compute stage job
+    void deliverFrames(const std::shared_ptr<ClientConnection> &conn, const FrameSet &frames);
+    void onLegacyData(const std::shared_ptr<ClientConnection> &conn);
+    void onWireData(const std::shared_ptr<ClientConnection> &conn);
+    void handleControl(const std::shared_ptr<ClientConnection> &conn, uint32_t seq, const std::string &text);
+    void handleNack(const std::shared_ptr<ClientConnection> &conn, uint32_t seq, const uint8_t *payload, size_t length);
+    void sendMulticastIndex(const std::shared_ptr<ClientConnection> &conn);
+    void sendWireError(const std::shared_ptr<ClientConnection> &conn, uint32_t seq, const std::string &message);
+    void startRequest(const std::shared_ptr<ClientConnection> &conn, const CaptureRequest &request);
+    FrameSet encodeDeltas(const std::shared_ptr<ClientConnection> &conn, const FrameSet &frames);
+    FlightKey makeFlightKey(uint64_t generation, const CaptureRequest &request, bool multicast, bool planes, bool lossless);
+    void runFlight(const FlightKey &key, const CaptureRequest &request, SingleFlight<FlightKey, FrameSet>::Callback callback);
+    void subscribe(const std::shared_ptr<ClientConnection> &conn, uint32_t seq, uint16_t flags, const uint8_t *payload, size_t length);
+    void unsubscribe(const std::shared_ptr<ClientConnection> &conn, uint32_t seq);
+    void streamLoop();
+    void deliverStream(const std::shared_ptr<ClientConnection> &conn, const FrameSet &frames);
+    void sendStreamSet(const std::shared_ptr<ClientConnection> &conn, FrameSet frames);
+    void finishBatch(const std::shared_ptr<ClientConnection> &conn, size_t received);
+    void finishResponse(const std::shared_ptr<ClientConnection> &conn);
+    void appendFrameHeader(const std::shared_ptr<ClientConnection> &conn, size_t index, std::vector<uint8_t> &header);
+    void sendFrame(const std::shared_ptr<ClientConnection> &conn, std::vector<uint8_t> prefix = {});
+    void sendBatch(const std::shared_ptr<ClientConnection> &conn, std::vector<uint8_t> prefix);
+    cv::Mat regionOf(const cv::Mat &capture, RegionInfo &region);
+    cv::Rect regionRectOf(cv::Size capture, RegionInfo &region);
+    bool imageProc(const cv::Mat &input, const std::vector<ColorMatrix> &filters, std::vector<cv::Mat> &ret_val, bool planes = false);
+    std::vector<ColorMatrix> buildFilterArray( nlohmann::json& request );
+    std::vector<ColorMatrix> buildFilterArray( const std::vector<int>& frames );
+    CaptureRequest buildCaptureRequest( nlohmann::json& request );
+    CaptureRequest parseCaptureRequest( const uint8_t *payload, size_t length, uint16_t flags );
 };
 #endif
\ No newline at end of file
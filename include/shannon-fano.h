@@ -10,25 +10,29 @@
 #include <iostream>
 #include <format>
 
-
-class ShannonFano
+#include "entropy-coder.h"
+
+/**
+ * @brief Shannon-Fano prefix code: symbols sorted by count are split recursively
+ *        into halves of (nearly) equal count.
+ * @details The byte coder (buildTable, encode, decode and the table format)
+ *          comes from PrefixCoder, this class only picks the code lengths. The
+ *          string API below is the original character-level prototype.
+ */
+class ShannonFano : public PrefixCoder
 {
 public:
     ShannonFano();
     ShannonFano(const std::map<char, double> &frequencies);
 
-    /**
-     * @brief Encodes the input data using the Shannon-Fano algorithm.
-     * @details
-     */
-    void encode();
+    using PrefixCoder::decode;
 
     /**
      * @brief Decodes the input data using the Shannon-Fano algorithm.
      * @param encoded The encoded string to decode.
-     * @details
+     * @return The decoded string
      */
-    void decode(const std::string &encoded);
+    std::string decode(const std::string &encoded) const;
 
     /**
      * @brief Prints the codes for each character.
@@ -45,6 +49,11 @@ public:
 
     void buildCodes(std::map<char, double> &freqs, const std::string &input);
 
+    CoderId id() const override { return CODER_SHANNON_FANO; }
+
+protected:
+    int buildLengths(const std::array<uint64_t, CODER_SYMBOLS> &counts, std::array<uint8_t, CODER_SYMBOLS> &lengths) const override;
+
 private:
     std::map<char, double> frequencies;
     std::map<char, std::string> codes;
@@ -53,6 +62,7 @@ private:
     void sortFrequencies();
     void normalizeFrequencies();
     void buildCodesRecursive(std::vector<std::pair<char, double>> &freqs, std::string code, size_t start, size_t end);
+    int splitLengths(const std::vector<std::pair<uint8_t, uint64_t>> &symbols, size_t start, size_t end, int depth, std::array<uint8_t, CODER_SYMBOLS> &lengths) const;
 };
 
 template <class T>
@@ -0,0 +1,88 @@
+#ifndef SINGLE_FLIGHT_H
+#define SINGLE_FLIGHT_H
+
+#include <map>
+#include <mutex>
+#include <vector>
+#include <functional>
+
+/**
+ * @brief Coalesces concurrent requests for the same key into one computation.
+ * @details The first caller to join() a key becomes the leader and is expected
+ *          to compute the value and call complete(). Callers joining while that
+ *          flight is in progress only register a callback, so N identical
+ *          requests cost one computation and all receive the same value.
+ *          Nothing is cached once a flight lands.
+ */
+template <class Key, class Value>
+class SingleFlight
+{
+public:
+    using Callback = std::function<void(const Value &)>;
+
+    /**
+     * @brief Registers interest in 'key'.
+     * @param key Identifies the computation
+     * @param callback Invoked with the value once the flight completes
+     * @return true if the caller is the leader and must compute the value
+     */
+    bool join(const Key &key, Callback callback)
+    {
+        std::lock_guard<std::mutex> lock(this->flightMutex);
+        auto found = this->inflight.find(key);
+        if (found != this->inflight.end())
+        {
+            found->second.push_back(std::move(callback));
+            this->coalesced++;
+            return false;
+        }
+        this->inflight[key].push_back(std::move(callback));
+        this->flights++;
+        return true;
+    }
+
+    /**
+     * @brief Lands the flight for 'key' and hands 'value' to every waiter.
+     * @return Number of callbacks invoked
+     */
+    size_t complete(const Key &key, const Value &value)
+    {
+        std::vector<Callback> waiters;
+        {
+            std::lock_guard<std::mutex> lock(this->flightMutex);
+            auto found = this->inflight.find(key);
+            if (found == this->inflight.end())
+            {
+                return 0;
+            }
+            waiters.swap(found->second);
+            this->inflight.erase(found);
+        }
+
+        // Callbacks run outside the lock so they may start new flights
+        for (auto &callback : waiters)
+        {
+            callback(value);
+        }
+        return waiters.size();
+    }
+
+    // Accessors
+    uint64_t getFlights()
+    {
+        std::lock_guard<std::mutex> lock(this->flightMutex);
+        return this->flights;
+    }
+    uint64_t getCoalesced()
+    {
+        std::lock_guard<std::mutex> lock(this->flightMutex);
+        return this->coalesced;
+    }
+
+private:
+    std::mutex flightMutex;
+    std::map<Key, std::vector<Callback>> inflight;
+    uint64_t flights = 0;   // Computations started
+    uint64_t coalesced = 0; // Requests served by joining an existing flight
+};
+#endif
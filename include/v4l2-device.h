@@ -0,0 +1,106 @@
+#ifndef V4L2_DEVICE_H
+#define V4L2_DEVICE_H
+
+#include <stdint.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <linux/videodev2.h>
+#include <opencv4/opencv2/core.hpp>
+
+/** V4L2 Capture
+ *  Direct Video4Linux2 access for CameraCapture, bypassing cv::VideoCapture.
+ *  The device is asked for an explicit pixel format and resolution, frames are
+ *  captured into driver buffers mapped with mmap, and each reader converts
+ *  straight out of the mapped buffer into its own BGR image. Only the region a
+ *  request asked for is converted, there is no intermediate BGR copy of the
+ *  whole frame.
+ *
+ *  Sources are written device[:format[:WIDTHxHEIGHT]], e.g. /dev/video0:NV12:1280x720.
+ *  Without a real camera, the vivid virtual driver (modprobe vivid) serves YUYV
+ *  and NV12 test patterns.
+ */
+
+#define V4L2_DEFAULT_FORMAT V4L2_PIX_FMT_YUYV
+#define V4L2_DEFAULT_WIDTH 640
+#define V4L2_DEFAULT_HEIGHT 480
+#define V4L2_MIN_BUFFERS 3 // Published frame, one being filled, one spare for readers
+
+struct CaptureFormat
+{
+    uint32_t pixelFormat; // V4L2_PIX_FMT_YUYV, V4L2_PIX_FMT_NV12 or V4L2_PIX_FMT_MJPEG
+    int width;
+    int height;
+    size_t stride;        // Bytes per line of the (luma) plane, as negotiated
+};
+
+/**
+ * @brief Parses a capture source, device[:format[:WIDTHxHEIGHT]].
+ * @details Formats are YUYV, NV12 and MJPG (or MJPEG); unspecified parts take
+ *          the V4L2_DEFAULT_* values.
+ * @return false if the format or resolution is malformed or unsupported
+ */
+bool parseCaptureSource(const std::string &spec, std::string &path, CaptureFormat &format);
+
+/**
+ * @brief Four character name of a pixel format, e.g. "YUYV".
+ */
+std::string pixelFormatName(uint32_t pixelFormat);
+
+/**
+ * @brief Converts a region of a raw driver frame to BGR.
+ * @details YUYV and NV12 regions are widened to even coordinates (chroma is
+ *          shared by pixel pairs) and converted alone; the output is then a
+ *          view of exactly the region. MJPEG frames are decoded whole.
+ * @param raw Frame as mapped by V4l2Device::view()
+ * @param format Negotiated format of the frame
+ * @param roi Region to convert, empty for the whole frame; must lie within the frame
+ * @param bgr Receives a CV_8UC3 image of the region, allocated with its own allocator if it has one
+ * @return false if the format is unsupported or the frame is empty or corrupt
+ */
+bool convertCapture(const cv::Mat &raw, const CaptureFormat &format, const cv::Rect &roi, cv::Mat &bgr);
+
+/**
+ * @brief Streaming mmap capture from one V4L2 device.
+ * @details Every buffer is owned either by the driver (queued) or by the caller
+ *          between dequeue() and queue(); a dequeued buffer is stable for as
+ *          long as the caller holds it.
+ */
+class V4l2Device
+{
+public:
+    // Constructors
+    V4l2Device() : fd(-1), format{} {};
+
+    // Deconstructor
+    ~V4l2Device();
+
+    V4l2Device(const V4l2Device &) = delete;
+    V4l2Device &operator=(const V4l2Device &) = delete;
+
+    // Mutators
+    bool open(const std::string &path, CaptureFormat &format, size_t buffers); // Negotiate, map every buffer and stream
+    void close();                                                             // Stop streaming and unmap
+    int dequeue(size_t &bytes, std::chrono::milliseconds timeout);            // Filled buffer index, -1 on timeout or error
+    bool queue(int index);                                                    // Hand a buffer back to the driver
+
+    // Accessors
+    bool isOpen() const { return this->fd >= 0; }
+    size_t bufferCount() const { return this->buffers.size(); }
+    const CaptureFormat &getFormat() const { return this->format; }
+    cv::Mat view(int index, size_t bytes) const; // Raw frame in a dequeued buffer, no copy
+
+    static std::string findDevice(const std::string &driver); // First /dev/video* served by a driver, e.g. "vivid"
+
+private:
+    struct Mapping
+    {
+        void *start;
+        size_t length;
+    };
+
+    int fd;
+    CaptureFormat format;
+    std::vector<Mapping> buffers;
+};
+#endif
@@ -0,0 +1,106 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+#define DEFAULT_QUEUE_PER_WORKER 4
+
+// Behaviour of submit() when the bounded queue is full
+enum OverflowPolicy
+{
+    REJECT_WHEN_FULL, // Fail fast, caller sends a busy response
+    BLOCK_WHEN_FULL   // Caller waits for a queue slot (back-pressures the submitter)
+};
+
+struct PoolStats
+{
+    size_t threads;
+    size_t capacity;
+    size_t queueDepth;     // Jobs queued but not yet started
+    size_t peakQueueDepth;
+    uint64_t submitted;
+    uint64_t rejected;
+    uint64_t completed;
+    uint64_t stolen;       // Jobs run by a worker other than the one they were queued on
+    double avgWaitMs;      // Mean time from submit() to start of execution
+    double maxWaitMs;
+};
+
+/**
+ * @brief Fixed-size work-stealing thread pool with a bounded queue.
+ * @details Each worker owns a deque. Jobs submitted from outside the pool are
+ *          spread round-robin, jobs submitted from a worker stay on that worker.
+ *          An idle worker first drains its own deque, then steals from the tail
+ *          of its siblings. The total number of queued jobs is capped so that
+ *          overload turns into rejections (or submitter back-pressure) instead
+ *          of hundreds of concurrent jobs thrashing every cache.
+ */
+class WorkerPool
+{
+public:
+    // Constructors
+    WorkerPool() : WorkerPool(std::thread::hardware_concurrency()) {};
+    WorkerPool(size_t threads) : WorkerPool(threads, 0, REJECT_WHEN_FULL) {};
+    WorkerPool(size_t threads, size_t capacity, OverflowPolicy policy);
+
+    // Deconstructor
+    ~WorkerPool();
+
+    // Mutators
+    bool submit(std::function<void()> job); // false if rejected or shut down
+    void shutdown();
+
+    // Accessors
+    size_t size() const { return this->workers.size(); }
+    size_t getCapacity() const { return this->capacity; }
+    OverflowPolicy getPolicy() const { return this->policy; }
+    PoolStats getStats();
+
+private:
+    struct Job
+    {
+        std::function<void()> fn;
+        std::chrono::steady_clock::time_point queued;
+        size_t owner;
+    };
+
+    struct WorkerQueue
+    {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    size_t capacity;
+    OverflowPolicy policy;
+
+    std::mutex stateMutex;             // Guards pending and running
+    std::condition_variable jobReady;
+    std::condition_variable spaceFreed;
+    size_t pending;
+    bool running;
+    std::atomic<size_t> nextQueue;
+
+    // Statistics
+    size_t peakPending;
+    std::atomic<uint64_t> submitted;
+    std::atomic<uint64_t> rejected;
+    std::atomic<uint64_t> completed;
+    std::atomic<uint64_t> stolen;
+    std::atomic<uint64_t> totalWaitUs;
+    std::atomic<uint64_t> maxWaitUs;
+
+    void workerLoop(size_t index);
+    bool popJob(size_t index, Job &job);
+};
+#endif
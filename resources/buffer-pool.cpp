@@ -0,0 +1,245 @@
+#include "buffer-pool.h"
+
+/**
+ * @brief Creates an empty pool.
+ * @param idleLimit Bytes of idle buffers kept for reuse, beyond this the least recently returned are freed
+ */
+BufferPool::BufferPool(size_t idleLimit) : idleLimit(idleLimit), returns(0), stats{}
+{
+}
+
+/**
+ * @brief Frees every idle buffer. Buffers still handed out must not outlive the pool.
+ */
+BufferPool::~BufferPool()
+{
+    trim();
+}
+
+/**
+ * @brief Empty matrix whose storage comes from the pool.
+ * @details Pass it as the output of any OpenCV call: create() draws a buffer of
+ *          the right size from the pool, and the buffer returns once the last
+ *          matrix sharing it is released.
+ */
+cv::Mat BufferPool::acquire()
+{
+    cv::Mat mat;
+    mat.allocator = this;
+    return mat;
+}
+
+/**
+ * @brief Matrix of the given geometry backed by a pooled buffer, contents undefined.
+ */
+cv::Mat BufferPool::acquire(cv::Size size, int type)
+{
+    cv::Mat mat = acquire();
+    mat.create(size, type);
+    return mat;
+}
+
+/**
+ * @brief Empty byte vector for an encoder to write into.
+ * @details The smallest idle vector with enough capacity is reused. Its capacity,
+ *          grown or not, is kept for the next request once every reference is dropped.
+ * @param capacity Expected output size, a bound avoids regrowth while encoding
+ */
+std::shared_ptr<std::vector<uint8_t>> BufferPool::acquireBytes(size_t capacity)
+{
+    std::unique_ptr<std::vector<uint8_t>> bytes;
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        auto idle = this->vectors.lower_bound(capacity);
+        if (idle != this->vectors.end())
+        {
+            bytes = std::move(idle->second.bytes);
+            this->stats.bytesIdle -= idle->first;
+            this->stats.bytesInUse += idle->first;
+            this->vectors.erase(idle);
+            this->stats.hits++;
+        }
+    }
+
+    if (!bytes)
+    {
+        bytes = std::make_unique<std::vector<uint8_t>>();
+        bytes->reserve(capacity);
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stats.misses++;
+        this->stats.bytesInUse += bytes->capacity();
+        this->stats.peakBytes = std::max(this->stats.peakBytes, this->stats.bytesInUse + this->stats.bytesIdle);
+    }
+
+    bytes->clear();
+    size_t handed = bytes->capacity();
+    return std::shared_ptr<std::vector<uint8_t>>(bytes.release(), [this, handed](std::vector<uint8_t> *returned)
+                                                 {
+                                                     std::lock_guard<std::mutex> lock(this->mutex);
+                                                     this->stats.bytesInUse -= handed;
+                                                     release(this->vectors, returned->capacity(), {nullptr, std::unique_ptr<std::vector<uint8_t>>(returned), 0});
+                                                 });
+}
+
+/**
+ * @brief Frees every idle buffer, e.g. after a burst of unusual frame sizes.
+ */
+void BufferPool::trim()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    for (auto *idle : {&this->images, &this->vectors})
+    {
+        for (auto &entry : *idle)
+        {
+            freeIdle(entry.second);
+        }
+        idle->clear();
+    }
+    this->stats.bytesIdle = 0;
+}
+
+BufferStats BufferPool::getStats()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->stats;
+}
+
+/**
+ * @brief cv::MatAllocator hook, called by cv::Mat::create() on matrices from acquire().
+ * @details Same layout as OpenCV's default allocator, only the storage is pooled.
+ *          Matrices wrapping caller memory are passed through untouched.
+ */
+cv::UMatData *BufferPool::allocate(int dims, const int *sizes, int type, void *data, size_t *step, cv::AccessFlag,
+                                   cv::UMatUsageFlags) const
+{
+    size_t total = CV_ELEM_SIZE(type);
+    for (int i = dims - 1; i >= 0; i--)
+    {
+        if (step)
+        {
+            if (data && step[i] != CV_AUTOSTEP)
+            {
+                CV_Assert(total <= step[i]);
+                total = step[i];
+            }
+            else
+            {
+                step[i] = total;
+            }
+        }
+        total *= sizes[i];
+    }
+
+    uint8_t *pixels = static_cast<uint8_t *>(data);
+    if (!pixels)
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            auto idle = this->images.find(total);
+            if (idle != this->images.end())
+            {
+                pixels = idle->second.pixels;
+                this->images.erase(idle);
+                this->stats.bytesIdle -= total;
+                this->stats.hits++;
+            }
+            else
+            {
+                this->stats.misses++;
+            }
+            this->stats.bytesInUse += total;
+            this->stats.peakBytes = std::max(this->stats.peakBytes, this->stats.bytesInUse + this->stats.bytesIdle);
+        }
+        if (!pixels)
+        {
+            pixels = static_cast<uint8_t *>(cv::fastMalloc(total));
+        }
+    }
+
+    cv::UMatData *u = new cv::UMatData(this);
+    u->data = u->origdata = pixels;
+    u->size = total;
+    if (data)
+    {
+        u->flags |= cv::UMatData::USER_ALLOCATED;
+    }
+    return u;
+}
+
+bool BufferPool::allocate(cv::UMatData *data, cv::AccessFlag, cv::UMatUsageFlags) const
+{
+    return data != nullptr;
+}
+
+/**
+ * @brief cv::MatAllocator hook, called once the last matrix sharing a buffer lets go of it.
+ */
+void BufferPool::deallocate(cv::UMatData *data) const
+{
+    if (!data)
+    {
+        return;
+    }
+    CV_Assert(data->urefcount == 0 && data->refcount == 0);
+    if (!(data->flags & cv::UMatData::USER_ALLOCATED))
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stats.bytesInUse -= data->size;
+        release(this->images, data->size, {data->origdata, nullptr, 0});
+    }
+    delete data;
+}
+
+/**
+ * @brief Files a returned buffer as idle, then trims the idle set to the limit. Caller holds the mutex.
+ */
+void BufferPool::release(std::multimap<size_t, Idle> &idle, size_t size, Idle buffer) const
+{
+    buffer.returned = ++this->returns;
+    idle.emplace(size, std::move(buffer));
+    this->stats.bytesIdle += size;
+    this->stats.peakBytes = std::max(this->stats.peakBytes, this->stats.bytesInUse + this->stats.bytesIdle);
+    evict();
+}
+
+/**
+ * @brief Frees the least recently returned idle buffers until the idle bytes fit the limit.
+ * @details Sizes which stop being requested age out, the sizes in steady use stay warm.
+ */
+void BufferPool::evict() const
+{
+    while (this->stats.bytesIdle > this->idleLimit)
+    {
+        std::multimap<size_t, Idle> *from = nullptr;
+        std::multimap<size_t, Idle>::iterator oldest;
+        for (auto *idle : {&this->images, &this->vectors})
+        {
+            for (auto entry = idle->begin(); entry != idle->end(); entry++)
+            {
+                if (!from || entry->second.returned < oldest->second.returned)
+                {
+                    from = idle;
+                    oldest = entry;
+                }
+            }
+        }
+        if (!from)
+        {
+            return;
+        }
+        freeIdle(oldest->second);
+        this->stats.bytesIdle -= oldest->first;
+        this->stats.evicted++;
+        from->erase(oldest);
+    }
+}
+
+void BufferPool::freeIdle(Idle &buffer) const
+{
+    if (buffer.pixels)
+    {
+        cv::fastFree(buffer.pixels);
+        buffer.pixels = nullptr;
+    }
+    buffer.bytes.reset();
+}
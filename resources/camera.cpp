@@ -245,6 +245,49 @@ int countChar(const std::string &input, char delim)
     return sum;
 }
 
+bool sendAll(int fd, iovec *iov, int count)
+{
+    while (count > 0)
+    {
+        ssize_t sent = writev(fd, iov, count);
+        if (sent < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+
+        // Skip fully written buffers, advance into the partially written one
+        while (count > 0 && static_cast<size_t>(sent) >= iov->iov_len)
+        {
+            sent -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0)
+        {
+            iov->iov_base = static_cast<char *>(iov->iov_base) + sent;
+            iov->iov_len -= sent;
+        }
+    }
+    return true;
+}
+
+bool recvAll(int fd, void *buffer, size_t size)
+{
+    size_t received = 0;
+    while (received < size)
+    {
+        ssize_t n = recv(fd, static_cast<char *>(buffer) + received, size - received, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        received += n;
+    }
+    return true;
+}
+
 std::string md5(const std::string &content)
 {
     EVP_MD_CTX *context = EVP_MD_CTX_new();
@@ -0,0 +1,339 @@
+#include "capture.h"
+
+/**
+ * @brief Stops the capture thread and releases the device on destruction.
+ */
+CameraCapture::~CameraCapture()
+{
+    stop();
+}
+
+/**
+ * @brief Opens the camera device and launches the background capture thread.
+ * @return true if the device was opened and the capture thread started, false otherwise.
+ */
+bool CameraCapture::start()
+{
+    if (this->running.load())
+    {
+        return true;
+    }
+
+    bool v4l2 = !this->source.empty();
+    if (!(v4l2 ? openDevice() : openCapture()))
+    {
+        return false;
+    }
+
+    this->opened.store(true);
+    this->running.store(true);
+    this->worker = std::thread(v4l2 ? &CameraCapture::deviceLoop : &CameraCapture::captureLoop, this);
+    return true;
+}
+
+/**
+ * @brief Capture from a V4L2 device node instead of cv::VideoCapture.
+ * @details Takes effect on the next start(), ignored while running.
+ * @param path Device node, e.g. /dev/video0
+ * @param format Pixel format and resolution to request (see parseCaptureSource)
+ */
+void CameraCapture::setSource(const std::string &path, const CaptureFormat &format)
+{
+    if (this->running.load())
+    {
+        return;
+    }
+    this->source = path;
+    this->format = format;
+}
+
+/**
+ * @brief Opens the cv::VideoCapture device and publishes its first frame.
+ * @details The first frame is read synchronously so that every ring slot can be
+ *          pre-allocated with the negotiated frame geometry before the loop runs;
+ *          after this point the capture thread reuses the slot buffers in place.
+ */
+bool CameraCapture::openCapture()
+{
+    this->cap.open(this->device);
+    if (!this->cap.isOpened())
+    {
+        std::cerr << "Capture::ERROR: Could not open camera device " << this->device << std::endl;
+        return false;
+    }
+
+    // Read first frame to learn the geometry the driver negotiated
+    cv::Mat first;
+    if (!this->cap.read(first) || first.empty())
+    {
+        std::cerr << "Capture::ERROR: Could not read initial frame" << std::endl;
+        this->cap.release();
+        return false;
+    }
+
+    // Pre-allocate every slot, publish the first frame in slot 0
+    for (auto &slot : this->ring)
+    {
+        slot.frame.create(first.size(), first.type());
+        slot.generation = 0;
+        slot.readers = 0;
+        slot.queued = false;
+    }
+    first.copyTo(this->ring.at(0).frame);
+    this->ring.at(0).generation = 1;
+    this->head = 0;
+    this->generation.store(1);
+    this->frameSize = first.size();
+    return true;
+}
+
+/**
+ * @brief Opens the V4L2 source and publishes its first frame.
+ * @details The ring becomes one slot per driver buffer, slot i viewing buffer
+ *          i while the capture thread holds it; nothing is copied at capture time.
+ */
+bool CameraCapture::openDevice()
+{
+    CaptureFormat negotiated = this->format;
+    if (!this->v4l2.open(this->source, negotiated, this->ring.size()))
+    {
+        return false;
+    }
+    this->format = negotiated;
+    this->frameSize = cv::Size(negotiated.width, negotiated.height);
+    this->ring.assign(this->v4l2.bufferCount(), Slot{cv::Mat(), 0, 0, true});
+
+    size_t bytes = 0;
+    int index = this->v4l2.dequeue(bytes, std::chrono::milliseconds(1000));
+    cv::Mat first = index < 0 ? cv::Mat() : this->v4l2.view(index, bytes);
+    if (first.empty())
+    {
+        std::cerr << "Capture::ERROR: Could not read initial frame from " << this->source << std::endl;
+        this->v4l2.close();
+        return false;
+    }
+
+    Slot &slot = this->ring.at(index);
+    slot.frame = first;
+    slot.generation = 1;
+    slot.queued = false;
+    this->head = index;
+    this->generation.store(1);
+    std::cout << "Capture: " << this->source << " " << pixelFormatName(negotiated.pixelFormat) << " "
+              << negotiated.width << "x" << negotiated.height << std::endl;
+    return true;
+}
+
+/**
+ * @brief Stops the capture thread, wakes any waiting readers and releases the device.
+ */
+void CameraCapture::stop()
+{
+    if (!this->running.exchange(false))
+    {
+        return;
+    }
+
+    this->slotFreed.notify_all();
+    this->frameReady.notify_all();
+    if (this->worker.joinable())
+    {
+        this->worker.join();
+    }
+
+    // Readers may still be converting out of mapped buffers
+    {
+        std::unique_lock<std::mutex> lock(this->ringMutex);
+        this->slotFreed.wait(lock, [this]()
+                             { return std::all_of(this->ring.begin(), this->ring.end(), [](const Slot &slot)
+                                                  { return slot.readers == 0; }); });
+        if (!this->source.empty())
+        {
+            for (Slot &slot : this->ring)
+            {
+                slot.frame.release();
+            }
+        }
+    }
+    this->v4l2.close();
+    this->cap.release();
+    this->opened.store(false);
+}
+
+/**
+ * @brief Copies the most recently captured frame into the caller's matrix.
+ * @param out Destination matrix, reallocated only if its geometry differs
+ * @param roi Region to copy, within getFrameSize(); empty for the whole frame
+ * @return The generation of the copied frame, or 0 if no frame is available yet
+ */
+uint64_t CameraCapture::latestFrame(cv::Mat &out, const cv::Rect &roi)
+{
+    std::unique_lock<std::mutex> lock(this->ringMutex);
+    if (this->generation.load() == 0)
+    {
+        return 0;
+    }
+    return copySlot(this->head, out, roi, lock);
+}
+
+/**
+ * @brief Blocks until a frame newer than 'after' is published and copies it out.
+ * @param after Generation the caller already holds (0 accepts any frame)
+ * @param out Destination matrix
+ * @param timeout Maximum time to wait for a new frame
+ * @param roi Region to copy, within getFrameSize(); empty for the whole frame
+ * @return The generation of the copied frame, or 0 on timeout / shutdown
+ */
+uint64_t CameraCapture::waitNextFrame(uint64_t after, cv::Mat &out, std::chrono::milliseconds timeout, const cv::Rect &roi)
+{
+    std::unique_lock<std::mutex> lock(this->ringMutex);
+    bool ready = this->frameReady.wait_for(lock, timeout, [&]()
+                                           { return this->generation.load() > after || !this->running.load(); });
+    if (!ready || this->generation.load() <= after)
+    {
+        return 0;
+    }
+    return copySlot(this->head, out, roi, lock);
+}
+
+/**
+ * @brief Pins a slot, copies it outside the ring lock and unpins it again.
+ * @details Pinning keeps the capture thread from reusing the slot while the
+ *          copy is in flight, so the device never waits on a slow reader.
+ *          V4L2 slots are converted to BGR by the reader, region only.
+ * @return The slot's generation, 0 if it could not be read
+ */
+uint64_t CameraCapture::copySlot(size_t index, cv::Mat &out, const cv::Rect &roi, std::unique_lock<std::mutex> &lock)
+{
+    Slot &slot = this->ring.at(index);
+    uint64_t gen = slot.generation;
+    slot.readers++;
+    lock.unlock();
+
+    if (this->source.empty())
+    {
+        (roi.area() ? slot.frame(roi) : slot.frame).copyTo(out);
+    }
+    else if (!convertCapture(slot.frame, this->format, roi, out))
+    {
+        out.release();
+        gen = 0;
+    }
+
+    lock.lock();
+    slot.readers--;
+    if (slot.readers == 0)
+    {
+        this->slotFreed.notify_one();
+    }
+    return gen;
+}
+
+/**
+ * @brief Picks the next slot the capture thread may write into.
+ * @details A slot is writable when it is neither the published head nor pinned
+ *          by a reader. With at least three slots this only waits when readers
+ *          are pinning every stale slot at once.
+ * @return Index of the writable slot, or ring size if the loop is shutting down
+ */
+size_t CameraCapture::acquireWriteSlot()
+{
+    std::unique_lock<std::mutex> lock(this->ringMutex);
+    size_t found = this->ring.size();
+    this->slotFreed.wait(lock, [&]()
+                         {
+        if( !this->running.load() ) return true;
+        for( size_t step = 1; step < this->ring.size(); step++ ) {
+            size_t idx = (this->head + step) % this->ring.size();
+            if( this->ring.at(idx).readers == 0 ) {
+                found = idx;
+                return true;
+            }
+        }
+        return false; });
+    return this->running.load() ? found : this->ring.size();
+}
+
+/**
+ * @brief Background loop: grab into a free slot, then publish it as the new head.
+ */
+void CameraCapture::captureLoop()
+{
+    while (this->running.load())
+    {
+        size_t index = acquireWriteSlot();
+        if (index >= this->ring.size())
+        {
+            break;
+        }
+
+        // Read straight into the pre-allocated slot buffer, outside the lock
+        if (!this->cap.read(this->ring.at(index).frame) || this->ring.at(index).frame.empty())
+        {
+            std::cerr << "Capture::ERROR: Dropped frame from device " << this->device << std::endl;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            continue;
+        }
+
+        // Publish
+        {
+            std::lock_guard<std::mutex> lock(this->ringMutex);
+            this->ring.at(index).generation = this->generation.load() + 1;
+            this->head = index;
+            this->generation.store(this->ring.at(index).generation);
+        }
+        this->frameReady.notify_all();
+    }
+}
+
+/**
+ * @brief Background loop of a V4L2 source: return released buffers to the driver, publish the next filled one.
+ * @details A buffer goes back once it is neither the newest frame nor pinned by
+ *          a reader. Readers only pin the head, so the driver always keeps at
+ *          least one of its V4L2_MIN_BUFFERS buffers to fill.
+ */
+void CameraCapture::deviceLoop()
+{
+    while (this->running.load())
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->ringMutex);
+            for (size_t i = 0; i < this->ring.size(); i++)
+            {
+                Slot &slot = this->ring.at(i);
+                if (!slot.queued && i != this->head && slot.readers == 0 && this->v4l2.queue(static_cast<int>(i)))
+                {
+                    slot.frame.release();
+                    slot.queued = true;
+                }
+            }
+        }
+
+        // Times out while readers hold every other buffer, they are recycled on the next pass
+        size_t bytes = 0;
+        int index = this->v4l2.dequeue(bytes, std::chrono::milliseconds(CAPTURE_POLL_MS));
+        if (index < 0)
+        {
+            continue;
+        }
+        cv::Mat raw = this->v4l2.view(index, bytes);
+        if (raw.empty())
+        {
+            std::cerr << "Capture::ERROR: Dropped short frame from " << this->source << std::endl;
+            this->v4l2.queue(index);
+            continue;
+        }
+
+        // Publish
+        {
+            std::lock_guard<std::mutex> lock(this->ringMutex);
+            Slot &slot = this->ring.at(index);
+            slot.frame = raw;
+            slot.queued = false;
+            slot.generation = this->generation.load() + 1;
+            this->head = index;
+            this->generation.store(slot.generation);
+        }
+        this->frameReady.notify_all();
+    }
+}
@@ -6,6 +6,10 @@
 Client::~Client()
 {
     close(this->clientSocket);
+    if (this->mcastSocket >= 0)
+    {
+        close(this->mcastSocket);
+    }
 }
 
 /**
@@ -48,77 +52,685 @@ void Client::connectToServer()
     this->state = REQ_STAGE;
 }
 
-void Client::sendRequestSrv() {
-    nlohmann::json request;
-    size_t requestSize(0);
-    
-    // Form Request
-    request["state"] = "request";
-    request["id"] = 0;
-    request["frames"] = {SatColor::RED, SatColor::GREEN, SatColor::BLUE};
-    request["hash"] = md5( request.dump().c_str() );
-    requestSize = request.dump().size();
-    
-    // Send Buffer Size and Request
-    send(clientSocket, &requestSize, sizeof(size_t), 0);
-    send(clientSocket, request.dump().data(), requestSize, 0 );
+/**
+ * @brief Closes the session with the server.
+ *
+ * The socket is replaced with a fresh one and the client returns to
+ * IDLE_STAGE, so connectToServer() can open a new session.
+ */
+void Client::disconnect()
+{
+    close(this->clientSocket);
+    this->clientSocket = socket(AF_INET, SOCK_STREAM, 0);
+    if (this->mcastSocket >= 0)
+    {
+        close(this->mcastSocket);
+        this->mcastSocket = -1;
+    }
+    this->previous.clear();
+    this->state = IDLE_STAGE;
+}
 
-    std::vector<cv::Mat> imgs;
-    imgs = recvFrames();
-   
-    // recvFrames();
-    // cv::imshow("Image", img);
-    // cv::waitKey(0);
+/**
+ * @brief Requests a frame set from the server, then displays and saves it.
+ *
+ * Frames are saved as <color>_frame.png. The server only computes the
+ * frames asked for, so a single band costs a third of a full set.
+ *
+ * @param colors SatColor frames to request, in order.
+ * @throws ClientException If the request cannot be sent or the response is invalid.
+ */
+void Client::sendRequestSrv(const std::vector<int> &colors) {
+    static const std::array<std::string, 3> names{"red_frame", "green_frame", "blue_frame"};
+    std::vector<cv::Mat> imgs = requestFrames(colors);
+
+    for( size_t i = 0; i < imgs.size(); i++ ) {
+        cv::imshow("Frame", imgs[i]);
+        cv::imwrite( std::format("{}.png", names.at(colors.at(i))), imgs[i] );
+        cv::waitKey(0);
+    }
     return;
 }
 
-std::vector<cv::Mat> Client::recvFrames() {
-    int numFrames(0);
+/**
+ * @brief Reads a frame list written as color letters, e.g. "rgb", "g" or "br".
+ * @param letters One of r, g, b (either case) per frame, repeats allowed.
+ * @return SatColor frames in the order given.
+ * @throws ClientException If the list is empty, too long, or has another letter.
+ */
+std::vector<int> Client::parseColors(const std::string &letters) {
+    if( letters.empty() || letters.size() > UINT8_MAX ) {
+        throw ClientException("ClientError: Invalid number of frames requested", 1);
+    }
+
+    std::vector<int> colors;
+    for( char letter : letters ) {
+        switch( std::tolower(static_cast<unsigned char>(letter)) ) {
+        case 'r':
+            colors.push_back(SatColor::RED);
+            break;
+        case 'g':
+            colors.push_back(SatColor::GREEN);
+            break;
+        case 'b':
+            colors.push_back(SatColor::BLUE);
+            break;
+        default:
+            throw ClientException(std::format("ClientError: Unknown frame color '{}', expected r, g or b", letter), 1);
+        }
+    }
+    return colors;
+}
+
+/**
+ * @brief Requests a frame set over the open session using the binary protocol.
+ *
+ * The request is a single fixed-header MSG_CAPTURE_REQUEST listing the
+ * desired SatColor frames, flagged for pipelined delivery. The server keeps
+ * the connection open afterwards, so this may be called repeatedly without
+ * reconnecting; each call's sequence number is its request id.
+ *
+ * @param colors SatColor frames to request, in order.
+ * @return The decoded frames.
+ * @throws ClientException If not connected, or the request or response fails.
+ */
+std::vector<cv::Mat> Client::requestFrames(const std::vector<int> &colors) {
+    std::vector<uint8_t> payload = buildCaptureRequest(colors);
+
+    this->lastRequest = this->sequence;
+    sendMessage(MSG_CAPTURE_REQUEST, WIRE_FLAG_PIPELINE | transportFlags(), payload.data(), payload.size());
+    return recvFrames();
+}
+
+/**
+ * @brief Requests one frame per color matrix, for bands that are not a plain R, G or B channel.
+ *
+ * Identical to requestFrames() except the request carries serialized
+ * ColorMatrix transforms (WIRE_FLAG_COLOR_MATRIX) instead of SatColor indices.
+ *
+ * @param matrices Transforms to apply, each within ColorMatrix::inRange().
+ * @return The decoded frames, in matrix order.
+ * @throws ClientException If not connected, a matrix is out of range, or the request fails.
+ */
+std::vector<cv::Mat> Client::requestMatrices(const std::vector<ColorMatrix> &matrices) {
+    if( this->state != REQ_STAGE ) {
+        throw ClientException{std::format("ERROR: Client in wrong state\nExpected: REQ_STAGE(1)\nActual: {}", this->state), 1};
+    }
+    if( matrices.empty() || matrices.size() > UINT8_MAX ) {
+        throw ClientException("ClientError: Invalid number of frames requested", 1);
+    }
+
+    std::vector<uint8_t> payload;
+    payload.push_back(matrices.size());
+    for( const ColorMatrix &matrix : matrices ) {
+        if( ! matrix.inRange() ) {
+            throw ClientException("ClientError: Color matrix coefficient out of range", 1);
+        }
+        appendColorMatrix(payload, matrix);
+    }
+    appendOptions(payload);
+
+    this->lastRequest = this->sequence;
+    sendMessage(MSG_CAPTURE_REQUEST, WIRE_FLAG_PIPELINE | WIRE_FLAG_COLOR_MATRIX | transportFlags(), payload.data(), payload.size());
+    return recvFrames();
+}
+
+/**
+ * @brief Requests a frame set delivered over the server's multicast group.
+ *
+ * The first call asks the server for its group and joins it. The session then
+ * only receives an index of frame ids, while the frames arrive as datagrams
+ * shared with every other receiver. Single losses per FEC group are repaired
+ * locally; anything else is NACKed over the session and re-multicast, for at
+ * most MCAST_NACK_ROUNDS rounds. NACKs go out once none of this request's
+ * chunks arrived for MCAST_RECV_TIMEOUT_MS, however busy the group is with
+ * other receivers' frames, and the call gives up after MCAST_REQUEST_TIMEOUT_MS.
+ *
+ * @param colors SatColor frames to request, in order.
+ * @return The decoded frames.
+ * @throws ClientException If multicast is unavailable or frames cannot be recovered in time.
+ */
+std::vector<cv::Mat> Client::requestMulticast(const std::vector<int> &colors) {
+    std::vector<uint8_t> payload = buildCaptureRequest(colors);
+    joinMulticast();
+
+    // Request, then the index of frames the server sent to the group
+    WireHeader header;
+    std::vector<uint8_t> buffer;
+    std::vector<McastFrameRef> refs;
+    this->lastRequest = this->sequence;
+    sendMessage(MSG_CAPTURE_REQUEST, WIRE_FLAG_MULTICAST | transportFlags(), payload.data(), payload.size());
+    recvMessage(header, buffer);
+    if( header.seq != this->lastRequest || header.type == MSG_ERROR ) {
+        throw ClientException(std::format("ClientError: Multicast request failed: {}", std::string(buffer.begin(), buffer.end())), 5);
+    }
+    size_t indexSize = buffer.size();
+    this->delivered = RegionInfo{};
+    if( (header.flags & WIRE_FLAG_REGION) && indexSize >= sizeof(RegionInfo) ) {
+        indexSize -= sizeof(RegionInfo);
+        this->delivered = readRegionInfo(buffer.data() + indexSize);
+    }
+    if( header.type != MSG_MCAST_INDEX || ! readMcastIndex(buffer.data(), indexSize, refs) ) {
+        throw ClientException("ClientError: Unexpected message while waiting for multicast index", 5);
+    }
+
+    std::map<uint32_t, size_t> pending;
+    for( size_t i = 0; i < refs.size(); i++ ) {
+        this->assembler.expect(refs[i].frameId, refs[i].frameSize, refs[i].color);
+        if( ! this->assembler.isComplete(refs[i].frameId) ) {
+            pending[refs[i].frameId] = i;
+        }
+    }
+
+    // Drain the group (datagrams sent before the index are waiting in the socket buffer)
+    std::vector<uint8_t> datagram(MCAST_MTU);
+    int rounds(0);
+    auto now = std::chrono::steady_clock::now();
+    auto progress = now; // Last chunk of a pending frame
+    const auto deadline = now + std::chrono::milliseconds(MCAST_REQUEST_TIMEOUT_MS);
+    while( ! pending.empty() ) {
+        now = std::chrono::steady_clock::now();
+        if( now >= deadline ) {
+            throw ClientException(std::format("ClientError: {} multicast frame(s) not received in time", pending.size()), 4);
+        }
+        auto nackAt = progress + std::chrono::milliseconds(MCAST_RECV_TIMEOUT_MS);
+        if( now < nackAt ) {
+            int wait = std::chrono::ceil<std::chrono::milliseconds>(std::min(nackAt, deadline) - now).count();
+            pollfd pfd{this->mcastSocket, POLLIN, 0};
+            if( poll(&pfd, 1, wait) > 0 ) {
+                ssize_t n = recv(this->mcastSocket, datagram.data(), datagram.size(), 0);
+                uint32_t frameId;
+                if( n < MCAST_HEADER_SIZE ) {
+                    continue;
+                }
+                std::memcpy(&frameId, datagram.data() + offsetof(ChunkHeader, frameId), sizeof(frameId));
+                frameId = ntohl(frameId);
+
+                // Other receivers' frames share the group, only our own count as progress
+                if( pending.count(frameId) ) {
+                    FrameAssembler::Result result = this->assembler.accept(datagram.data(), n);
+                    if( result != FrameAssembler::CHUNK_REJECTED ) {
+                        progress = std::chrono::steady_clock::now();
+                    }
+                    if( result == FrameAssembler::FRAME_COMPLETE ) {
+                        pending.erase(frameId);
+                    }
+                }
+            }
+            continue;
+        }
+
+        // None of our chunks for a while: NACK whatever FEC could not repair
+        progress = now;
+        if( ++rounds > MCAST_NACK_ROUNDS ) {
+            throw ClientException(std::format("ClientError: {} multicast frame(s) could not be recovered", pending.size()), 4);
+        }
+        for( auto &entry : pending ) {
+            std::vector<uint8_t> nack = buildNack(entry.first, this->assembler.missing(entry.first));
+            sendMessage(MSG_NACK, 0, nack.data(), nack.size());
+        }
+    }
 
-    std::vector<uchar> buffer;
     std::vector<cv::Mat> imgs;
+    for( const McastFrameRef &ref : refs ) {
+        std::vector<uint8_t> encoded;
+        this->assembler.takeFrame(ref.frameId, encoded);
+        imgs.push_back( decodeFrame(encoded.data(), encoded.size(), ref.planes) );
+    }
+    return imgs;
+}
 
+/**
+ * @brief Subscribes to frame sets pushed continuously by the server.
+ *
+ * The server sends at most 'fps' sets per second and never the same capture
+ * twice. Sets are never acknowledged: if this client reads too slowly the
+ * server drops stale sets (latest wins) and reports the count in each
+ * StreamStatus. Calling it again while subscribed changes the rate or filters.
+ *
+ * @param fps Target frame rate, 1 to 60.
+ * @param colors SatColor frames wanted in every set.
+ * @throws ClientException If not connected or the request cannot be sent.
+ */
+void Client::subscribe(int fps, const std::vector<int> &colors) {
+    std::vector<uint8_t> capture = buildCaptureRequest(colors);
+    if( fps < 1 || fps > UINT16_MAX ) {
+        throw ClientException(std::format("ClientError: Invalid stream rate {} fps", fps), 1);
+    }
+
+    uint16_t rate = htons(fps);
+    std::vector<uint8_t> payload(reinterpret_cast<uint8_t*>(&rate), reinterpret_cast<uint8_t*>(&rate) + sizeof(rate));
+    payload.insert(payload.end(), capture.begin(), capture.end());
+
+    this->streamRequest = this->sequence;
+    sendMessage(MSG_SUBSCRIBE, transportFlags(), payload.data(), payload.size());
+    this->subscribed = true;
+}
 
-    // Receive Number of Frames to Accept
-    recv(clientSocket, &numFrames, sizeof(int), 0);
-    std::cout << "Number of Frames: " << numFrames << std::endl;
-    for( int i = 0; i < numFrames; i++ ) {
-        cv::Mat img;
-        size_t buffer_size(0);
-        size_t bytes_expected(0);
-        size_t bytes_received(0);
-        int saturationColor(-1);
+/**
+ * @brief Receives the next frame set of the subscription.
+ *
+ * @param status Receives the server's delivered and dropped counts for this set.
+ * @return The decoded frames.
+ * @throws ClientException On MSG_ERROR, malformed messages or connection loss.
+ */
+std::vector<cv::Mat> Client::nextStreamFrames(StreamStatus &status) {
+    if( ! this->subscribed ) {
+        throw ClientException("ClientError: Not subscribed", 1);
+    }
 
-        // Receive Header for Frame
-        recv(this->clientSocket, &saturationColor, sizeof(int), 0);
+    WireHeader header;
+    std::vector<uint8_t> buffer;
+    std::vector<cv::Mat> imgs;
+    size_t numFrames(0);
+    bool started(false);
 
-        // Receive Buffer Size and Reshape
-        recv(this->clientSocket, &buffer_size, sizeof(size_t), 0);
-        buffer.resize(buffer_size);
-        bytes_expected = buffer_size;
+    while( ! started || imgs.size() < numFrames ) {
+        recvMessage(header, buffer);
 
-        while( bytes_received < bytes_expected ) {
-            bytes_received += recv(this->clientSocket, buffer.data() + bytes_received, buffer_size - bytes_received, 0);
+        // Sets from a previous configuration of the stream are skipped
+        if( header.seq != this->streamRequest ) {
+            continue;
+        }
+        if( header.type == MSG_ERROR ) {
+            this->subscribed = false;
+            throw ClientException(std::format("ClientError: Subscription failed: {}", std::string(buffer.begin(), buffer.end())), 5);
         }
+        if( header.type == MSG_STREAM_STATUS && buffer.size() >= sizeof(StreamStatus) ) {
+            status = readStreamStatus(buffer.data());
+            imgs.clear();
+            numFrames = 0;
+            started = true;
+            continue;
+        }
+        if( ! started || header.type != MSG_FRAME || buffer.size() < sizeof(FrameInfo) ) {
+            throw ClientException("ClientError: Unexpected message while streaming", 5);
+        }
+
+        FrameInfo info = readFrameInfo(buffer.data());
+        size_t offset = readFrameRegion(header, buffer);
+        numFrames = info.count;
+        imgs.push_back( decodeFrame(buffer.data() + offset, buffer.size() - offset, info.planes) );
+    }
+    return imgs;
+}
+
+/**
+ * @brief Ends the subscription, discarding sets already in flight.
+ *
+ * @return The final delivered and dropped counts.
+ * @throws ClientException If not subscribed or the connection fails.
+ */
+StreamStatus Client::unsubscribe() {
+    if( ! this->subscribed ) {
+        throw ClientException("ClientError: Not subscribed", 1);
+    }
+
+    uint32_t request = this->sequence;
+    sendMessage(MSG_UNSUBSCRIBE, 0, nullptr, 0);
+    this->subscribed = false;
+
+    WireHeader header;
+    std::vector<uint8_t> buffer;
+    while( true ) {
+        recvMessage(header, buffer);
+        if( header.seq != request ) {
+            continue;
+        }
+        if( header.type != MSG_STREAM_STATUS || buffer.size() < sizeof(StreamStatus) ) {
+            throw ClientException(std::format("ClientError: Unsubscribe failed: {}", std::string(buffer.begin(), buffer.end())), 5);
+        }
+        return readStreamStatus(buffer.data());
+    }
+}
+
+/**
+ * @brief Encodes a MSG_CAPTURE_REQUEST payload: u8 count, count x u8 SatColor.
+ * @throws ClientException If not connected or the list is empty or too long.
+ */
+std::vector<uint8_t> Client::buildCaptureRequest(const std::vector<int> &colors) {
+    if( this->state != REQ_STAGE ) {
+        throw ClientException{std::format("ERROR: Client in wrong state\nExpected: REQ_STAGE(1)\nActual: {}", this->state), 1};
+    }
+    if( colors.empty() || colors.size() > UINT8_MAX ) {
+        throw ClientException("ClientError: Invalid number of frames requested", 1);
+    }
+
+    std::vector<uint8_t> payload;
+    payload.push_back(colors.size());
+    for( int color : colors ) {
+        payload.push_back(color);
+    }
+    appendOptions(payload);
+    return payload;
+}
+
+/**
+ * @brief Header flags selecting how frames are transported, added to every capture request.
+ */
+uint16_t Client::transportFlags() const {
+    return (this->planes ? WIRE_FLAG_PLANES : 0) | (this->denoise >= 0 ? WIRE_FLAG_DENOISE : 0) |
+           (this->region.scale ? WIRE_FLAG_REGION : 0) | (this->delta ? WIRE_FLAG_DELTA : 0) |
+           (this->keyframe ? WIRE_FLAG_KEYFRAME : 0) | (this->lossless ? WIRE_FLAG_LOSSLESS : 0);
+}
+
+/**
+ * @brief Appends the trailing option bytes announced by transportFlags() to a capture request.
+ */
+void Client::appendOptions(std::vector<uint8_t> &payload) const {
+    if( this->denoise >= 0 ) {
+        payload.push_back(this->denoise);
+    }
+    if( this->region.scale ) {
+        RegionInfo region = makeRegionInfo(this->region);
+        const uint8_t *bytes = reinterpret_cast<const uint8_t*>(&region);
+        payload.insert(payload.end(), bytes, bytes + sizeof(region));
+    }
+}
+
+/**
+ * @brief Restricts later requests to a crop of the capture, optionally downscaled.
+ *
+ * The server cuts the region out before denoising and filtering, so smaller
+ * regions are also cheaper to compute. A region reaching past the capture is
+ * clamped; getDeliveredRegion() reports what was actually sent.
+ *
+ * @param x, y Crop origin in capture pixels.
+ * @param width, height Crop size in capture pixels, 0 to reach the capture's edge.
+ * @param scale Output size relative to the crop, 0 < scale <= 1.
+ * @throws ClientException If a value is out of range.
+ */
+void Client::setRegion(int x, int y, int width, int height, double scale) {
+    for( int value : {x, y, width, height} ) {
+        if( value < 0 || value > UINT16_MAX ) {
+            throw ClientException(std::format("ClientError: Region value {} out of range", value), 1);
+        }
+    }
+    if( ! (scale > 0.0 && scale <= 1.0) ) {
+        throw ClientException(std::format("ClientError: Region scale {} is not within (0, 1]", scale), 1);
+    }
+    uint16_t fixed = std::max(1L, std::lround(scale * REGION_SCALE_ONE));
+    this->region = RegionInfo{static_cast<uint16_t>(x), static_cast<uint16_t>(y), static_cast<uint16_t>(width), static_cast<uint16_t>(height), fixed, 0, 0};
+}
+
+/**
+ * @brief Offset of the encoded image in a MSG_FRAME payload, after FrameInfo and
+ *        the RegionInfo the server adds with WIRE_FLAG_REGION, which is recorded.
+ * @throws ClientException If the payload is too short for its descriptors.
+ */
+size_t Client::readFrameRegion(const WireHeader &header, const std::vector<uint8_t> &payload) {
+    size_t offset = sizeof(FrameInfo) + ((header.flags & WIRE_FLAG_REGION) ? sizeof(RegionInfo) : 0);
+    if( payload.size() < offset ) {
+        throw ClientException("ClientError: Truncated frame descriptor", 5);
+    }
+    this->delivered = (header.flags & WIRE_FLAG_REGION) ? readRegionInfo(payload.data() + sizeof(FrameInfo)) : RegionInfo{};
+    return offset;
+}
+
+/**
+ * @brief Decodes an encoded image, a lossless container or PNG, told apart by their leading bytes.
+ *
+ * Multicast frames carry no FrameEncoding, so the bytes are sniffed rather than trusted.
+ *
+ * @param gray Decode a single-band frame, a BGR image otherwise.
+ * @return Empty if the bytes cannot be decoded.
+ */
+static cv::Mat decodeImage(const uint8_t *data, size_t size, bool gray) {
+    cv::Mat image;
+    if( isLosslessImage({data, size}) ) {
+        if( ! decodeLossless({data, size}, image) || image.channels() != (gray ? 1 : 3) ) {
+            return cv::Mat();
+        }
+        return image;
+    }
+    cv::Mat encoded(1, size, CV_8UC1, const_cast<uint8_t*>(data));
+    return cv::imdecode(encoded, gray ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR);
+}
+
+/**
+ * @brief Decodes one received frame into a BGR image.
+ *
+ * @param planes FrameInfo::planes of the frame, non-zero for a gray plane to be re-tinted.
+ */
+cv::Mat Client::decodeFrame(const uint8_t *data, size_t size, uint8_t planes) {
+    if( ! planes ) {
+        return decodeImage(data, size, false);
+    }
+    return expandPlane(decodeImage(data, size, true), planes);
+}
+
+/**
+ * @brief Decodes a frame of a capture response, rebuilding deltas from the previous frame at its index.
+ *
+ * With delta transport every decoded frame is kept, as transmitted (before
+ * planes are re-tinted), to rebuild the next response's FRAME_DELTA_* frames.
+ *
+ * @throws ClientException If a delta frame has no matching previous frame.
+ */
+cv::Mat Client::decodeFrame(const FrameInfo &info, const uint8_t *data, size_t size) {
+    cv::Mat image = decodeImage(data, size, info.planes != 0);
+    bool delta = info.encoding == FRAME_DELTA_PNG || info.encoding == FRAME_DELTA_LOSSLESS;
+    if( delta &&
+        ( info.index >= this->previous.size() || ! applyDelta(this->previous[info.index], image, image) ) ) {
+        throw ClientException(std::format("ClientError: Delta frame {} has no matching previous frame", info.index), 5);
+    }
+    if( this->delta ) {
+        this->previous.resize(info.count);
+        this->previous[info.index] = image;
+    }
+    return info.planes ? expandPlane(image, info.planes) : image;
+}
+
+/**
+ * @brief Enables or disables delta transport for later requests.
+ *
+ * The server then keeps the frames it last sent on this session and may answer
+ * with their per-pixel changes instead, forcing full keyframes periodically.
+ * Only request/response captures use deltas; multicast and subscriptions
+ * always carry full frames.
+ */
+void Client::setDeltaTransport(bool enabled) {
+    this->delta = enabled;
+    this->previous.clear();
+    this->keyframe = enabled;
+}
+
+/**
+ * @brief Rebuilds the full frame of a single-band filter from its plane.
+ *
+ * @param plane CV_8UC1 band as sent with WIRE_FLAG_PLANES.
+ * @param channels CHANNEL_* bits the band is written to, the others are zero.
+ * @return CV_8UC3 BGR image, empty if the plane is.
+ */
+cv::Mat Client::expandPlane(const cv::Mat &plane, uint8_t channels) {
+    if( plane.empty() ) {
+        return cv::Mat();
+    }
+    cv::Mat zeros = cv::Mat::zeros(plane.size(), CV_8UC1);
+    std::vector<cv::Mat> bgr = {
+        (channels & CHANNEL_BLUE) ? plane : zeros,
+        (channels & CHANNEL_GREEN) ? plane : zeros,
+        (channels & CHANNEL_RED) ? plane : zeros};
+    cv::Mat frame;
+    cv::merge(bgr, frame);
+    return frame;
+}
+
+/**
+ * @brief Combines frames of one capture into a single view, e.g. red + green + blue back into the original.
+ *
+ * @param frames Same-size BGR frames.
+ * @return Their saturating per-channel sum, empty if there are no frames.
+ */
+cv::Mat Client::compositeFrames(const std::vector<cv::Mat> &frames) {
+    if( frames.empty() ) {
+        return cv::Mat();
+    }
+    cv::Mat view = frames[0].clone();
+    for( size_t i = 1; i < frames.size(); i++ ) {
+        cv::add(view, frames[i], view);
+    }
+    return view;
+}
+
+/**
+ * @brief Asks the server for its multicast group and joins it, once per session.
+ * @throws ClientException If the server has multicast disabled or the join fails.
+ */
+void Client::joinMulticast() {
+    if( this->mcastSocket >= 0 ) {
+        return;
+    }
+
+    nlohmann::json reply = sendControl({{"state", "multicast"}});
+    std::string group = reply["group"];
+    int port = reply["port"];
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    int one(1);
+    int rcvbuf(4 << 20); // Room for a whole frame set arriving before the index
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    sockaddr_in local{};
+    local.sin_family = AF_INET;
+    local.sin_port = htons(port);
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    ip_mreq membership{};
+    inet_pton(AF_INET, group.c_str(), &membership.imr_multiaddr);
+    membership.imr_interface.s_addr = htonl(INADDR_ANY);
+
+    if( sock < 0 || bind(sock, reinterpret_cast<sockaddr*>(&local), sizeof(local)) < 0 ||
+        setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) < 0 ) {
+        if( sock >= 0 ) {
+            close(sock);
+        }
+        throw ClientException(std::format("ClientError: Could not join multicast group {}:{}", group, port), 2);
+    }
+    this->mcastSocket = sock;
+}
+
+/**
+ * @brief Sends a JSON control message and waits for the server's JSON reply.
+ *
+ * Control messages (e.g. {"state": "stats"}) stay human-readable JSON; only
+ * the capture hot path uses fixed binary payloads.
+ *
+ * @param message The control request to send.
+ * @return The server's reply.
+ * @throws ClientException If the server answers with an error or the connection fails.
+ */
+nlohmann::json Client::sendControl(const nlohmann::json &message) {
+    std::string body = message.dump();
+    WireHeader header;
+    std::vector<uint8_t> reply;
+
+    sendMessage(MSG_CONTROL, 0, reinterpret_cast<const uint8_t*>(body.data()), body.size());
+    recvMessage(header, reply);
+    if( header.type != MSG_CONTROL ) {
+        throw ClientException(std::format("ClientError: Control request failed: {}", std::string(reply.begin(), reply.end())), 5);
+    }
+    return nlohmann::json::parse(reply.begin(), reply.end());
+}
+
+/**
+ * @brief Receives the frames of one response.
+ *
+ * Every MSG_FRAME carries its index and the response frame count. When the
+ * server honoured pipelining the frames arrive back-to-back and are
+ * acknowledged once at the end; otherwise each frame is acknowledged.
+ * Every message must carry the id of the outstanding request.
+ *
+ * @return The decoded frames in the order the server sent them.
+ * @throws ClientException On MSG_ERROR, checksum failure or connection loss.
+ */
+std::vector<cv::Mat> Client::recvFrames() {
+    std::vector<uint8_t> buffer;
+    std::vector<cv::Mat> imgs;
+    bool pipelined(false);
+    size_t numFrames(1);
+
+    // Previous frames are only trusted again once a whole response has arrived
+    this->keyframe = true;
+
+    while( imgs.size() < numFrames ) {
+        WireHeader header;
+        recvMessage(header, buffer);
+
+        if( header.seq != this->lastRequest ) {
+            throw ClientException(std::format("ClientError: Response for request {} while waiting on {}", static_cast<uint32_t>(header.seq), this->lastRequest), 5);
+        }
+        if( header.type == MSG_ERROR ) {
+            throw ClientException(std::format("ClientError: Server error: {}", std::string(buffer.begin(), buffer.end())), 5);
+        }
+        if( header.type != MSG_FRAME || buffer.size() < sizeof(FrameInfo) ) {
+            throw ClientException("ClientError: Unexpected message while receiving frames", 5);
+        }
+
+        // Frame descriptor, then encoded image
+        FrameInfo info = readFrameInfo(buffer.data());
+        pipelined = (header.flags & WIRE_FLAG_PIPELINE) != 0;
+        numFrames = info.count;
 
         // DEBUG: Image Received in Full
-        send(clientSocket, reinterpret_cast<const char*>("OK"), sizeof(10), 0);
+        if( ! pipelined ) {
+            uint32_t one = htonl(1);
+            sendMessage(MSG_ACK, 0, reinterpret_cast<const uint8_t*>(&one), sizeof(one));
+        }
 
         // Decode Image
-        imgs.push_back( cv::imdecode(buffer, cv::IMREAD_COLOR) );
+        size_t offset = readFrameRegion(header, buffer);
+        imgs.push_back( decodeFrame(info, buffer.data() + offset, buffer.size() - offset) );
     }
+    this->keyframe = false;
 
-    int i = 0;
-    std::array<std::string,3> arr{"blue_frame","green_frame","red_frame"};
-    for( auto val : imgs ) {
-        cv::imshow("Frame", val);
-        cv::imwrite( std::format("{}.png", arr.at(i)), val );
-        cv::waitKey(0);
-        i++;
+    // Single end-of-batch summary
+    if( pipelined ) {
+        uint32_t received = htonl(imgs.size());
+        sendMessage(MSG_ACK, 0, reinterpret_cast<const uint8_t*>(&received), sizeof(received));
     }
     return imgs;
 }
 
+/**
+ * @brief Writes one binary protocol message (header + payload) with a single gathered write.
+ * @throws ClientException If the socket fails.
+ */
+void Client::sendMessage(uint8_t type, uint16_t flags, const uint8_t *payload, size_t length) {
+    uint8_t header[WIRE_HEADER_SIZE];
+    writeHeader(header, type, flags, this->sequence++, length, crc32(payload, length));
+
+    iovec iov[2] = {{header, WIRE_HEADER_SIZE}, {const_cast<uint8_t*>(payload), length}};
+    if( ! sendAll(this->clientSocket, iov, length ? 2 : 1) ) {
+        throw ClientException("ClientError: Could not send message to server", 3);
+    }
+}
+
+/**
+ * @brief Reads one binary protocol message and verifies its checksum.
+ * @param header Receives the decoded header.
+ * @param payload Receives the payload bytes, reusing its capacity.
+ * @throws ClientException On malformed headers, checksum mismatch or connection loss.
+ */
+void Client::recvMessage(WireHeader &header, std::vector<uint8_t> &payload) {
+    uint8_t raw[WIRE_HEADER_SIZE];
+    if( ! recvAll(this->clientSocket, raw, WIRE_HEADER_SIZE) ) {
+        throw ClientException("ClientError: Connection closed before message header", 4);
+    }
+    if( decodeHeader(raw, WIRE_HEADER_SIZE, header, WIRE_MAX_FRAME) != WIRE_OK ) {
+        throw ClientException("ClientError: Malformed message header", 5);
+    }
+
+    payload.resize(header.length);
+    if( ! recvAll(this->clientSocket, payload.data(), header.length) ) {
+        throw ClientException("ClientError: Connection closed mid-message", 4);
+    }
+    if( crc32(payload.data(), payload.size()) != header.checksum ) {
+        throw ClientException("ClientError: Message checksum mismatch", 5);
+    }
+}
+
 
 /**
  * @brief Send a request containing desired frames to server
@@ -0,0 +1,284 @@
+#include "denoise.h"
+#include <algorithm>
+#include <initializer_list>
+#include <vector>
+
+namespace
+{
+    const char *const modeNames[DENOISE_MODES] = {"none", "bilateral", "grid", "guided", "pyramid"};
+
+    // Intermediate images draw their buffers from the caller's allocator, null is OpenCV's default
+    void useAllocator(cv::MatAllocator *allocator, std::initializer_list<cv::Mat *> mats)
+    {
+        for (cv::Mat *mat : mats)
+        {
+            mat->allocator = allocator;
+        }
+    }
+
+    // [1 2 1] / 4 along each grid axis, cells outside the grid count as empty
+    void blurGrid(cv::Mat &grid, cv::Mat &src, int gw, int gh, int gd)
+    {
+        const size_t strides[3] = {4, static_cast<size_t>(gd) * 4, static_cast<size_t>(gw) * gd * 4};
+        const int lengths[3] = {gd, gw, gh};
+        src.create(grid.size(), grid.type());
+        for (int axis = 0; axis < 3; axis++)
+        {
+            cv::swap(src, grid);
+            size_t stride = strides[axis];
+            const float *in = src.ptr<float>();
+            float *out = grid.ptr<float>();
+
+            // Each pass only reads src, grid rows are written independently
+            cv::parallel_for_(cv::Range(0, gh), [&](const cv::Range &range)
+            {
+                for (int y = range.start; y < range.end; y++)
+                {
+                    for (int x = 0; x < gw; x++)
+                    {
+                        for (int z = 0; z < gd; z++)
+                        {
+                            int coord = axis == 0 ? z : (axis == 1 ? x : y);
+                            size_t i = ((static_cast<size_t>(y) * gw + x) * gd + z) * 4;
+                            for (int c = 0; c < 4; c++)
+                            {
+                                float value = 2.0f * in[i + c];
+                                if (coord > 0)
+                                {
+                                    value += in[i - stride + c];
+                                }
+                                if (coord < lengths[axis] - 1)
+                                {
+                                    value += in[i + stride + c];
+                                }
+                                out[i + c] = 0.25f * value;
+                            }
+                        }
+                    }
+                }
+            });
+        }
+    }
+
+    /**
+     * Bilateral grid: pixels are accumulated into a coarse (x, y, luma) grid with
+     * one cell per DENOISE_SIGMA_SPACE pixels and DENOISE_SIGMA_COLOR levels, the
+     * grid is blurred, and every pixel reads its value back by trilinear
+     * interpolation. Averaging only happens between pixels of similar luma, so
+     * edges survive; the cost is linear in the pixel count whatever the radius.
+     *
+     * Every stage runs in parallel over grid rows. A grid row gathers a fixed band
+     * of pixel rows, so the splat sums in the same order whatever the thread count.
+     */
+    void bilateralGrid(const cv::Mat &input, cv::Mat &output, cv::MatAllocator *scratch)
+    {
+        const int ss = DENOISE_SIGMA_SPACE;
+        const int sr = DENOISE_SIGMA_COLOR;
+        const int gw = (input.cols - 1) / ss + 3; // One padding cell each side
+        const int gh = (input.rows - 1) / ss + 3;
+        const int gd = 255 / sr + 3;
+
+        // The grid is one row of floats, cells of 4 ordered by y, x, luma
+        cv::Mat grid, blurred, gray;
+        useAllocator(scratch, {&grid, &blurred, &gray});
+        grid.create(1, gw * gh * gd * 4, CV_32F);
+        grid.setTo(cv::Scalar::all(0));
+        float *sums = grid.ptr<float>();
+        cv::cvtColor(input, gray, cv::COLOR_BGR2GRAY);
+
+        // Splat into the nearest cell: B, G, R sums and a pixel count. Pixel rows
+        // [gy * ss - ss / 2, gy * ss + ss / 2) land in grid row gy + 1
+        cv::Range cells(0, (input.rows + ss / 2 - 1) / ss + 1);
+        cv::parallel_for_(cells, [&](const cv::Range &range)
+        {
+            int first = std::max(0, range.start * ss - ss / 2);
+            int last = std::min(input.rows, range.end * ss - ss / 2);
+            for (int y = first; y < last; y++)
+            {
+                const uint8_t *src = input.ptr<uint8_t>(y);
+                const uint8_t *luma = gray.ptr<uint8_t>(y);
+                size_t row = static_cast<size_t>((y + ss / 2) / ss + 1) * gw;
+                for (int x = 0; x < input.cols; x++)
+                {
+                    size_t i = ((row + (x + ss / 2) / ss + 1) * gd + (luma[x] + sr / 2) / sr + 1) * 4;
+                    sums[i] += src[3 * x];
+                    sums[i + 1] += src[3 * x + 1];
+                    sums[i + 2] += src[3 * x + 2];
+                    sums[i + 3] += 1.0f;
+                }
+            }
+        });
+
+        blurGrid(grid, blurred, gw, gh, gd);
+        const float *smooth = grid.ptr<float>();
+
+        // Slice: trilinear interpolation at each pixel's grid position
+        std::vector<int> cellX(input.cols);
+        std::vector<float> fracX(input.cols);
+        for (int x = 0; x < input.cols; x++)
+        {
+            cellX[x] = x / ss + 1;
+            fracX[x] = static_cast<float>(x % ss) / ss;
+        }
+        int cellZ[256];
+        float fracZ[256];
+        for (int v = 0; v < 256; v++)
+        {
+            cellZ[v] = v / sr + 1;
+            fracZ[v] = static_cast<float>(v % sr) / sr;
+        }
+
+        output.create(input.size(), CV_8UC3);
+        const size_t dx = static_cast<size_t>(gd) * 4;
+        const size_t dy = static_cast<size_t>(gw) * gd * 4;
+        cv::parallel_for_(cv::Range(0, input.rows), [&](const cv::Range &range)
+        {
+            for (int y = range.start; y < range.end; y++)
+            {
+                const uint8_t *src = input.ptr<uint8_t>(y);
+                const uint8_t *luma = gray.ptr<uint8_t>(y);
+                uint8_t *dst = output.ptr<uint8_t>(y);
+                int cy = y / ss + 1;
+                float fy = static_cast<float>(y % ss) / ss;
+                for (int x = 0; x < input.cols; x++)
+                {
+                    float fx = fracX[x];
+                    float fz = fracZ[luma[x]];
+                    const float *base = &smooth[(static_cast<size_t>(cy) * gw + cellX[x]) * dx + cellZ[luma[x]] * 4];
+                    const float weights[4] = {(1.0f - fx) * (1.0f - fy), fx * (1.0f - fy), (1.0f - fx) * fy, fx * fy};
+                    const float *cells[4] = {base, base + dx, base + dy, base + dx + dy};
+
+                    // Luma neighbours are adjacent in memory: interpolate along z, then bilinearly
+                    float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+                    for (int corner = 0; corner < 4; corner++)
+                    {
+                        const float *cell = cells[corner];
+                        for (int c = 0; c < 4; c++)
+                        {
+                            sum[c] += weights[corner] * (cell[c] + fz * (cell[c + 4] - cell[c]));
+                        }
+                    }
+                    for (int c = 0; c < 3; c++)
+                    {
+                        float value = sum[3] > 1e-6f ? sum[c] / sum[3] : src[3 * x + c];
+                        dst[3 * x + c] = static_cast<uint8_t>(std::clamp(value + 0.5f, 0.0f, 255.0f));
+                    }
+                }
+            }
+        });
+    }
+
+    /**
+     * Fast guided filter: each channel is modelled as a * luma + b over a window
+     * of about DENOISE_SIGMA_SPACE pixels. Windows whose luma varies much less than
+     * DENOISE_SIGMA_COLOR (noise) flatten towards their mean, windows across an
+     * edge follow the guide. The coefficients are fitted at 1/DENOISE_SUBSAMPLE
+     * scale and upsampled, since they vary slowly.
+     */
+    void guidedFilter(const cv::Mat &input, cv::Mat &output, cv::MatAllocator *scratch)
+    {
+        const int radius = std::max(1, DENOISE_SIGMA_SPACE / DENOISE_SUBSAMPLE);
+        const double eps = static_cast<double>(DENOISE_SIGMA_COLOR) * DENOISE_SIGMA_COLOR;
+        const cv::Size window(2 * radius + 1, 2 * radius + 1);
+        const cv::Size small(std::max(1, input.cols / DENOISE_SUBSAMPLE), std::max(1, input.rows / DENOISE_SUBSAMPLE));
+
+        cv::Mat gray, guide, guide3, src;
+        cv::Mat guideSmall, srcSmall;
+        cv::Mat meanI, meanP, corrI, corrIp, prod;
+        cv::Mat varI, covIp, a, b;
+        cv::Mat meanA, meanB, result;
+        useAllocator(scratch, {&gray, &guide, &guide3, &src, &guideSmall, &srcSmall, &meanI, &meanP, &corrI, &corrIp, &prod,
+                               &varI, &covIp, &a, &b, &meanA, &meanB, &result});
+        cv::cvtColor(input, gray, cv::COLOR_BGR2GRAY);
+        gray.convertTo(guide, CV_32F);
+        cv::merge(std::vector<cv::Mat>{guide, guide, guide}, guide3);
+        input.convertTo(src, CV_32FC3);
+
+        cv::resize(guide3, guideSmall, small, 0, 0, cv::INTER_AREA);
+        cv::resize(src, srcSmall, small, 0, 0, cv::INTER_AREA);
+
+        cv::boxFilter(guideSmall, meanI, CV_32F, window);
+        cv::boxFilter(srcSmall, meanP, CV_32F, window);
+        cv::multiply(guideSmall, guideSmall, prod);
+        cv::boxFilter(prod, corrI, CV_32F, window);
+        cv::multiply(guideSmall, srcSmall, prod);
+        cv::boxFilter(prod, corrIp, CV_32F, window);
+
+        // a = cov(I, p) / (var(I) + eps), b = mean(p) - a * mean(I)
+        cv::multiply(meanI, meanI, prod);
+        cv::subtract(corrI, prod, varI);
+        cv::add(varI, cv::Scalar::all(eps), varI);
+        cv::multiply(meanI, meanP, prod);
+        cv::subtract(corrIp, prod, covIp);
+        cv::divide(covIp, varI, a);
+        cv::multiply(a, meanI, prod);
+        cv::subtract(meanP, prod, b);
+
+        cv::boxFilter(a, meanA, CV_32F, window);
+        cv::boxFilter(b, meanB, CV_32F, window);
+        cv::resize(meanA, a, input.size(), 0, 0, cv::INTER_LINEAR);
+        cv::resize(meanB, b, input.size(), 0, 0, cv::INTER_LINEAR);
+
+        cv::multiply(a, guide3, result);
+        cv::add(result, b, result);
+        result.convertTo(output, CV_8UC3);
+    }
+
+    // Reference filter on a 1/DENOISE_SUBSAMPLE frame with proportionally scaled parameters
+    void pyramidFilter(const cv::Mat &input, cv::Mat &output, cv::MatAllocator *scratch)
+    {
+        const int s = DENOISE_SUBSAMPLE;
+        cv::Mat small, filtered;
+        useAllocator(scratch, {&small, &filtered});
+        cv::resize(input, small, cv::Size(std::max(1, input.cols / s), std::max(1, input.rows / s)), 0, 0, cv::INTER_AREA);
+        cv::bilateralFilter(small, filtered, DENOISE_REFERENCE_DIAMETER / s, DENOISE_SIGMA_COLOR, static_cast<double>(DENOISE_SIGMA_COLOR) / s);
+        cv::resize(filtered, output, input.size(), 0, 0, cv::INTER_LINEAR);
+    }
+}
+
+bool denoiseFrame(const cv::Mat &input, cv::Mat &output, DenoiseMode mode, cv::MatAllocator *scratch)
+{
+    if (input.type() != CV_8UC3)
+    {
+        return false;
+    }
+
+    switch (mode)
+    {
+    case DENOISE_NONE:
+        output = input;
+        return true;
+    case DENOISE_BILATERAL:
+        cv::bilateralFilter(input, output, DENOISE_REFERENCE_DIAMETER, DENOISE_SIGMA_COLOR, DENOISE_SIGMA_COLOR);
+        return true;
+    case DENOISE_GRID:
+        bilateralGrid(input, output, scratch);
+        return true;
+    case DENOISE_GUIDED:
+        guidedFilter(input, output, scratch);
+        return true;
+    case DENOISE_PYRAMID:
+        pyramidFilter(input, output, scratch);
+        return true;
+    default:
+        return false;
+    }
+}
+
+const char *denoiseName(DenoiseMode mode)
+{
+    return mode >= 0 && mode < DENOISE_MODES ? modeNames[mode] : "unknown";
+}
+
+bool parseDenoiseMode(const std::string &name, DenoiseMode &mode)
+{
+    for (int i = 0; i < DENOISE_MODES; i++)
+    {
+        if (name == modeNames[i])
+        {
+            mode = static_cast<DenoiseMode>(i);
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,901 @@
+#include "entropy-coder.h"
+#include "shannon-fano.h"
+
+#include <algorithm>
+#include <cstring>
+#include <format>
+
+namespace
+{
+    /**
+     * @brief Most significant bit first writer for code tables, a few hundred bits.
+     */
+    class BitWriter
+    {
+    public:
+        BitWriter(std::vector<uint8_t> &output) : output(output), pending(0), count(0) {}
+
+        void put(uint32_t value, int bits)
+        {
+            pending = (pending << bits) | (value & ((1u << bits) - 1));
+            count += bits;
+            while (count >= 8)
+            {
+                count -= 8;
+                output.push_back(static_cast<uint8_t>(pending >> count));
+            }
+        }
+
+        void flush()
+        {
+            if (count)
+            {
+                output.push_back(static_cast<uint8_t>(pending << (8 - count)));
+                count = 0;
+            }
+        }
+
+    private:
+        std::vector<uint8_t> &output;
+        uint32_t pending;
+        int count;
+    };
+
+    /**
+     * @brief Reader matching BitWriter, reads zeros past the end and remembers doing so.
+     */
+    class BitReader
+    {
+    public:
+        BitReader(std::span<const uint8_t> input) : input(input), position(0) {}
+
+        uint32_t get(int bits)
+        {
+            uint32_t value = 0;
+            for (int i = 0; i < bits; i++, position++)
+            {
+                uint8_t byte = position / 8 < input.size() ? input[position / 8] : 0;
+                value = (value << 1) | ((byte >> (7 - position % 8)) & 1);
+            }
+            return value;
+        }
+
+        bool overrun() const { return position > input.size() * 8; }
+        size_t consumed() const { return (position + 7) / 8; }
+
+    private:
+        std::span<const uint8_t> input;
+        size_t position;
+    };
+
+    /**
+     * @brief Byte histogram, four partial counts so runs of equal bytes do not serialize.
+     */
+    std::array<uint64_t, CODER_SYMBOLS> countBytes(std::span<const uint8_t> input)
+    {
+        if (input.empty())
+        {
+            throw std::invalid_argument("Input buffer is empty.");
+        }
+
+        std::array<std::array<uint64_t, CODER_SYMBOLS>, 4> partial{};
+        size_t i = 0;
+        for (; i + 4 <= input.size(); i += 4)
+        {
+            partial[0][input[i]]++;
+            partial[1][input[i + 1]]++;
+            partial[2][input[i + 2]]++;
+            partial[3][input[i + 3]]++;
+        }
+        for (; i < input.size(); i++)
+        {
+            partial[0][input[i]]++;
+        }
+
+        std::array<uint64_t, CODER_SYMBOLS> counts;
+        for (int symbol = 0; symbol < CODER_SYMBOLS; symbol++)
+        {
+            counts[symbol] = partial[0][symbol] + partial[1][symbol] + partial[2][symbol] + partial[3][symbol];
+        }
+        return counts;
+    }
+
+    int bitWidth(uint32_t value)
+    {
+        return value ? 32 - __builtin_clz(value) : 0;
+    }
+
+    void putBigEndian(std::vector<uint8_t> &output, uint32_t value)
+    {
+        for (int shift = 24; shift >= 0; shift -= 8)
+        {
+            output.push_back(static_cast<uint8_t>(value >> shift));
+        }
+    }
+
+    uint32_t getBigEndian(const uint8_t *data)
+    {
+        return (uint32_t(data[0]) << 24) | (uint32_t(data[1]) << 16) | (uint32_t(data[2]) << 8) | data[3];
+    }
+
+    const char *coderNames[CODERS] = {"shannon-fano", "huffman", "tans"};
+}
+
+/* Prefix Codes */
+
+/**
+ * @brief Builds the code from the histogram of a buffer.
+ * @details A lone symbol gets a 1 bit code. Otherwise the subclass picks the
+ *          lengths; while the longest exceeds PREFIX_MAX_CODE_BITS the counts
+ *          are halved (rare symbols move up the tree) and the lengths picked again.
+ */
+void PrefixCoder::buildTable(std::span<const uint8_t> input)
+{
+    std::array<uint64_t, CODER_SYMBOLS> counts = countBytes(input);
+    std::array<uint8_t, CODER_SYMBOLS> lengths{};
+    if (std::count(counts.begin(), counts.end(), 0) == CODER_SYMBOLS - 1)
+    {
+        lengths[std::max_element(counts.begin(), counts.end()) - counts.begin()] = 1;
+    }
+    else
+    {
+        while (buildLengths(counts, lengths) > PREFIX_MAX_CODE_BITS)
+        {
+            for (uint64_t &count : counts)
+            {
+                count = (count + 1) / 2;
+            }
+            lengths = {};
+        }
+    }
+
+    for (int symbol = 0; symbol < CODER_SYMBOLS; symbol++)
+    {
+        this->table[symbol] = SymbolCode{0, lengths[symbol]};
+    }
+    canonicalize();
+}
+
+size_t PrefixCoder::encode(std::span<const uint8_t> input, std::vector<uint8_t> &output) const
+{
+    // Worst case up front, every code written without a capacity check
+    const size_t offset = output.size();
+    output.resize(offset + (input.size() * this->longest + 7) / 8 + sizeof(uint32_t));
+    uint8_t *out = output.data() + offset;
+
+    // Pending bits sit at the bottom of the accumulator; below 32 of them plus
+    // a code of at most PREFIX_MAX_CODE_BITS always fit in 64 bits
+    uint64_t acc = 0;
+    int pending = 0;
+    size_t bits = 0;
+    for (uint8_t byte : input)
+    {
+        const SymbolCode code = this->table[byte];
+        if (!code.length)
+        {
+            output.resize(offset);
+            throw std::invalid_argument(std::format("Byte {} has no code.", static_cast<int>(byte)));
+        }
+        acc = (acc << code.length) | code.bits;
+        pending += code.length;
+        bits += code.length;
+        if (pending >= 32)
+        {
+            pending -= 32;
+            uint32_t word = static_cast<uint32_t>(acc >> pending);
+            out[0] = static_cast<uint8_t>(word >> 24);
+            out[1] = static_cast<uint8_t>(word >> 16);
+            out[2] = static_cast<uint8_t>(word >> 8);
+            out[3] = static_cast<uint8_t>(word);
+            out += 4;
+        }
+    }
+
+    // Flush, zero padded to a whole byte
+    while (pending > 0)
+    {
+        int take = std::min(pending, 8);
+        pending -= take;
+        *out++ = static_cast<uint8_t>(((acc >> pending) & ((1u << take) - 1)) << (8 - take));
+    }
+    output.resize(out - output.data());
+    return bits;
+}
+
+bool PrefixCoder::decode(std::span<const uint8_t> packed, std::span<uint8_t> output) const
+{
+    if (this->lookup.empty())
+    {
+        return output.empty();
+    }
+
+    // Next bits at the top of 'window', 'available' of them are real, the rest zero
+    const uint8_t *in = packed.data();
+    const uint8_t *end = in + packed.size();
+    uint64_t window = 0;
+    int available = 0;
+
+    // A refill leaves at least 56 bits while input lasts, room for this many codes
+    const int perRefill = std::max(1, 56 / this->longest);
+    uint8_t *out = output.data();
+    uint8_t *last = out + output.size();
+    while (out < last)
+    {
+        if (end - in >= 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, in, sizeof(word));
+            window |= __builtin_bswap64(word) >> available;
+            in += (63 - available) >> 3;
+            available |= 56;
+        }
+        else
+        {
+            while (available <= 56 && in < end)
+            {
+                window |= static_cast<uint64_t>(*in++) << (56 - available);
+                available += 8;
+            }
+        }
+
+        uint8_t *stop = out + std::min<ptrdiff_t>(perRefill, last - out);
+        for (; out < stop; out++)
+        {
+            DecodeEntry entry = this->lookup[window >> (64 - PREFIX_LOOKUP_BITS)];
+            if (!entry.length)
+            {
+                if (!entry.subBits)
+                {
+                    return false;
+                }
+                entry = this->secondary[entry.value + ((window << PREFIX_LOOKUP_BITS) >> (64 - entry.subBits))];
+                if (!entry.length)
+                {
+                    return false;
+                }
+            }
+            *out = static_cast<uint8_t>(entry.value);
+            window <<= entry.length;
+            available -= entry.length;
+        }
+
+        // Only past the end of the input, where the window reads zeros
+        if (available < 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::array<uint8_t, CODER_SYMBOLS> PrefixCoder::getLengths() const
+{
+    std::array<uint8_t, CODER_SYMBOLS> lengths;
+    for (int symbol = 0; symbol < CODER_SYMBOLS; symbol++)
+    {
+        lengths[symbol] = this->table[symbol].length;
+    }
+    return lengths;
+}
+
+bool PrefixCoder::setLengths(const std::array<uint8_t, CODER_SYMBOLS> &lengths)
+{
+    // Kraft sum in units of 2^-PREFIX_MAX_CODE_BITS, over one would not be prefix free
+    uint64_t kraft = 0;
+    for (uint8_t length : lengths)
+    {
+        if (length > PREFIX_MAX_CODE_BITS)
+        {
+            return false;
+        }
+        kraft += length ? uint64_t(1) << (PREFIX_MAX_CODE_BITS - length) : 0;
+    }
+    if (kraft == 0 || kraft > (uint64_t(1) << PREFIX_MAX_CODE_BITS))
+    {
+        return false;
+    }
+
+    for (int symbol = 0; symbol < CODER_SYMBOLS; symbol++)
+    {
+        this->table[symbol] = SymbolCode{0, lengths[symbol]};
+    }
+    canonicalize();
+    return true;
+}
+
+void PrefixCoder::writeTable(std::vector<uint8_t> &output) const
+{
+    BitWriter writer(output);
+    uint8_t previous = 0;
+    for (int symbol = 0; symbol < CODER_SYMBOLS;)
+    {
+        uint8_t length = this->table[symbol].length;
+        int run = 0;
+        while (symbol + run < CODER_SYMBOLS && run < PREFIX_TABLE_MAX_RUN && this->table[symbol + run].length == previous)
+        {
+            run++;
+        }
+
+        if (run >= PREFIX_TABLE_MIN_RUN)
+        {
+            writer.put(0b110, 3);
+            writer.put(run - PREFIX_TABLE_MIN_RUN, 6);
+            symbol += run;
+            continue;
+        }
+        if (length == previous)
+        {
+            writer.put(0b0, 1);
+        }
+        else if (length == previous + 1 || length + 1 == previous)
+        {
+            writer.put(0b10, 2);
+            writer.put(length < previous, 1);
+        }
+        else
+        {
+            writer.put(0b111, 3);
+            writer.put(length, 5);
+        }
+        previous = length;
+        symbol++;
+    }
+    writer.flush();
+}
+
+size_t PrefixCoder::readTable(std::span<const uint8_t> input)
+{
+    BitReader reader(input);
+    std::array<uint8_t, CODER_SYMBOLS> lengths;
+    int previous = 0;
+    for (int symbol = 0; symbol < CODER_SYMBOLS;)
+    {
+        if (!reader.get(1))
+        {
+            lengths[symbol++] = previous;
+        }
+        else if (!reader.get(1))
+        {
+            previous += reader.get(1) ? -1 : 1;
+            lengths[symbol++] = previous;
+        }
+        else if (!reader.get(1))
+        {
+            int run = reader.get(6) + PREFIX_TABLE_MIN_RUN;
+            if (symbol + run > CODER_SYMBOLS)
+            {
+                return 0;
+            }
+            std::fill_n(lengths.begin() + symbol, run, previous);
+            symbol += run;
+        }
+        else
+        {
+            previous = reader.get(5);
+            lengths[symbol++] = previous;
+        }
+        if (previous < 0 || previous > PREFIX_MAX_CODE_BITS)
+        {
+            return 0;
+        }
+    }
+
+    if (reader.overrun() || !setLengths(lengths))
+    {
+        return 0;
+    }
+    return reader.consumed();
+}
+
+/**
+ * @brief Reassigns every code canonically from its length.
+ * @details Codes are numbered in order of (length, byte value), so a decoder
+ *          knowing only the lengths builds the very same table.
+ */
+void PrefixCoder::canonicalize()
+{
+    std::array<uint32_t, PREFIX_MAX_CODE_BITS + 2> count{};
+    for (const SymbolCode &code : this->table)
+    {
+        count[code.length]++;
+    }
+    count[0] = 0;
+
+    std::array<uint32_t, PREFIX_MAX_CODE_BITS + 2> next{};
+    uint32_t bits = 0;
+    for (int length = 1; length <= PREFIX_MAX_CODE_BITS; length++)
+    {
+        bits = (bits + count[length - 1]) << 1;
+        next[length] = bits;
+    }
+    for (SymbolCode &code : this->table)
+    {
+        if (code.length)
+        {
+            code.bits = next[code.length]++;
+        }
+    }
+    buildDecoder();
+}
+
+/**
+ * @brief Fills the decoder tables from the code table.
+ * @details A code of up to PREFIX_LOOKUP_BITS bits fills every primary entry it
+ *          prefixes. Longer codes share one secondary table per primary
+ *          prefix, sized for the longest of them.
+ */
+void PrefixCoder::buildDecoder()
+{
+    this->lookup.assign(size_t(1) << PREFIX_LOOKUP_BITS, DecodeEntry{0, 0, 0});
+    this->secondary.clear();
+    this->longest = 1;
+
+    for (int symbol = 0; symbol < CODER_SYMBOLS; symbol++)
+    {
+        const SymbolCode &code = this->table[symbol];
+        this->longest = std::max(this->longest, code.length);
+        if (code.length > PREFIX_LOOKUP_BITS)
+        {
+            DecodeEntry &entry = this->lookup[code.bits >> (code.length - PREFIX_LOOKUP_BITS)];
+            entry.subBits = std::max<uint8_t>(entry.subBits, code.length - PREFIX_LOOKUP_BITS);
+        }
+    }
+    for (DecodeEntry &entry : this->lookup)
+    {
+        if (entry.subBits)
+        {
+            entry.value = static_cast<uint32_t>(this->secondary.size());
+            this->secondary.resize(this->secondary.size() + (size_t(1) << entry.subBits), DecodeEntry{0, 0, 0});
+        }
+    }
+
+    for (int symbol = 0; symbol < CODER_SYMBOLS; symbol++)
+    {
+        const SymbolCode &code = this->table[symbol];
+        if (!code.length)
+        {
+            continue;
+        }
+        DecodeEntry *first;
+        int spare;
+        if (code.length <= PREFIX_LOOKUP_BITS)
+        {
+            spare = PREFIX_LOOKUP_BITS - code.length;
+            first = &this->lookup[static_cast<size_t>(code.bits) << spare];
+        }
+        else
+        {
+            const DecodeEntry &prefix = this->lookup[code.bits >> (code.length - PREFIX_LOOKUP_BITS)];
+            int extra = code.length - PREFIX_LOOKUP_BITS;
+            spare = prefix.subBits - extra;
+            first = &this->secondary[prefix.value + ((static_cast<size_t>(code.bits) & ((size_t(1) << extra) - 1)) << spare)];
+        }
+        std::fill(first, first + (size_t(1) << spare), DecodeEntry{static_cast<uint32_t>(symbol), code.length, 0});
+    }
+}
+
+/**
+ * @brief Huffman code lengths, the depths of the tree built by merging the two rarest nodes.
+ * @details Two queues: leaves sorted by count and merged nodes, which are
+ *          created in order of count, so each merge picks from the queue heads.
+ */
+int HuffmanCoder::buildLengths(const std::array<uint64_t, CODER_SYMBOLS> &counts, std::array<uint8_t, CODER_SYMBOLS> &lengths) const
+{
+    std::vector<std::pair<uint64_t, int>> leaves;
+    for (int symbol = 0; symbol < CODER_SYMBOLS; symbol++)
+    {
+        if (counts[symbol])
+        {
+            leaves.emplace_back(counts[symbol], symbol);
+        }
+    }
+    std::sort(leaves.begin(), leaves.end());
+
+    // Nodes 0..n-1 are the leaves, n.. the merged nodes in order of creation
+    const size_t n = leaves.size();
+    std::vector<uint64_t> weight(2 * n - 1);
+    std::vector<size_t> parent(2 * n - 1);
+    for (size_t i = 0; i < n; i++)
+    {
+        weight[i] = leaves[i].first;
+    }
+    size_t leaf = 0, merged = n;
+    auto rarest = [&](size_t created)
+    {
+        if (leaf < n && (merged == created || weight[leaf] <= weight[merged]))
+        {
+            return leaf++;
+        }
+        return merged++;
+    };
+    for (size_t created = n; created < 2 * n - 1; created++)
+    {
+        size_t a = rarest(created);
+        size_t b = rarest(created);
+        weight[created] = weight[a] + weight[b];
+        parent[a] = parent[b] = created;
+    }
+
+    // Depths from the root (created last) down
+    std::vector<int> depth(2 * n - 1, 0);
+    int deepest = 0;
+    for (size_t node = 2 * n - 2; node-- > 0;)
+    {
+        depth[node] = depth[parent[node]] + 1;
+        if (node < n)
+        {
+            deepest = std::max(deepest, depth[node]);
+            lengths[leaves[node].second] = static_cast<uint8_t>(std::min(depth[node], 255));
+        }
+    }
+    return deepest;
+}
+
+/* tANS */
+
+void TansCoder::buildTable(std::span<const uint8_t> input)
+{
+    std::array<uint64_t, CODER_SYMBOLS> counts = countBytes(input);
+    const uint64_t total = input.size();
+    const uint32_t states = 1u << TANS_TABLE_LOG;
+
+    // Proportional share of the states rounded down, every present symbol keeps at least one
+    uint32_t sum = 0;
+    std::vector<std::pair<uint64_t, int>> remainders;
+    for (int symbol = 0; symbol < CODER_SYMBOLS; symbol++)
+    {
+        uint64_t scaled = counts[symbol] * states;
+        this->frequencies[symbol] = counts[symbol] ? static_cast<uint16_t>(std::max<uint64_t>(1, scaled / total)) : 0;
+        sum += this->frequencies[symbol];
+        if (counts[symbol] && scaled >= total)
+        {
+            remainders.emplace_back(scaled % total, symbol);
+        }
+    }
+
+    // Leftover states go to the largest remainders, excess comes off the largest shares
+    std::stable_sort(remainders.begin(), remainders.end(), [](const auto &a, const auto &b)
+                     { return a.first > b.first; });
+    for (size_t i = 0; sum < states; i = (i + 1) % remainders.size())
+    {
+        this->frequencies[remainders[i].second]++;
+        sum++;
+    }
+    while (sum > states)
+    {
+        (*std::max_element(this->frequencies.begin(), this->frequencies.end()))--;
+        sum--;
+    }
+    buildStates();
+}
+
+/**
+ * @brief Spreads the symbols over the states and derives both transition tables.
+ * @return false if the frequencies do not sum to 2^TANS_TABLE_LOG
+ */
+bool TansCoder::buildStates()
+{
+    const uint32_t states = 1u << TANS_TABLE_LOG;
+    uint32_t sum = 0;
+    for (int symbol = 0; symbol < CODER_SYMBOLS; symbol++)
+    {
+        this->first[symbol] = sum;
+        sum += this->frequencies[symbol];
+    }
+    if (sum != states)
+    {
+        return false;
+    }
+
+    // Spread each symbol's states across the table with an odd stride, which visits every state once
+    std::vector<uint8_t> spread(states);
+    const uint32_t stride = (states >> 1) + (states >> 3) + 3;
+    uint32_t position = 0;
+    for (int symbol = 0; symbol < CODER_SYMBOLS; symbol++)
+    {
+        for (uint32_t i = 0; i < this->frequencies[symbol]; i++)
+        {
+            spread[position] = static_cast<uint8_t>(symbol);
+            position = (position + stride) & (states - 1);
+        }
+    }
+
+    // The j-th state of a symbol s in table order is its sub-state f_s + j
+    this->next.assign(states, 0);
+    this->states.assign(states, State{0, 0, 0});
+    std::array<uint32_t, CODER_SYMBOLS> seen{};
+    for (uint32_t state = 0; state < states; state++)
+    {
+        uint8_t symbol = spread[state];
+        uint32_t sub = this->frequencies[symbol] + seen[symbol];
+        this->next[this->first[symbol] + seen[symbol]++] = static_cast<uint16_t>(state);
+
+        uint8_t bits = static_cast<uint8_t>(TANS_TABLE_LOG + 1 - bitWidth(sub));
+        this->states[state] = State{static_cast<uint16_t>((sub << bits) - states), symbol, bits};
+    }
+
+    // Encoding reduces a state in [L, 2L) to the symbol's range [f, 2f)
+    for (int symbol = 0; symbol < CODER_SYMBOLS; symbol++)
+    {
+        uint32_t frequency = this->frequencies[symbol];
+        if (frequency)
+        {
+            this->shift[symbol] = static_cast<uint8_t>(TANS_TABLE_LOG + 1 - bitWidth(frequency));
+            this->threshold[symbol] = frequency << this->shift[symbol];
+        }
+    }
+    return true;
+}
+
+size_t TansCoder::encode(std::span<const uint8_t> input, std::vector<uint8_t> &output) const
+{
+    const uint32_t states = 1u << TANS_TABLE_LOG;
+    const size_t offset = output.size();
+    output.resize(offset + (input.size() * TANS_TABLE_LOG + 2 * TANS_TABLE_LOG + 1) / 8 + 2 * sizeof(uint64_t));
+    uint8_t *out = output.data() + offset;
+
+    // Least significant bit first, the accumulator is stored whenever 32 bits are ready
+    uint64_t acc = 0;
+    int pending = 0;
+    size_t bits = 0;
+    std::array<uint32_t, 2> state = {states, states}; // Even and odd positions
+    for (size_t i = input.size(); i-- > 0;)
+    {
+        const uint8_t symbol = input[i];
+        const uint32_t frequency = this->frequencies[symbol];
+        if (!frequency)
+        {
+            output.resize(offset);
+            throw std::invalid_argument(std::format("Byte {} has no code.", static_cast<int>(symbol)));
+        }
+        uint32_t &current = state[i & 1];
+        int count = this->shift[symbol] - (current < this->threshold[symbol]);
+        acc |= static_cast<uint64_t>(current & ((1u << count) - 1)) << pending;
+        pending += count;
+        bits += count;
+        current = states + this->next[this->first[symbol] + (current >> count) - frequency];
+        if (pending >= 32)
+        {
+            uint32_t word = static_cast<uint32_t>(acc);
+            std::memcpy(out, &word, sizeof(word));
+            out += 4;
+            acc >>= 32;
+            pending -= 32;
+        }
+    }
+
+    // Final states, the even one read first, then the 1 bit the decoder starts from
+    for (int k = 1; k >= 0; k--)
+    {
+        acc |= static_cast<uint64_t>(state[k] - states) << pending;
+        pending += TANS_TABLE_LOG;
+    }
+    acc |= uint64_t(1) << pending;
+    pending++;
+    bits += 2 * TANS_TABLE_LOG + 1;
+    while (pending > 0)
+    {
+        *out++ = static_cast<uint8_t>(acc);
+        acc >>= 8;
+        pending -= 8;
+    }
+    output.resize(out - output.data());
+    return bits;
+}
+
+bool TansCoder::decode(std::span<const uint8_t> packed, std::span<uint8_t> output) const
+{
+    if (this->states.empty() || packed.empty() || !packed.back())
+    {
+        return false;
+    }
+
+    // Bits are read backwards from the terminating 1 bit, out of a window holding bits [base, base + 64)
+    const uint8_t *data = packed.data();
+    const size_t size = packed.size();
+    size_t position = (size - 1) * 8 + bitWidth(packed.back()) - 1;
+    size_t base = 0;
+    uint64_t window = 0;
+    auto refill = [&]()
+    {
+        base = position > 56 ? (position - 56) & ~size_t(7) : 0;
+        size_t byte = base / 8;
+        window = 0;
+        if (byte + sizeof(window) <= size)
+        {
+            std::memcpy(&window, data + byte, sizeof(window));
+        }
+        else
+        {
+            for (size_t i = byte; i < size; i++)
+            {
+                window |= static_cast<uint64_t>(data[i]) << (8 * (i - byte));
+            }
+        }
+    };
+
+    if (position < 2 * TANS_TABLE_LOG)
+    {
+        return false;
+    }
+    refill();
+    std::array<uint32_t, 2> state;
+    for (uint32_t &current : state)
+    {
+        position -= TANS_TABLE_LOG;
+        current = static_cast<uint32_t>(window >> (position - base)) & ((1u << TANS_TABLE_LOG) - 1);
+    }
+
+    // Away from the stream's start a refill leaves at least 56 bits, enough for four symbols unchecked;
+    // the two states are independent chains, so their table lookups overlap
+    size_t i = 0;
+    for (; i + 4 <= output.size() && position >= 64; i += 4)
+    {
+        refill();
+        for (int k = 0; k < 4; k++)
+        {
+            uint32_t &current = state[k & 1];
+            const State entry = this->states[current];
+            output[i + k] = entry.symbol;
+            position -= entry.bits;
+            current = entry.base + (static_cast<uint32_t>(window >> (position - base)) & ((1u << entry.bits) - 1));
+        }
+    }
+    for (; i < output.size(); i++)
+    {
+        uint32_t &current = state[i & 1];
+        const State entry = this->states[current];
+        if (entry.bits > position)
+        {
+            return false;
+        }
+        if (position - base < entry.bits)
+        {
+            refill();
+        }
+        output[i] = entry.symbol;
+        position -= entry.bits;
+        current = entry.base + (static_cast<uint32_t>(window >> (position - base)) & ((1u << entry.bits) - 1));
+    }
+
+    // Back at the initial states with every bit used, or the stream is corrupt
+    return state[0] == 0 && state[1] == 0 && position == 0;
+}
+
+void TansCoder::writeTable(std::vector<uint8_t> &output) const
+{
+    BitWriter writer(output);
+    for (int symbol = 0; symbol < CODER_SYMBOLS;)
+    {
+        if (!this->frequencies[symbol])
+        {
+            int run = 1;
+            while (symbol + run < CODER_SYMBOLS && run < 32 && !this->frequencies[symbol + run])
+            {
+                run++;
+            }
+            writer.put(0, 1);
+            writer.put(run - 1, 5);
+            symbol += run;
+            continue;
+        }
+        int width = bitWidth(this->frequencies[symbol]);
+        writer.put(1, 1);
+        writer.put(width, 4);
+        writer.put(this->frequencies[symbol], width - 1);
+        symbol++;
+    }
+    writer.flush();
+}
+
+size_t TansCoder::readTable(std::span<const uint8_t> input)
+{
+    BitReader reader(input);
+    std::array<uint16_t, CODER_SYMBOLS> read{};
+    for (int symbol = 0; symbol < CODER_SYMBOLS;)
+    {
+        if (!reader.get(1))
+        {
+            symbol += reader.get(5) + 1;
+            continue;
+        }
+        int width = reader.get(4);
+        if (width < 1 || width > TANS_TABLE_LOG + 1)
+        {
+            return 0;
+        }
+        read[symbol++] = static_cast<uint16_t>((1u << (width - 1)) | reader.get(width - 1));
+    }
+
+    std::array<uint16_t, CODER_SYMBOLS> previous = this->frequencies;
+    this->frequencies = read;
+    if (reader.overrun() || !buildStates())
+    {
+        this->frequencies = previous;
+        return 0;
+    }
+    return reader.consumed();
+}
+
+/* Coder Selection */
+
+std::unique_ptr<EntropyCoder> makeEntropyCoder(CoderId id)
+{
+    switch (id)
+    {
+    case CODER_SHANNON_FANO:
+        return std::make_unique<ShannonFano>();
+    case CODER_HUFFMAN:
+        return std::make_unique<HuffmanCoder>();
+    case CODER_TANS:
+        return std::make_unique<TansCoder>();
+    default:
+        return nullptr;
+    }
+}
+
+const char *coderName(CoderId id)
+{
+    return id < CODERS ? coderNames[id] : "unknown";
+}
+
+bool parseCoderName(const std::string &name, CoderId &id)
+{
+    for (int i = 0; i < CODERS; i++)
+    {
+        if (name == coderNames[i])
+        {
+            id = static_cast<CoderId>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Entropy Frames */
+
+void packEntropyFrame(EntropyCoder &coder, std::span<const uint8_t> input, std::vector<uint8_t> &output)
+{
+    coder.buildTable(input);
+    const size_t header = output.size();
+    output.push_back(coder.id());
+    putBigEndian(output, static_cast<uint32_t>(input.size()));
+    putBigEndian(output, 0);
+    coder.writeTable(output);
+
+    // Coded size is known once encoded, patch it into the header
+    const size_t payload = output.size();
+    coder.encode(input, output);
+    const uint32_t coded = static_cast<uint32_t>(output.size() - payload);
+    for (int i = 0; i < 4; i++)
+    {
+        output[header + 5 + i] = static_cast<uint8_t>(coded >> (24 - 8 * i));
+    }
+}
+
+size_t unpackEntropyFrame(std::span<const uint8_t> frame, std::vector<uint8_t> &output, size_t limit)
+{
+    if (frame.size() < ENTROPY_FRAME_HEADER)
+    {
+        return 0;
+    }
+    std::unique_ptr<EntropyCoder> coder = makeEntropyCoder(static_cast<CoderId>(frame[0]));
+    const uint32_t count = getBigEndian(frame.data() + 1);
+    const uint32_t coded = getBigEndian(frame.data() + 5);
+    if (!coder || count > limit)
+    {
+        return 0;
+    }
+
+    size_t table = coder->readTable(frame.subspan(ENTROPY_FRAME_HEADER));
+    if (!table || frame.size() - ENTROPY_FRAME_HEADER - table < coded)
+    {
+        return 0;
+    }
+    output.resize(count);
+    if (!coder->decode(frame.subspan(ENTROPY_FRAME_HEADER + table, coded), output))
+    {
+        return 0;
+    }
+    return ENTROPY_FRAME_HEADER + table + coded;
+}
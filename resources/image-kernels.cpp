@@ -0,0 +1,618 @@
+#include "image-kernels.h"
+#include <cmath>
+#include <cstdio>
+#include <openssl/evp.h>
+#include <opencv4/opencv2/imgproc.hpp>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KERNELS_X86 1
+#endif
+
+namespace
+{
+    // B,G,R mask repeated over lcm(3, 32) bytes so every vector load lines up with it
+    struct MaskPattern
+    {
+        alignas(32) uint8_t bytes[96];
+    };
+
+    MaskPattern makePattern(const Filter &filter)
+    {
+        MaskPattern pattern;
+        for (size_t i = 0; i < sizeof(pattern.bytes); i++)
+        {
+            pattern.bytes[i] = i % 3 == 0 ? filter._blu : (i % 3 == 1 ? filter._grn : filter._red);
+        }
+        return pattern;
+    }
+
+    // Bytes [start, bytes) of one row, 'start' is a multiple of 3
+    void maskRowScalar(const uint8_t *src, uint8_t *const *dst, const MaskPattern *masks, size_t count, size_t start, size_t bytes)
+    {
+        for (size_t i = start; i < bytes; i += 3)
+        {
+            uint8_t b = src[i];
+            uint8_t g = src[i + 1];
+            uint8_t r = src[i + 2];
+            for (size_t k = 0; k < count; k++)
+            {
+                dst[k][i] = b & masks[k].bytes[0];
+                dst[k][i + 1] = g & masks[k].bytes[1];
+                dst[k][i + 2] = r & masks[k].bytes[2];
+            }
+        }
+    }
+
+#ifdef KERNELS_X86
+    // Bytes [start, bytes), 48 (16 pixels) per iteration, returns where it stopped
+    size_t maskRowSse2(const uint8_t *src, uint8_t *const *dst, const MaskPattern *masks, size_t count, size_t start, size_t bytes)
+    {
+        size_t i = start;
+        for (; i + 48 <= bytes; i += 48)
+        {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 16));
+            __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 32));
+            for (size_t k = 0; k < count; k++)
+            {
+                const __m128i *mask = reinterpret_cast<const __m128i *>(masks[k].bytes);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst[k] + i), _mm_and_si128(a, _mm_load_si128(mask)));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst[k] + i + 16), _mm_and_si128(b, _mm_load_si128(mask + 1)));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst[k] + i + 32), _mm_and_si128(c, _mm_load_si128(mask + 2)));
+            }
+        }
+        return i;
+    }
+
+    // Bytes [start, bytes), 96 (32 pixels) per iteration, returns where it stopped
+    __attribute__((target("avx2"))) size_t maskRowAvx2(const uint8_t *src, uint8_t *const *dst, const MaskPattern *masks, size_t count, size_t start, size_t bytes)
+    {
+        size_t i = start;
+        for (; i + 96 <= bytes; i += 96)
+        {
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+            __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i + 32));
+            __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i + 64));
+            for (size_t k = 0; k < count; k++)
+            {
+                const __m256i *mask = reinterpret_cast<const __m256i *>(masks[k].bytes);
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst[k] + i), _mm256_and_si256(a, _mm256_load_si256(mask)));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst[k] + i + 32), _mm256_and_si256(b, _mm256_load_si256(mask + 1)));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst[k] + i + 64), _mm256_and_si256(c, _mm256_load_si256(mask + 2)));
+            }
+        }
+        return i;
+    }
+#endif
+
+    // Bytes [start, bytes) of one row, 'start' is a multiple of 3
+    void maskRow(const uint8_t *src, uint8_t *const *dst, const MaskPattern *masks, size_t count, size_t start, size_t bytes, KernelIsa isa)
+    {
+        size_t done = start;
+#ifdef KERNELS_X86
+        if (isa == ISA_AVX2)
+        {
+            done = maskRowAvx2(src, dst, masks, count, start, bytes);
+        }
+        else if (isa >= ISA_SSE2)
+        {
+            done = maskRowSse2(src, dst, masks, count, start, bytes);
+        }
+#endif
+        maskRowScalar(src, dst, masks, count, done, bytes);
+    }
+
+    // Signed Q3.12 coefficients (rows: output R,G,B, columns: input R,G,B), Q12 offsets with rounding folded in
+    struct FixedMatrix
+    {
+        int16_t coef[3][3];
+        int32_t offset[3];
+    };
+
+    FixedMatrix quantize(const ColorMatrix &matrix)
+    {
+        FixedMatrix fixed;
+        for (int row = 0; row < 3; row++)
+        {
+            for (int col = 0; col < 3; col++)
+            {
+                long value = std::lround(matrix.m[row][col] * 4096.0f);
+                fixed.coef[row][col] = static_cast<int16_t>(std::clamp<long>(value, INT16_MIN, INT16_MAX));
+            }
+            fixed.offset[row] = static_cast<int32_t>(std::lround(matrix.m[row][3] * 4096.0f)) + 2048;
+        }
+        return fixed;
+    }
+
+    // Pixels [start, pixels) of one row; defines the exact result of every ISA.
+    // 'bands' null: BGR outputs, otherwise 8-bit planes computed by row bands[k] of each matrix
+    void transformRowScalar(const uint8_t *src, uint8_t *const *dst, const FixedMatrix *fixed, const int *bands,
+                            size_t count, size_t start, size_t pixels)
+    {
+        for (size_t p = start; p < pixels; p++)
+        {
+            int b = src[3 * p];
+            int g = src[3 * p + 1];
+            int r = src[3 * p + 2];
+            for (size_t k = 0; k < count; k++)
+            {
+                const FixedMatrix &f = fixed[k];
+                for (int c = bands ? bands[k] : 0; c < (bands ? bands[k] + 1 : 3); c++)
+                {
+                    int value = (f.coef[c][0] * r + f.coef[c][1] * g + f.coef[c][2] * b + f.offset[c]) >> 12;
+                    uint8_t out = static_cast<uint8_t>(std::clamp(value, 0, 255));
+                    if (bands)
+                    {
+                        dst[k][p] = out;
+                    }
+                    else
+                    {
+                        dst[k][3 * p + 2 - c] = out;
+                    }
+                }
+            }
+        }
+    }
+
+#ifdef KERNELS_X86
+    // pshufb controls moving 16 interleaved BGR pixels (three vectors) to planes and back
+    struct ShuffleTables
+    {
+        alignas(16) int8_t split[3][3][16]; // [plane B,G,R][source vector][plane byte]
+        alignas(16) int8_t join[3][3][16];  // [output vector][plane B,G,R][output byte]
+
+        ShuffleTables()
+        {
+            for (int ch = 0; ch < 3; ch++)
+            {
+                for (int v = 0; v < 3; v++)
+                {
+                    for (int d = 0; d < 16; d++)
+                    {
+                        int idx = 3 * d + ch;
+                        split[ch][v][d] = idx / 16 == v ? idx % 16 : -128;
+                        int j = 16 * v + d;
+                        join[v][ch][d] = j % 3 == ch ? j / 3 : -128;
+                    }
+                }
+            }
+        }
+    };
+
+    const ShuffleTables shuffles;
+
+    struct VectorMatrix
+    {
+        __m128i rg[3];     // (R, G) coefficient pair per output channel
+        __m128i b[3];      // (B, 0)
+        __m128i offset[3];
+    };
+
+    // Coefficients broadcast for transformRowSse41(), once per transform rather than per row
+    std::vector<VectorMatrix> broadcastMatrices(const std::vector<FixedMatrix> &fixed)
+    {
+        std::vector<VectorMatrix> matrices(fixed.size());
+        for (size_t k = 0; k < fixed.size(); k++)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                uint32_t rg = static_cast<uint16_t>(fixed[k].coef[c][0]) | (static_cast<uint32_t>(static_cast<uint16_t>(fixed[k].coef[c][1])) << 16);
+                matrices[k].rg[c] = _mm_set1_epi32(rg);
+                matrices[k].b[c] = _mm_set1_epi32(static_cast<uint16_t>(fixed[k].coef[c][2]));
+                matrices[k].offset[c] = _mm_set1_epi32(fixed[k].offset[c]);
+            }
+        }
+        return matrices;
+    }
+
+    // Pixels [start, pixels), 16 per iteration, returns where it stopped
+    __attribute__((target("sse4.1"))) size_t transformRowSse41(const uint8_t *src, uint8_t *const *dst, const VectorMatrix *matrices, const int *bands,
+                                                               size_t count, size_t start, size_t pixels)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        size_t p = start;
+        for (; p + 16 <= pixels; p += 16)
+        {
+            const uint8_t *in = src + 3 * p;
+            __m128i v[3] = {_mm_loadu_si128(reinterpret_cast<const __m128i *>(in)),
+                            _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + 16)),
+                            _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + 32))};
+
+            // Deinterleave once for every matrix
+            __m128i plane[3];
+            for (int ch = 0; ch < 3; ch++)
+            {
+                const __m128i *split = reinterpret_cast<const __m128i *>(shuffles.split[ch]);
+                plane[ch] = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v[0], _mm_load_si128(split)),
+                                                      _mm_shuffle_epi8(v[1], _mm_load_si128(split + 1))),
+                                         _mm_shuffle_epi8(v[2], _mm_load_si128(split + 2)));
+            }
+            __m128i b16[2] = {_mm_cvtepu8_epi16(plane[0]), _mm_unpackhi_epi8(plane[0], zero)};
+            __m128i g16[2] = {_mm_cvtepu8_epi16(plane[1]), _mm_unpackhi_epi8(plane[1], zero)};
+            __m128i r16[2] = {_mm_cvtepu8_epi16(plane[2]), _mm_unpackhi_epi8(plane[2], zero)};
+            __m128i rg[4] = {_mm_unpacklo_epi16(r16[0], g16[0]), _mm_unpackhi_epi16(r16[0], g16[0]),
+                             _mm_unpacklo_epi16(r16[1], g16[1]), _mm_unpackhi_epi16(r16[1], g16[1])};
+            __m128i bz[4] = {_mm_unpacklo_epi16(b16[0], zero), _mm_unpackhi_epi16(b16[0], zero),
+                             _mm_unpacklo_epi16(b16[1], zero), _mm_unpackhi_epi16(b16[1], zero)};
+
+            for (size_t k = 0; k < count; k++)
+            {
+                const VectorMatrix &m = matrices[k];
+                __m128i out[3]; // B,G,R planes
+                for (int c = bands ? bands[k] : 0; c < (bands ? bands[k] + 1 : 3); c++)
+                {
+                    __m128i acc[4];
+                    for (int i = 0; i < 4; i++)
+                    {
+                        acc[i] = _mm_add_epi32(_mm_madd_epi16(rg[i], m.rg[c]), _mm_madd_epi16(bz[i], m.b[c]));
+                        acc[i] = _mm_srai_epi32(_mm_add_epi32(acc[i], m.offset[c]), 12);
+                    }
+                    out[2 - c] = _mm_packus_epi16(_mm_packs_epi32(acc[0], acc[1]), _mm_packs_epi32(acc[2], acc[3]));
+                }
+                if (bands)
+                {
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst[k] + p), out[2 - bands[k]]);
+                    continue;
+                }
+
+                uint8_t *o = dst[k] + 3 * p;
+                for (int ov = 0; ov < 3; ov++)
+                {
+                    const __m128i *join = reinterpret_cast<const __m128i *>(shuffles.join[ov]);
+                    __m128i bytes = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(out[0], _mm_load_si128(join)),
+                                                              _mm_shuffle_epi8(out[1], _mm_load_si128(join + 1))),
+                                                 _mm_shuffle_epi8(out[2], _mm_load_si128(join + 2)));
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(o + 16 * ov), bytes);
+                }
+            }
+        }
+        return p;
+    }
+#endif
+
+    /**
+     * Deterministic split of an image into tiles of about KERNEL_TILE_BYTES input
+     * bytes. A row longer than a tile is cut into whole tiles of a multiple of 32
+     * pixels, otherwise whole rows are grouped; continuous images are one long row.
+     * The tiles depend on the image size only, never on the thread count.
+     */
+    struct Tiling
+    {
+        int rows;
+        size_t rowPixels;
+        size_t tilePixels;  // Pixels per tile when rows are cut
+        size_t tilesPerRow;
+        int rowsPerTile;    // Rows per tile when rows are grouped
+        size_t tiles;
+
+        Tiling(const cv::Mat &image, bool continuous)
+            : rows(continuous ? 1 : image.rows),
+              rowPixels(continuous ? image.total() : static_cast<size_t>(image.cols)),
+              tilePixels(std::max<size_t>(32, KERNEL_TILE_BYTES / std::max<size_t>(1, image.elemSize()) / 32 * 32)),
+              tilesPerRow(std::max<size_t>(1, (rowPixels + tilePixels - 1) / tilePixels)),
+              rowsPerTile(tilesPerRow > 1 || rowPixels == 0 ? 1 : static_cast<int>(std::max<size_t>(1, tilePixels / rowPixels))),
+              tiles(rowPixels == 0 || rows == 0 ? 0 : (tilesPerRow > 1 ? rows * tilesPerRow : (rows + rowsPerTile - 1) / rowsPerTile))
+        {
+        }
+    };
+
+    // Runs body(tile, y, first, count) for every span of every tile, tiles spread over OpenCV's thread pool
+    template <typename Body>
+    void parallelTiles(const Tiling &tiling, Body &&body)
+    {
+        if (tiling.tiles == 0)
+        {
+            return;
+        }
+        cv::parallel_for_(
+            cv::Range(0, static_cast<int>(tiling.tiles)),
+            [&](const cv::Range &range)
+            {
+                for (int tile = range.start; tile < range.end; tile++)
+                {
+                    if (tiling.tilesPerRow > 1)
+                    {
+                        size_t first = (tile % tiling.tilesPerRow) * tiling.tilePixels;
+                        body(tile, static_cast<int>(tile / tiling.tilesPerRow), first, std::min(tiling.tilePixels, tiling.rowPixels - first));
+                        continue;
+                    }
+                    int end = std::min(tiling.rows, (tile + 1) * tiling.rowsPerTile);
+                    for (int y = tile * tiling.rowsPerTile; y < end; y++)
+                    {
+                        body(tile, y, size_t{0}, tiling.rowPixels);
+                    }
+                }
+            },
+            static_cast<double>(tiling.tiles));
+    }
+
+    // Start of every row of every output, row y of output k at [y * outputs + k]; set up once per
+    // call so tiles index it instead of gathering pointers themselves
+    std::vector<uint8_t *> rowPointers(std::vector<cv::Mat> &outputs, int rows)
+    {
+        std::vector<uint8_t *> table(static_cast<size_t>(rows) * outputs.size());
+        for (int y = 0; y < rows; y++)
+        {
+            for (size_t k = 0; k < outputs.size(); k++)
+            {
+                table[y * outputs.size() + k] = outputs[k].ptr<uint8_t>(y);
+            }
+        }
+        return table;
+    }
+
+    // out = a - b (subtract) or a + b mod 256 per byte, the loop vectorizes as is
+    bool wrapBytes(const cv::Mat &a, const cv::Mat &b, cv::Mat &out, bool subtract)
+    {
+        if (a.depth() != CV_8U || a.size() != b.size() || a.type() != b.type())
+        {
+            return false;
+        }
+        out.create(a.size(), a.type());
+        size_t size = a.elemSize();
+        parallelTiles(Tiling(a, a.isContinuous() && b.isContinuous() && out.isContinuous()),
+                      [&](int, int y, size_t first, size_t count)
+                      {
+                          const uint8_t *pa = a.ptr<uint8_t>(y) + first * size;
+                          const uint8_t *pb = b.ptr<uint8_t>(y) + first * size;
+                          uint8_t *po = out.ptr<uint8_t>(y) + first * size;
+                          for (size_t i = 0; i < count * size; i++)
+                          {
+                              po[i] = static_cast<uint8_t>(subtract ? pa[i] - pb[i] : pa[i] + pb[i]);
+                          }
+                      });
+        return true;
+    }
+
+    // Shared driver of transformColors() and extractPlanes()
+    bool runTransform(const cv::Mat &input, const std::vector<ColorMatrix> &matrices, const int *bands, int outputType,
+                      std::vector<cv::Mat> &outputs, KernelIsa isa)
+    {
+        if (input.type() != CV_8UC3)
+        {
+            return false;
+        }
+
+        std::vector<FixedMatrix> fixed;
+        for (const ColorMatrix &matrix : matrices)
+        {
+            if (!matrix.inRange())
+            {
+                return false;
+            }
+            fixed.push_back(quantize(matrix));
+        }
+
+        isa = std::min(isa, detectKernelIsa());
+#ifdef KERNELS_X86
+        std::vector<VectorMatrix> vectors;
+        if (isa >= ISA_SSE41)
+        {
+            vectors = broadcastMatrices(fixed);
+        }
+#endif
+        outputs.resize(matrices.size());
+        bool continuous = input.isContinuous();
+        for (cv::Mat &output : outputs)
+        {
+            output.create(input.size(), outputType);
+            continuous = continuous && output.isContinuous();
+        }
+
+        Tiling tiling(input, continuous);
+        std::vector<uint8_t *> rows = rowPointers(outputs, tiling.rows);
+        parallelTiles(tiling,
+                      [&](int, int y, size_t first, size_t count)
+                      {
+                          const uint8_t *src = input.ptr<uint8_t>(y);
+                          uint8_t *const *dst = rows.data() + y * outputs.size();
+                          size_t done = first;
+#ifdef KERNELS_X86
+                          if (isa >= ISA_SSE41)
+                          {
+                              done = transformRowSse41(src, dst, vectors.data(), bands, fixed.size(), first, first + count);
+                          }
+#endif
+                          transformRowScalar(src, dst, fixed.data(), bands, fixed.size(), done, first + count);
+                      });
+        return true;
+    }
+}
+
+KernelIsa detectKernelIsa()
+{
+#ifdef KERNELS_X86
+    static const KernelIsa isa = __builtin_cpu_supports("avx2")     ? ISA_AVX2
+                                 : __builtin_cpu_supports("sse4.1") ? ISA_SSE41
+                                                                    : ISA_SSE2;
+    return isa;
+#else
+    return ISA_SCALAR;
+#endif
+}
+
+bool isChannelMask(const Filter &filter)
+{
+    for (uint8_t weight : {filter._red, filter._grn, filter._blu})
+    {
+        if (weight != 0 && weight != 255)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool asChannelMask(const ColorMatrix &matrix, Filter &filter)
+{
+    uint8_t weights[3];
+    for (int row = 0; row < 3; row++)
+    {
+        for (int col = 0; col < 4; col++)
+        {
+            if (col != row && matrix.m[row][col] != 0.0f)
+            {
+                return false;
+            }
+        }
+        if (matrix.m[row][row] != 0.0f && matrix.m[row][row] != 1.0f)
+        {
+            return false;
+        }
+        weights[row] = matrix.m[row][row] ? 255 : 0;
+    }
+    filter = Filter(weights[0], weights[1], weights[2]);
+    return true;
+}
+
+bool separateChannels(const cv::Mat &input, const std::vector<Filter> &filters, std::vector<cv::Mat> &outputs, KernelIsa isa)
+{
+    if (input.type() != CV_8UC3)
+    {
+        return false;
+    }
+
+    std::vector<MaskPattern> masks;
+    for (const Filter &filter : filters)
+    {
+        if (!isChannelMask(filter))
+        {
+            return false;
+        }
+        masks.push_back(makePattern(filter));
+    }
+
+    isa = std::min(isa, detectKernelIsa());
+    outputs.resize(filters.size());
+    bool continuous = input.isContinuous();
+    for (cv::Mat &output : outputs)
+    {
+        output.create(input.size(), CV_8UC3);
+        continuous = continuous && output.isContinuous();
+    }
+
+    Tiling tiling(input, continuous);
+    std::vector<uint8_t *> rows = rowPointers(outputs, tiling.rows);
+    parallelTiles(tiling,
+                  [&](int, int y, size_t first, size_t count)
+                  {
+                      maskRow(input.ptr<uint8_t>(y), rows.data() + y * outputs.size(), masks.data(), masks.size(),
+                              first * 3, (first + count) * 3, isa);
+                  });
+    return true;
+}
+
+bool transformColors(const cv::Mat &input, const std::vector<ColorMatrix> &matrices, std::vector<cv::Mat> &outputs, KernelIsa isa)
+{
+    return runTransform(input, matrices, nullptr, CV_8UC3, outputs, isa);
+}
+
+bool extractPlanes(const cv::Mat &input, const std::vector<ColorMatrix> &matrices, std::vector<cv::Mat> &planes, KernelIsa isa)
+{
+    std::vector<int> bands;
+    for (const ColorMatrix &matrix : matrices)
+    {
+        int row;
+        if (!matrix.bandChannels(row))
+        {
+            return false;
+        }
+        bands.push_back(row);
+    }
+    return runTransform(input, matrices, bands.data(), CV_8UC1, planes, isa);
+}
+
+bool regionRect(cv::Size capture, RegionInfo &region, cv::Rect &rect)
+{
+    if (region.scale == 0 || region.scale > REGION_SCALE_ONE || region.x >= capture.width || region.y >= capture.height)
+    {
+        return false;
+    }
+
+    int width = region.width ? std::min<int>(region.width, capture.width - region.x) : capture.width - region.x;
+    int height = region.height ? std::min<int>(region.height, capture.height - region.y) : capture.height - region.y;
+    rect = cv::Rect(region.x, region.y, width, height);
+    region.width = width;
+    region.height = height;
+    region.captureWidth = capture.width;
+    region.captureHeight = capture.height;
+    return true;
+}
+
+void scaleRegion(const cv::Mat &crop, const RegionInfo &region, cv::Mat &output)
+{
+    if (region.scale == REGION_SCALE_ONE)
+    {
+        output = crop;
+        return;
+    }
+
+    cv::Size size(std::max(1, (crop.cols * region.scale + REGION_SCALE_ONE / 2) / REGION_SCALE_ONE),
+                  std::max(1, (crop.rows * region.scale + REGION_SCALE_ONE / 2) / REGION_SCALE_ONE));
+    cv::resize(crop, output, size, 0, 0, cv::INTER_AREA);
+}
+
+bool cropRegion(const cv::Mat &capture, RegionInfo &region, cv::Mat &output)
+{
+    cv::Rect rect;
+    if (!regionRect(capture.size(), region, rect))
+    {
+        return false;
+    }
+    scaleRegion(capture(rect), region, output);
+    return true;
+}
+
+bool deltaEncode(const cv::Mat &frame, const cv::Mat &reference, cv::Mat &residual)
+{
+    return wrapBytes(frame, reference, residual, true);
+}
+
+bool applyDelta(const cv::Mat &reference, const cv::Mat &residual, cv::Mat &frame)
+{
+    return wrapBytes(residual, reference, frame, false);
+}
+
+std::string frameDigest(const cv::Mat &image)
+{
+    // Row-wise tiling, so padded and continuous copies of an image hash alike
+    Tiling tiling(image, false);
+    const EVP_MD *md = EVP_md5();
+    const size_t size = EVP_MD_get_size(md);
+    std::vector<unsigned char> digests(tiling.tiles * size);
+    std::vector<EVP_MD_CTX *> contexts(tiling.tiles);
+
+    parallelTiles(tiling,
+                  [&](int tile, int y, size_t first, size_t count)
+                  {
+                      // Grouped rows arrive in order, the tile's first row opens its context
+                      if (!contexts[tile])
+                      {
+                          contexts[tile] = EVP_MD_CTX_new();
+                          EVP_DigestInit_ex2(contexts[tile], md, NULL);
+                      }
+                      EVP_DigestUpdate(contexts[tile], image.ptr<uint8_t>(y) + first * image.elemSize(), count * image.elemSize());
+                      bool last = tiling.tilesPerRow > 1 || y + 1 == std::min(tiling.rows, (tile + 1) * tiling.rowsPerTile);
+                      if (last)
+                      {
+                          EVP_DigestFinal_ex(contexts[tile], &digests[tile * size], NULL);
+                          EVP_MD_CTX_free(contexts[tile]);
+                      }
+                  });
+
+    EVP_MD_CTX *context = EVP_MD_CTX_new();
+    unsigned char value[EVP_MAX_MD_SIZE];
+    unsigned int length;
+    EVP_DigestInit_ex2(context, md, NULL);
+    EVP_DigestUpdate(context, digests.data(), digests.size());
+    EVP_DigestFinal_ex(context, value, &length);
+    EVP_MD_CTX_free(context);
+
+    std::string output(length * 2, '0');
+    for (unsigned int i = 0; i < length; i++)
+    {
+        std::snprintf(&output[i * 2], 3, "%02x", value[i]);
+    }
+    return output;
+}
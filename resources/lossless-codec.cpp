@@ -0,0 +1,527 @@
+#include "lossless-codec.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdlib>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CODEC_X86 1
+#endif
+
+namespace
+{
+    const char *const predictorNames[PREDICTORS] = {"left", "up", "average", "paeth", "med"};
+
+    // Largest activity |d - b| + |b - c| + |e - b| of contexts 1 to LOSSLESS_CONTEXTS - 2, the last takes the rest
+    const int contextBounds[LOSSLESS_CONTEXTS - 2] = {0, 2, 5, 9, 16, 30};
+
+    /**
+     * @brief One plane of an image, rows 'step' bytes apart.
+     */
+    struct Plane
+    {
+        uint8_t *data;
+        size_t step;
+
+        uint8_t *row(int y) const { return data + y * step; }
+    };
+
+    inline uint8_t contextOf(int activity)
+    {
+        uint8_t context = 1;
+        for (int bound : contextBounds)
+        {
+            context += activity > bound;
+        }
+        return context;
+    }
+
+#ifdef CODEC_X86
+    // Contexts of columns [1, returned) of a row, 16 per iteration; activity saturates at 255, far above the bounds
+    int rowContextsSse2(const uint8_t *up, const uint8_t *above, int width, uint8_t *context)
+    {
+        auto absDiff = [](__m128i a, __m128i b)
+        { return _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a)); };
+        const __m128i zero = _mm_setzero_si128();
+        int x = 1;
+        for (; x + 16 < width; x += 16)
+        {
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(up + x));
+            __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(up + x - 1));
+            __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(up + x + 1));
+            __m128i e = _mm_loadu_si128(reinterpret_cast<const __m128i *>(above + x));
+            __m128i activity = _mm_adds_epu8(_mm_adds_epu8(absDiff(d, b), absDiff(b, c)), absDiff(e, b));
+
+            // Start from the last context and step back for every bound not exceeded (compare yields -1)
+            __m128i value = _mm_set1_epi8(LOSSLESS_CONTEXTS - 1);
+            for (int bound : contextBounds)
+            {
+                value = _mm_add_epi8(value, _mm_cmpeq_epi8(_mm_subs_epu8(activity, _mm_set1_epi8(static_cast<char>(bound))), zero));
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(context + x), value);
+        }
+        return x;
+    }
+#endif
+
+    /**
+     * @brief Contexts of a row from the two rows above it, context 0 for the first column.
+     */
+    void rowContexts(const uint8_t *up, const uint8_t *above, int width, uint8_t *context)
+    {
+        context[0] = 0;
+        int x = 1;
+#ifdef CODEC_X86
+        x = rowContextsSse2(up, above, width, context);
+#endif
+        for (; x < width - 1; x++)
+        {
+            int b = up[x];
+            context[x] = contextOf(std::abs(up[x + 1] - b) + std::abs(b - up[x - 1]) + std::abs(above[x] - b));
+        }
+        if (width > 1)
+        {
+            // The last column has no upper right neighbour, d = b
+            int b = up[width - 1];
+            context[width - 1] = contextOf(std::abs(b - up[width - 2]) + std::abs(above[width - 1] - b));
+        }
+    }
+
+    template <LosslessPredictor P>
+    inline uint8_t predict(int a, int b, int c)
+    {
+        if constexpr (P == PREDICT_LEFT)
+        {
+            return a;
+        }
+        else if constexpr (P == PREDICT_UP)
+        {
+            return b;
+        }
+        else if constexpr (P == PREDICT_AVERAGE)
+        {
+            return (a + b) >> 1;
+        }
+        else if constexpr (P == PREDICT_PAETH)
+        {
+            int pa = std::abs(b - c), pb = std::abs(a - c), pc = std::abs(a + b - 2 * c);
+            return pa <= pb && pa <= pc ? a : (pb <= pc ? b : c);
+        }
+        else
+        {
+            int low = std::min(a, b), high = std::max(a, b);
+            return c >= high ? low : (c <= low ? high : a + b - c);
+        }
+    }
+
+    /**
+     * @brief Residuals of a row below 'up', the first column predicted from above.
+     */
+    template <LosslessPredictor P>
+    void predictRow(const uint8_t *row, const uint8_t *up, int width, uint8_t *residual)
+    {
+        residual[0] = row[0] - up[0];
+        for (int x = 1; x < width; x++)
+        {
+            residual[x] = row[x] - predict<P>(row[x - 1], up[x], up[x - 1]);
+        }
+    }
+
+    template <LosslessPredictor P>
+    void reconstructRow(const uint8_t *residual, const uint8_t *up, int width, uint8_t *row)
+    {
+        row[0] = residual[0] + up[0];
+        for (int x = 1; x < width; x++)
+        {
+            row[x] = residual[x] + predict<P>(row[x - 1], up[x], up[x - 1]);
+        }
+    }
+
+    using RowFunction = void (*)(const uint8_t *, const uint8_t *, int, uint8_t *);
+    const RowFunction predictRows[PREDICTORS] = {predictRow<PREDICT_LEFT>, predictRow<PREDICT_UP>, predictRow<PREDICT_AVERAGE>,
+                                                 predictRow<PREDICT_PAETH>, predictRow<PREDICT_MED>};
+    const RowFunction reconstructRows[PREDICTORS] = {reconstructRow<PREDICT_LEFT>, reconstructRow<PREDICT_UP>, reconstructRow<PREDICT_AVERAGE>,
+                                                     reconstructRow<PREDICT_PAETH>, reconstructRow<PREDICT_MED>};
+
+    /**
+     * @brief Predictor with the smallest sum of absolute residuals over rows [start, end), start > 0.
+     */
+    LosslessPredictor choosePredictor(const Plane &plane, int width, int start, int end)
+    {
+        std::array<uint64_t, PREDICTORS> cost{};
+        for (int y = start; y < end; y++)
+        {
+            const uint8_t *row = plane.row(y), *up = plane.row(y - 1);
+            std::array<uint32_t, PREDICTORS> rowCost{};
+            for (int x = 1; x < width; x++)
+            {
+                int a = row[x - 1], b = up[x], c = up[x - 1];
+                rowCost[PREDICT_LEFT] += std::abs(static_cast<int8_t>(row[x] - a));
+                rowCost[PREDICT_UP] += std::abs(static_cast<int8_t>(row[x] - b));
+                rowCost[PREDICT_AVERAGE] += std::abs(static_cast<int8_t>(row[x] - predict<PREDICT_AVERAGE>(a, b, c)));
+                rowCost[PREDICT_PAETH] += std::abs(static_cast<int8_t>(row[x] - predict<PREDICT_PAETH>(a, b, c)));
+                rowCost[PREDICT_MED] += std::abs(static_cast<int8_t>(row[x] - predict<PREDICT_MED>(a, b, c)));
+            }
+            for (int p = 0; p < PREDICTORS; p++)
+            {
+                cost[p] += rowCost[p];
+            }
+        }
+        int best = PREDICT_MED; // Ties, e.g. a slice of one row, go to the best predictor overall
+        for (int p = 0; p < PREDICTORS; p++)
+        {
+            if (cost[p] < cost[best])
+            {
+                best = p;
+            }
+        }
+        return static_cast<LosslessPredictor>(best);
+    }
+
+    void putBigEndian(uint8_t *output, uint32_t value, int bytes)
+    {
+        for (int i = 0; i < bytes; i++)
+        {
+            output[i] = static_cast<uint8_t>(value >> (8 * (bytes - 1 - i)));
+        }
+    }
+
+    uint32_t getBigEndian(const uint8_t *input, int bytes)
+    {
+        uint32_t value = 0;
+        for (int i = 0; i < bytes; i++)
+        {
+            value = (value << 8) | input[i];
+        }
+        return value;
+    }
+
+    /**
+     * @brief Whether B - G and R - G vary less than B and R, estimated on one row per band.
+     * @details Channels that share structure (demosaiced sensors, graphics) gain from
+     *          the transform, channels with independent noise lose.
+     */
+    bool subtractGreenPays(const cv::Mat &image)
+    {
+        uint64_t plain = 0, subtracted = 0;
+        for (int y = 0; y < image.rows; y += LOSSLESS_BAND_ROWS)
+        {
+            const uint8_t *pixel = image.ptr<uint8_t>(y);
+            for (int x = 3; x < 3 * image.cols; x += 3)
+            {
+                int g = static_cast<int8_t>(pixel[x + 1] - pixel[x - 2]);
+                int b = static_cast<int8_t>(pixel[x] - pixel[x - 3]), r = static_cast<int8_t>(pixel[x + 2] - pixel[x - 1]);
+                plain += std::abs(b) + std::abs(r);
+                subtracted += std::abs(static_cast<int8_t>(b - g)) + std::abs(static_cast<int8_t>(r - g));
+            }
+        }
+        return subtracted < plain;
+    }
+
+    /**
+     * @brief Codes rows [start, end) of a plane as one slice.
+     */
+    void encodeSlice(const Plane &plane, int width, int start, int end, EntropyCoder &coder, std::vector<uint8_t> &output)
+    {
+        const size_t area = static_cast<size_t>(width) * (end - start);
+        std::vector<uint8_t> residual(area), context(area), sorted(area);
+
+        // The first row has no neighbours above, every pixel but the first is predicted from the left
+        const uint8_t *first = plane.row(start);
+        residual[0] = first[0];
+        for (int x = 1; x < width; x++)
+        {
+            residual[x] = first[x] - first[x - 1];
+        }
+
+        for (int band = start; band < end; band += LOSSLESS_BAND_ROWS)
+        {
+            int from = std::max(band, start + 1), to = std::min(end, band + LOSSLESS_BAND_ROWS);
+            LosslessPredictor predictor = choosePredictor(plane, width, from, to);
+            output.push_back(predictor);
+            for (int y = from; y < to; y++)
+            {
+                size_t offset = static_cast<size_t>(y - start) * width;
+                predictRows[predictor](plane.row(y), plane.row(y - 1), width, residual.data() + offset);
+                rowContexts(plane.row(y - 1), plane.row(std::max(y - 2, start)), width, context.data() + offset);
+            }
+        }
+
+        // Residuals grouped by context, each group coded with its own table
+        std::array<size_t, LOSSLESS_CONTEXTS> counts{}, offsets{};
+        for (uint8_t c : context)
+        {
+            counts[c]++;
+        }
+        uint8_t used = 0;
+        for (int c = 0; c < LOSSLESS_CONTEXTS; c++)
+        {
+            offsets[c] = c ? offsets[c - 1] + counts[c - 1] : 0;
+            used |= counts[c] ? 1 << c : 0;
+        }
+        for (size_t i = 0; i < area; i++)
+        {
+            sorted[offsets[context[i]]++] = residual[i];
+        }
+        output.push_back(used);
+        for (int c = 0; c < LOSSLESS_CONTEXTS; c++)
+        {
+            if (counts[c])
+            {
+                packEntropyFrame(coder, std::span<const uint8_t>(sorted.data() + offsets[c] - counts[c], counts[c]), output);
+            }
+        }
+    }
+
+    /**
+     * @brief Decodes rows [start, end) of a plane from one slice.
+     * @return false if the slice is truncated or corrupt
+     */
+    bool decodeSlice(std::span<const uint8_t> input, const Plane &plane, int width, int start, int end, int bandRows)
+    {
+        const int bands = (end - start + bandRows - 1) / bandRows;
+        const size_t area = static_cast<size_t>(width) * (end - start);
+        if (input.size() < static_cast<size_t>(bands) + 1)
+        {
+            return false;
+        }
+        const uint8_t *predictors = input.data();
+        const uint8_t used = input[bands];
+        size_t position = bands + 1;
+
+        // Every context's residuals, padded by a row so a corrupt split cannot overrun within one
+        std::array<std::vector<uint8_t>, LOSSLESS_CONTEXTS> streams;
+        std::array<const uint8_t *, LOSSLESS_CONTEXTS> next, last;
+        size_t total = 0;
+        for (int c = 0; c < LOSSLESS_CONTEXTS; c++)
+        {
+            if (used & (1 << c))
+            {
+                size_t consumed = unpackEntropyFrame(input.subspan(position), streams[c], area - total);
+                if (!consumed)
+                {
+                    return false;
+                }
+                position += consumed;
+                total += streams[c].size();
+            }
+            streams[c].resize(streams[c].size() + width);
+            next[c] = streams[c].data();
+            last[c] = streams[c].data() + streams[c].size() - width;
+        }
+        if (total != area)
+        {
+            return false;
+        }
+
+        uint8_t *first = plane.row(start);
+        first[0] = *next[0]++;
+        for (int x = 1; x < width; x++)
+        {
+            first[x] = *next[0]++ + first[x - 1];
+        }
+
+        std::vector<uint8_t> residual(width), context(width);
+        for (int band = 0; band < bands; band++)
+        {
+            if (predictors[band] >= PREDICTORS)
+            {
+                return false;
+            }
+            int from = std::max(start + band * bandRows, start + 1), to = std::min(end, start + (band + 1) * bandRows);
+            for (int y = from; y < to; y++)
+            {
+                rowContexts(plane.row(y - 1), plane.row(std::max(y - 2, start)), width, context.data());
+                for (int x = 0; x < width; x++)
+                {
+                    residual[x] = *next[context[x]]++;
+                }
+                for (int c = 0; c < LOSSLESS_CONTEXTS; c++)
+                {
+                    if (next[c] > last[c])
+                    {
+                        return false;
+                    }
+                }
+                reconstructRows[predictors[band]](residual.data(), plane.row(y - 1), width, plane.row(y));
+            }
+        }
+        return next[0] <= last[0];
+    }
+}
+
+bool encodeLossless(const cv::Mat &image, std::vector<uint8_t> &output, CoderId coder)
+{
+    if (image.empty() || (image.type() != CV_8UC1 && image.type() != CV_8UC3) || image.cols > UINT16_MAX || image.rows > UINT16_MAX ||
+        !makeEntropyCoder(coder))
+    {
+        return false;
+    }
+    const int width = image.cols, height = image.rows, channels = image.channels();
+    const int slices = (height + LOSSLESS_SLICE_ROWS - 1) / LOSSLESS_SLICE_ROWS;
+    const size_t area = static_cast<size_t>(width) * height;
+
+    // Gray images are predicted in place, BGR ones as G, B and R planes or G, B - G and R - G
+    std::vector<Plane> planes;
+    std::vector<uint8_t> transformed;
+    const bool subtractGreen = channels == 3 && subtractGreenPays(image);
+    if (channels == 1)
+    {
+        planes.push_back({const_cast<uint8_t *>(image.ptr<uint8_t>()), image.step});
+    }
+    else
+    {
+        transformed.resize(3 * area);
+        for (int c = 0; c < 3; c++)
+        {
+            planes.push_back({transformed.data() + c * area, static_cast<size_t>(width)});
+        }
+        const uint8_t mask = subtractGreen ? 0xFF : 0;
+        cv::parallel_for_(cv::Range(0, height), [&](const cv::Range &range)
+        {
+            for (int y = range.start; y < range.end; y++)
+            {
+                const uint8_t *pixel = image.ptr<uint8_t>(y);
+                uint8_t *g = planes[0].row(y), *b = planes[1].row(y), *r = planes[2].row(y);
+                for (int x = 0; x < width; x++, pixel += 3)
+                {
+                    g[x] = pixel[1];
+                    b[x] = pixel[0] - (pixel[1] & mask);
+                    r[x] = pixel[2] - (pixel[1] & mask);
+                }
+            }
+        });
+    }
+
+    // Slices are independent, coded concurrently and then laid out plane by plane
+    std::vector<std::vector<uint8_t>> coded(channels * slices);
+    cv::parallel_for_(cv::Range(0, static_cast<int>(coded.size())), [&](const cv::Range &range)
+    {
+        std::unique_ptr<EntropyCoder> entropy = makeEntropyCoder(coder);
+        for (int i = range.start; i < range.end; i++)
+        {
+            int start = (i % slices) * LOSSLESS_SLICE_ROWS;
+            encodeSlice(planes[i / slices], width, start, std::min(height, start + LOSSLESS_SLICE_ROWS), *entropy, coded[i]);
+        }
+    }, static_cast<double>(coded.size()));
+
+    size_t header = output.size();
+    output.resize(header + LOSSLESS_HEADER + 4 * coded.size());
+    uint8_t *fields = output.data() + header;
+    putBigEndian(fields, LOSSLESS_MAGIC, 4);
+    fields[4] = static_cast<uint8_t>(channels);
+    fields[5] = subtractGreen ? LOSSLESS_SUBTRACT_GREEN : 0;
+    putBigEndian(fields + 6, width, 2);
+    putBigEndian(fields + 8, height, 2);
+    fields[10] = LOSSLESS_BAND_ROWS;
+    putBigEndian(fields + 11, LOSSLESS_SLICE_ROWS, 2);
+    for (size_t i = 0; i < coded.size(); i++)
+    {
+        putBigEndian(fields + LOSSLESS_HEADER + 4 * i, static_cast<uint32_t>(coded[i].size()), 4);
+    }
+    for (const std::vector<uint8_t> &slice : coded)
+    {
+        output.insert(output.end(), slice.begin(), slice.end());
+    }
+    return true;
+}
+
+bool decodeLossless(std::span<const uint8_t> input, cv::Mat &image)
+{
+    if (!isLosslessImage(input) || input.size() < LOSSLESS_HEADER)
+    {
+        return false;
+    }
+    const int channels = input[4], flags = input[5];
+    const int width = getBigEndian(&input[6], 2), height = getBigEndian(&input[8], 2);
+    const int bandRows = input[10], sliceRows = getBigEndian(&input[11], 2);
+    if ((channels != 1 && channels != 3) || (flags & ~LOSSLESS_SUBTRACT_GREEN) || !width || !height || !bandRows ||
+        !sliceRows || sliceRows % bandRows)
+    {
+        return false;
+    }
+    const int slices = (height + sliceRows - 1) / sliceRows;
+    const size_t area = static_cast<size_t>(width) * height;
+
+    // Slice sizes, then where each slice starts
+    const size_t count = static_cast<size_t>(channels) * slices;
+    if (input.size() - LOSSLESS_HEADER < 4 * count)
+    {
+        return false;
+    }
+    std::vector<size_t> offsets(count + 1, LOSSLESS_HEADER + 4 * count);
+    for (size_t i = 0; i < count; i++)
+    {
+        offsets[i + 1] = offsets[i] + getBigEndian(&input[LOSSLESS_HEADER + 4 * i], 4);
+    }
+    if (offsets[count] > input.size())
+    {
+        return false;
+    }
+
+    image.create(height, width, CV_8UC(channels));
+    std::vector<Plane> planes;
+    std::vector<uint8_t> transformed;
+    if (channels == 1)
+    {
+        planes.push_back({image.ptr<uint8_t>(), image.step});
+    }
+    else
+    {
+        transformed.resize(3 * area);
+        for (int c = 0; c < 3; c++)
+        {
+            planes.push_back({transformed.data() + c * area, static_cast<size_t>(width)});
+        }
+    }
+
+    std::atomic<bool> valid(true);
+    cv::parallel_for_(cv::Range(0, static_cast<int>(count)), [&](const cv::Range &range)
+    {
+        for (int i = range.start; i < range.end && valid; i++)
+        {
+            int start = (i % slices) * sliceRows;
+            if (!decodeSlice(input.subspan(offsets[i], offsets[i + 1] - offsets[i]), planes[i / slices], width, start,
+                             std::min(height, start + sliceRows), bandRows))
+            {
+                valid = false;
+            }
+        }
+    }, static_cast<double>(count));
+    if (!valid)
+    {
+        return false;
+    }
+
+    if (channels == 3)
+    {
+        const uint8_t mask = (flags & LOSSLESS_SUBTRACT_GREEN) ? 0xFF : 0;
+        cv::parallel_for_(cv::Range(0, height), [&](const cv::Range &range)
+        {
+            for (int y = range.start; y < range.end; y++)
+            {
+                uint8_t *pixel = image.ptr<uint8_t>(y);
+                const uint8_t *g = planes[0].row(y), *b = planes[1].row(y), *r = planes[2].row(y);
+                for (int x = 0; x < width; x++, pixel += 3)
+                {
+                    pixel[0] = b[x] + (g[x] & mask);
+                    pixel[1] = g[x];
+                    pixel[2] = r[x] + (g[x] & mask);
+                }
+            }
+        });
+    }
+    return true;
+}
+
+bool isLosslessImage(std::span<const uint8_t> input)
+{
+    return input.size() >= 4 && getBigEndian(input.data(), 4) == LOSSLESS_MAGIC;
+}
+
+const char *predictorName(LosslessPredictor predictor)
+{
+    return predictor < PREDICTORS ? predictorNames[predictor] : "unknown";
+}
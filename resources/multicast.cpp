@@ -0,0 +1,511 @@
+#include "multicast.h"
+
+namespace
+{
+    // Payload bytes carried by data chunk 'index' of a frame of 'size' bytes
+    size_t chunkLength(size_t size, size_t index)
+    {
+        size_t offset = index * MCAST_CHUNK_PAYLOAD;
+        return offset >= size ? 0 : std::min<size_t>(MCAST_CHUNK_PAYLOAD, size - offset);
+    }
+
+    std::vector<uint8_t> buildDatagram(uint8_t kind, uint8_t fecGroup, uint8_t color, uint32_t frameId, uint16_t index,
+                                       uint16_t count, uint32_t frameSize, const uint8_t *payload, size_t length)
+    {
+        ChunkHeader header;
+        header.magic = htonl(MCAST_MAGIC);
+        header.version = WIRE_VERSION;
+        header.kind = kind;
+        header.fecGroup = fecGroup;
+        header.color = color;
+        header.frameId = htonl(frameId);
+        header.index = htons(index);
+        header.count = htons(count);
+        header.frameSize = htonl(frameSize);
+        header.length = htons(length);
+        header.reserved = 0;
+        header.checksum = htonl(crc32(payload, length));
+
+        std::vector<uint8_t> datagram(MCAST_HEADER_SIZE + length);
+        std::memcpy(datagram.data(), &header, MCAST_HEADER_SIZE);
+        if (length)
+        {
+            std::memcpy(datagram.data() + MCAST_HEADER_SIZE, payload, length);
+        }
+        return datagram;
+    }
+
+    std::vector<uint8_t> buildDataChunk(uint32_t frameId, uint8_t color, const uint8_t *data, size_t size, uint16_t index, uint8_t fecGroup)
+    {
+        return buildDatagram(CHUNK_DATA, fecGroup, color, frameId, index, chunkCount(size), size,
+                             data + index * MCAST_CHUNK_PAYLOAD, chunkLength(size, index));
+    }
+}
+
+size_t chunkCount(size_t size)
+{
+    return size ? (size + MCAST_CHUNK_PAYLOAD - 1) / MCAST_CHUNK_PAYLOAD : 1;
+}
+
+std::vector<std::vector<uint8_t>> chunkFrame(uint32_t frameId, uint8_t color, const uint8_t *data, size_t size, uint8_t fecGroup)
+{
+    std::vector<std::vector<uint8_t>> datagrams;
+    size_t count = chunkCount(size);
+    if (count > UINT16_MAX || size > UINT32_MAX)
+    {
+        return datagrams;
+    }
+
+    size_t groupSize = fecGroup ? fecGroup : count;
+    for (size_t first = 0; first < count; first += groupSize)
+    {
+        size_t last = std::min(first + groupSize, count);
+        for (size_t index = first; index < last; index++)
+        {
+            datagrams.push_back(buildDataChunk(frameId, color, data, size, index, fecGroup));
+        }
+        if (!fecGroup)
+        {
+            continue;
+        }
+
+        // Parity is as long as the group's first (longest) chunk, shorter chunks are zero padded
+        std::vector<uint8_t> parity(chunkLength(size, first), 0);
+        for (size_t index = first; index < last; index++)
+        {
+            const uint8_t *chunk = data + index * MCAST_CHUNK_PAYLOAD;
+            for (size_t i = 0, n = chunkLength(size, index); i < n; i++)
+            {
+                parity[i] ^= chunk[i];
+            }
+        }
+        datagrams.push_back(buildDatagram(CHUNK_PARITY, fecGroup, color, frameId, first / groupSize, count, size,
+                                          parity.data(), parity.size()));
+    }
+    return datagrams;
+}
+
+/**
+ * @brief Opens a UDP socket sending to 'group':'port'.
+ * @param group IPv4 multicast group (224.0.0.0/4)
+ * @param port Destination port
+ * @param fecGroup Data chunks per parity chunk, 0 disables FEC
+ * @param ttl Multicast hops, 1 keeps traffic on the local segment
+ */
+MulticastSender::MulticastSender(const std::string &group, int port, uint8_t fecGroup, int ttl)
+    : sock(-1), group(group), port(port), fecGroup(fecGroup), dest{}, nextId(1), stats{}
+{
+    this->dest.sin_family = AF_INET;
+    this->dest.sin_port = htons(port);
+    if (inet_pton(AF_INET, group.c_str(), &this->dest.sin_addr) != 1 || !IN_MULTICAST(ntohl(this->dest.sin_addr.s_addr)))
+    {
+        throw std::runtime_error("Multicast::ERROR: " + group + " is not an IPv4 multicast group");
+    }
+
+    this->sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (this->sock < 0)
+    {
+        throw std::runtime_error("Multicast::ERROR: Could not create UDP socket");
+    }
+
+    // Loopback on so receivers on the server host get the stream too
+    unsigned char hops = ttl;
+    unsigned char loop = 1;
+    setsockopt(this->sock, IPPROTO_IP, IP_MULTICAST_TTL, &hops, sizeof(hops));
+    setsockopt(this->sock, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+}
+
+MulticastSender::~MulticastSender()
+{
+    if (this->sock >= 0)
+    {
+        close(this->sock);
+    }
+}
+
+/**
+ * @brief Multicasts one encoded frame and retains it for retransmission.
+ * @param color Filter which produced the frame
+ * @param frame Encoded frame, shared with the TCP path rather than copied
+ * @return Identifier announced to receivers in MSG_MCAST_INDEX
+ */
+uint32_t MulticastSender::send(uint8_t color, std::shared_ptr<const std::vector<uint8_t>> frame)
+{
+    uint32_t frameId;
+    {
+        std::lock_guard<std::mutex> lock(this->sendMutex);
+        frameId = this->nextId++;
+        this->retained[frameId] = Retained{color, frame};
+        while (this->retained.size() > MCAST_RETAIN)
+        {
+            this->retained.erase(this->retained.begin());
+        }
+    }
+
+    uint64_t sent(0);
+    uint64_t parity(0);
+    for (const auto &datagram : chunkFrame(frameId, color, frame->data(), frame->size(), this->fecGroup))
+    {
+        if (sendDatagram(datagram))
+        {
+            sent++;
+            parity += datagram[offsetof(ChunkHeader, kind)] == CHUNK_PARITY;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(this->sendMutex);
+    this->stats.framesSent++;
+    this->stats.datagramsSent += sent;
+    this->stats.parityDatagrams += parity;
+    return frameId;
+}
+
+/**
+ * @brief Re-multicasts data chunks a receiver reported missing.
+ * @return Number of chunks resent, 0 if the frame left the retain window
+ */
+size_t MulticastSender::retransmit(uint32_t frameId, const std::vector<uint16_t> &chunks)
+{
+    Retained frame;
+    {
+        std::lock_guard<std::mutex> lock(this->sendMutex);
+        auto found = this->retained.find(frameId);
+        if (found == this->retained.end())
+        {
+            return 0;
+        }
+        frame = found->second;
+    }
+
+    size_t count = chunkCount(frame.data->size());
+    size_t resent(0);
+    for (uint16_t index : chunks)
+    {
+        if (index < count && sendDatagram(buildDataChunk(frameId, frame.color, frame.data->data(), frame.data->size(), index, this->fecGroup)))
+        {
+            resent++;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(this->sendMutex);
+    this->stats.datagramsSent += resent;
+    this->stats.retransmitted += resent;
+    return resent;
+}
+
+McastStats MulticastSender::getStats()
+{
+    std::lock_guard<std::mutex> lock(this->sendMutex);
+    return this->stats;
+}
+
+bool MulticastSender::sendDatagram(const std::vector<uint8_t> &datagram)
+{
+    while (true)
+    {
+        ssize_t n = sendto(this->sock, datagram.data(), datagram.size(), 0, reinterpret_cast<const sockaddr *>(&this->dest), sizeof(this->dest));
+        if (n >= 0)
+        {
+            return true;
+        }
+        if (errno != EINTR)
+        {
+            // Dropped locally (e.g. ENOBUFS), recovered like any network loss
+            return false;
+        }
+    }
+}
+
+/**
+ * @brief Registers a frame announced over TCP, so missing() covers it even if every chunk was lost.
+ */
+void FrameAssembler::expect(uint32_t frameId, uint32_t frameSize, uint8_t color)
+{
+    track(frameId, frameSize, color);
+}
+
+/**
+ * @brief Validates one datagram and stores its payload.
+ * @return FRAME_COMPLETE when the frame it belongs to has every data chunk
+ */
+FrameAssembler::Result FrameAssembler::accept(const uint8_t *datagram, size_t size)
+{
+    ChunkHeader header;
+    if (size < MCAST_HEADER_SIZE)
+    {
+        return CHUNK_REJECTED;
+    }
+    std::memcpy(&header, datagram, MCAST_HEADER_SIZE);
+    uint32_t frameId = ntohl(header.frameId);
+    uint16_t index = ntohs(header.index);
+    uint16_t count = ntohs(header.count);
+    uint32_t frameSize = ntohl(header.frameSize);
+    uint16_t length = ntohs(header.length);
+    const uint8_t *payload = datagram + MCAST_HEADER_SIZE;
+
+    if (ntohl(header.magic) != MCAST_MAGIC || header.version != WIRE_VERSION ||
+        size != MCAST_HEADER_SIZE + static_cast<size_t>(length) || chunkCount(frameSize) != count)
+    {
+        return CHUNK_REJECTED;
+    }
+    if (crc32(payload, length) != ntohl(header.checksum))
+    {
+        this->corrupt++;
+        return CHUNK_REJECTED;
+    }
+
+    uint16_t group;
+    if (header.kind == CHUNK_DATA)
+    {
+        if (index >= count || length != chunkLength(frameSize, index))
+        {
+            return CHUNK_REJECTED;
+        }
+        group = header.fecGroup ? index / header.fecGroup : 0;
+    }
+    else if (header.kind == CHUNK_PARITY && header.fecGroup)
+    {
+        size_t first = static_cast<size_t>(index) * header.fecGroup;
+        if (first >= count || length != chunkLength(frameSize, first))
+        {
+            return CHUNK_REJECTED;
+        }
+        group = index;
+    }
+    else
+    {
+        return CHUNK_REJECTED;
+    }
+
+    Partial &frame = track(frameId, frameSize, header.color);
+    if (frame.frameSize != frameSize || frame.received == frame.count)
+    {
+        return frame.frameSize == frameSize ? CHUNK_ACCEPTED : CHUNK_REJECTED;
+    }
+    frame.fecGroup = header.fecGroup;
+
+    if (header.kind == CHUNK_DATA)
+    {
+        if (frame.have[index])
+        {
+            return CHUNK_ACCEPTED;
+        }
+        std::memcpy(frame.data.data() + static_cast<size_t>(index) * MCAST_CHUNK_PAYLOAD, payload, length);
+        frame.have[index] = true;
+        frame.received++;
+    }
+    else
+    {
+        frame.parity.emplace(group, std::vector<uint8_t>(payload, payload + length));
+    }
+
+    repair(frame, group);
+    return frame.received == frame.count ? FRAME_COMPLETE : CHUNK_ACCEPTED;
+}
+
+bool FrameAssembler::isComplete(uint32_t frameId) const
+{
+    auto found = this->partials.find(frameId);
+    return found != this->partials.end() && found->second.received == found->second.count;
+}
+
+/**
+ * @brief Data chunks of a tracked frame not yet received or repaired.
+ */
+std::vector<uint16_t> FrameAssembler::missing(uint32_t frameId) const
+{
+    std::vector<uint16_t> holes;
+    auto found = this->partials.find(frameId);
+    if (found == this->partials.end())
+    {
+        return holes;
+    }
+    for (size_t index = 0; index < found->second.count; index++)
+    {
+        if (!found->second.have[index])
+        {
+            holes.push_back(index);
+        }
+    }
+    return holes;
+}
+
+/**
+ * @brief Moves a completed frame out of the assembler.
+ * @return false if the frame is unknown or still incomplete
+ */
+bool FrameAssembler::takeFrame(uint32_t frameId, std::vector<uint8_t> &out)
+{
+    auto found = this->partials.find(frameId);
+    if (found == this->partials.end() || found->second.received != found->second.count)
+    {
+        return false;
+    }
+    out = std::move(found->second.data);
+    this->partials.erase(found);
+    return true;
+}
+
+FrameAssembler::Partial &FrameAssembler::track(uint32_t frameId, uint32_t frameSize, uint8_t color)
+{
+    auto found = this->partials.find(frameId);
+    if (found != this->partials.end())
+    {
+        return found->second;
+    }
+
+    // Bound memory when frames are never completed or taken
+    if (this->partials.size() >= MCAST_MAX_PARTIAL)
+    {
+        this->partials.erase(this->partials.begin());
+    }
+
+    Partial &frame = this->partials[frameId];
+    frame.frameSize = frameSize;
+    frame.count = chunkCount(frameSize);
+    frame.color = color;
+    frame.fecGroup = 0;
+    frame.received = 0;
+    frame.data.resize(frameSize);
+    frame.have.assign(frame.count, false);
+    return frame;
+}
+
+/**
+ * @brief Rebuilds the single missing data chunk of an FEC group from its parity.
+ * @return true if a chunk was repaired
+ */
+bool FrameAssembler::repair(Partial &frame, uint16_t group)
+{
+    if (!frame.fecGroup)
+    {
+        return false;
+    }
+    auto parity = frame.parity.find(group);
+    if (parity == frame.parity.end())
+    {
+        return false;
+    }
+
+    size_t first = static_cast<size_t>(group) * frame.fecGroup;
+    size_t last = std::min<size_t>(first + frame.fecGroup, frame.count);
+    size_t hole = last;
+    for (size_t index = first; index < last; index++)
+    {
+        if (frame.have[index])
+        {
+            continue;
+        }
+        if (hole != last)
+        {
+            return false; // More than one loss, needs a NACK
+        }
+        hole = index;
+    }
+    if (hole == last)
+    {
+        return false;
+    }
+
+    std::vector<uint8_t> rebuilt(parity->second);
+    for (size_t index = first; index < last; index++)
+    {
+        if (index == hole)
+        {
+            continue;
+        }
+        const uint8_t *chunk = frame.data.data() + index * MCAST_CHUNK_PAYLOAD;
+        for (size_t i = 0, n = chunkLength(frame.frameSize, index); i < n; i++)
+        {
+            rebuilt[i] ^= chunk[i];
+        }
+    }
+    std::memcpy(frame.data.data() + hole * MCAST_CHUNK_PAYLOAD, rebuilt.data(), chunkLength(frame.frameSize, hole));
+    frame.have[hole] = true;
+    frame.received++;
+    this->repaired++;
+    return true;
+}
+
+std::vector<uint8_t> buildMcastIndex(const std::vector<McastFrameRef> &refs)
+{
+    std::vector<uint8_t> payload(sizeof(uint16_t) + refs.size() * sizeof(McastFrameRef));
+    uint16_t count = htons(refs.size());
+    std::memcpy(payload.data(), &count, sizeof(count));
+
+    uint8_t *out = payload.data() + sizeof(uint16_t);
+    for (const McastFrameRef &ref : refs)
+    {
+        McastFrameRef wire{htonl(ref.frameId), htonl(ref.frameSize), ref.color, ref.planes, {0, 0}};
+        std::memcpy(out, &wire, sizeof(wire));
+        out += sizeof(wire);
+    }
+    return payload;
+}
+
+bool readMcastIndex(const uint8_t *data, size_t size, std::vector<McastFrameRef> &refs)
+{
+    uint16_t count;
+    if (size < sizeof(count))
+    {
+        return false;
+    }
+    std::memcpy(&count, data, sizeof(count));
+    count = ntohs(count);
+    if (size != sizeof(uint16_t) + count * sizeof(McastFrameRef))
+    {
+        return false;
+    }
+
+    refs.clear();
+    for (size_t i = 0; i < count; i++)
+    {
+        McastFrameRef ref;
+        std::memcpy(&ref, data + sizeof(uint16_t) + i * sizeof(McastFrameRef), sizeof(ref));
+        ref.frameId = ntohl(ref.frameId);
+        ref.frameSize = ntohl(ref.frameSize);
+        refs.push_back(ref);
+    }
+    return true;
+}
+
+std::vector<uint8_t> buildNack(uint32_t frameId, const std::vector<uint16_t> &chunks)
+{
+    std::vector<uint8_t> payload;
+    uint32_t id = htonl(frameId);
+    uint16_t count = htons(chunks.size());
+    payload.insert(payload.end(), reinterpret_cast<uint8_t *>(&id), reinterpret_cast<uint8_t *>(&id) + sizeof(id));
+    payload.insert(payload.end(), reinterpret_cast<uint8_t *>(&count), reinterpret_cast<uint8_t *>(&count) + sizeof(count));
+    for (uint16_t chunk : chunks)
+    {
+        uint16_t index = htons(chunk);
+        payload.insert(payload.end(), reinterpret_cast<uint8_t *>(&index), reinterpret_cast<uint8_t *>(&index) + sizeof(index));
+    }
+    return payload;
+}
+
+bool readNack(const uint8_t *data, size_t size, uint32_t &frameId, std::vector<uint16_t> &chunks)
+{
+    uint16_t count;
+    if (size < sizeof(frameId) + sizeof(count))
+    {
+        return false;
+    }
+    std::memcpy(&frameId, data, sizeof(frameId));
+    std::memcpy(&count, data + sizeof(frameId), sizeof(count));
+    frameId = ntohl(frameId);
+    count = ntohs(count);
+    if (size != sizeof(frameId) + sizeof(count) + count * sizeof(uint16_t))
+    {
+        return false;
+    }
+
+    chunks.clear();
+    for (size_t i = 0; i < count; i++)
+    {
+        uint16_t index;
+        std::memcpy(&index, data + sizeof(frameId) + sizeof(count) + i * sizeof(uint16_t), sizeof(index));
+        chunks.push_back(ntohs(index));
+    }
+    return true;
+}
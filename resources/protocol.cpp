@@ -0,0 +1,217 @@
+#include "protocol.h"
+#include <cmath>
+#include <algorithm>
+
+namespace
+{
+    // Slicing-by-8 tables for the reflected IEEE polynomial, built once
+    struct CrcTables
+    {
+        uint32_t table[8][256];
+
+        CrcTables()
+        {
+            for (uint32_t i = 0; i < 256; i++)
+            {
+                uint32_t crc = i;
+                for (int bit = 0; bit < 8; bit++)
+                {
+                    crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+                }
+                table[0][i] = crc;
+            }
+            for (uint32_t i = 0; i < 256; i++)
+            {
+                for (int slice = 1; slice < 8; slice++)
+                {
+                    table[slice][i] = (table[slice - 1][i] >> 8) ^ table[0][table[slice - 1][i] & 0xFF];
+                }
+            }
+        }
+    };
+
+    const CrcTables crcTables;
+}
+
+uint32_t crc32(const uint8_t *data, size_t size, uint32_t crc)
+{
+    const auto &t = crcTables.table;
+    crc = ~crc;
+
+    // Eight bytes per step
+    while (size >= 8)
+    {
+        uint32_t lo;
+        uint32_t hi;
+        std::memcpy(&lo, data, 4);
+        std::memcpy(&hi, data + 4, 4);
+        lo ^= crc;
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+              t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+        data += 8;
+        size -= 8;
+    }
+    while (size--)
+    {
+        crc = (crc >> 8) ^ t[0][(crc ^ *data++) & 0xFF];
+    }
+    return ~crc;
+}
+
+bool isWireMessage(const uint8_t *data, size_t size)
+{
+    uint32_t magic;
+    if (size < sizeof(magic))
+    {
+        return false;
+    }
+    std::memcpy(&magic, data, sizeof(magic));
+    return ntohl(magic) == WIRE_MAGIC;
+}
+
+void writeHeader(uint8_t *out, uint8_t type, uint16_t flags, uint32_t seq, uint32_t length, uint32_t checksum)
+{
+    WireHeader header;
+    header.magic = htonl(WIRE_MAGIC);
+    header.version = WIRE_VERSION;
+    header.type = type;
+    header.flags = htons(flags);
+    header.seq = htonl(seq);
+    header.length = htonl(length);
+    header.checksum = htonl(checksum);
+    std::memcpy(out, &header, WIRE_HEADER_SIZE);
+}
+
+WireStatus decodeHeader(const uint8_t *data, size_t size, WireHeader &header, uint32_t maxPayload)
+{
+    if (size < WIRE_HEADER_SIZE)
+    {
+        return WIRE_INCOMPLETE;
+    }
+
+    std::memcpy(&header, data, WIRE_HEADER_SIZE);
+    header.magic = ntohl(header.magic);
+    header.flags = ntohs(header.flags);
+    header.seq = ntohl(header.seq);
+    header.length = ntohl(header.length);
+    header.checksum = ntohl(header.checksum);
+
+    if (header.magic != WIRE_MAGIC)
+    {
+        return WIRE_BAD_MAGIC;
+    }
+    if (header.version != WIRE_VERSION)
+    {
+        return WIRE_BAD_VERSION;
+    }
+    if (header.length > maxPayload)
+    {
+        return WIRE_TOO_LARGE;
+    }
+    return WIRE_OK;
+}
+
+WireStatus parseHeader(const uint8_t *data, size_t size, WireHeader &header, uint32_t maxPayload)
+{
+    WireStatus status = decodeHeader(data, size, header, maxPayload);
+    if (status != WIRE_OK)
+    {
+        return status;
+    }
+    if (size < WIRE_HEADER_SIZE + static_cast<size_t>(header.length))
+    {
+        return WIRE_INCOMPLETE;
+    }
+    if (crc32(data + WIRE_HEADER_SIZE, header.length) != header.checksum)
+    {
+        return WIRE_BAD_CHECKSUM;
+    }
+    return WIRE_OK;
+}
+
+std::vector<uint8_t> buildMessage(uint8_t type, uint16_t flags, uint32_t seq, const uint8_t *payload, size_t length)
+{
+    std::vector<uint8_t> message(WIRE_HEADER_SIZE + length);
+    writeHeader(message.data(), type, flags, seq, length, crc32(payload, length));
+    if (length)
+    {
+        std::memcpy(message.data() + WIRE_HEADER_SIZE, payload, length);
+    }
+    return message;
+}
+
+FrameInfo makeFrameInfo(uint16_t index, uint16_t count, uint8_t color, uint8_t encoding, uint8_t planes)
+{
+    return FrameInfo{htons(index), htons(count), color, encoding, planes, 0};
+}
+
+FrameInfo readFrameInfo(const uint8_t *data)
+{
+    FrameInfo info;
+    std::memcpy(&info, data, sizeof(FrameInfo));
+    info.index = ntohs(info.index);
+    info.count = ntohs(info.count);
+    return info;
+}
+
+RegionInfo makeRegionInfo(uint16_t x, uint16_t y, uint16_t width, uint16_t height, uint16_t scale,
+                          uint16_t captureWidth, uint16_t captureHeight)
+{
+    return RegionInfo{htons(x), htons(y), htons(width), htons(height), htons(scale), htons(captureWidth), htons(captureHeight)};
+}
+
+RegionInfo makeRegionInfo(const RegionInfo &region)
+{
+    return makeRegionInfo(region.x, region.y, region.width, region.height, region.scale, region.captureWidth, region.captureHeight);
+}
+
+RegionInfo readRegionInfo(const uint8_t *data)
+{
+    RegionInfo region;
+    std::memcpy(&region, data, sizeof(RegionInfo));
+    return RegionInfo{ntohs(region.x), ntohs(region.y), ntohs(region.width), ntohs(region.height), ntohs(region.scale),
+                      ntohs(region.captureWidth), ntohs(region.captureHeight)};
+}
+
+StreamStatus makeStreamStatus(uint32_t delivered, uint32_t dropped)
+{
+    return StreamStatus{htonl(delivered), htonl(dropped)};
+}
+
+StreamStatus readStreamStatus(const uint8_t *data)
+{
+    StreamStatus status;
+    std::memcpy(&status, data, sizeof(StreamStatus));
+    status.delivered = ntohl(status.delivered);
+    status.dropped = ntohl(status.dropped);
+    return status;
+}
+
+void appendColorMatrix(std::vector<uint8_t> &out, const ColorMatrix &matrix)
+{
+    for (int row = 0; row < 3; row++)
+    {
+        for (int col = 0; col < 4; col++)
+        {
+            double value = std::clamp(matrix.m[row][col] * 65536.0, static_cast<double>(INT32_MIN), static_cast<double>(INT32_MAX));
+            uint32_t fixed = htonl(static_cast<uint32_t>(static_cast<int32_t>(std::lround(value))));
+            const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&fixed);
+            out.insert(out.end(), bytes, bytes + sizeof(fixed));
+        }
+    }
+}
+
+ColorMatrix readColorMatrix(const uint8_t *data)
+{
+    ColorMatrix matrix;
+    for (int row = 0; row < 3; row++)
+    {
+        for (int col = 0; col < 4; col++)
+        {
+            uint32_t fixed;
+            std::memcpy(&fixed, data + (row * 4 + col) * sizeof(fixed), sizeof(fixed));
+            matrix.m[row][col] = static_cast<int32_t>(ntohl(fixed)) / 65536.0f;
+        }
+    }
+    return matrix;
+}
@@ -0,0 +1,643 @@
+#include "reactor.h"
+
+OutChunk makeChunk(std::vector<uint8_t> &&bytes)
+{
+    auto owner = std::make_shared<const std::vector<uint8_t>>(std::move(bytes));
+    return OutChunk{owner, owner->data(), owner->size()};
+}
+
+bool setNonBlocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0)
+    {
+        return false;
+    }
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+/**
+ * @brief Resets the socket on close() when MSG_ZEROCOPY sends are unacknowledged.
+ * @details A plain close() lets the kernel keep transmitting from the pinned
+ *          pages, which go back to the BufferPool as soon as zcPending is cleared.
+ *          SO_LINGER 0 makes close() abortive, discarding the unsent data instead.
+ */
+static void abortPendingZeroCopy(const Connection &conn)
+{
+    if (!conn.zcPending.empty())
+    {
+        linger abort{1, 0};
+        setsockopt(conn.fd, SOL_SOCKET, SO_LINGER, &abort, sizeof(abort));
+    }
+}
+
+/**
+ * @brief Creates the epoll instance and wakeup eventfd for every IO thread.
+ * @param handler Protocol callbacks, must outlive the reactor
+ * @param ioThreads Number of IO threads, at least one
+ */
+Reactor::Reactor(ConnectionHandler &handler, size_t ioThreads)
+    : handler(handler), running(false), connectionCount(0), listenFd(-1), idleTimeout(0), inputLimit(REACTOR_INPUT_LIMIT), sendCalls(0), bytesSent(0), zerocopyCalls(0), zerocopyCopied(0)
+{
+    if (ioThreads == 0)
+    {
+        ioThreads = 1;
+    }
+
+    for (size_t i = 0; i < ioThreads; i++)
+    {
+        auto loop = std::make_unique<EventLoop>();
+        loop->epollFd = epoll_create1(EPOLL_CLOEXEC);
+        loop->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (loop->epollFd < 0 || loop->wakeFd < 0)
+        {
+            throw std::runtime_error("Reactor::ERROR: Could not create epoll instance");
+        }
+
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = loop->wakeFd;
+        epoll_ctl(loop->epollFd, EPOLL_CTL_ADD, loop->wakeFd, &ev);
+        this->loops.push_back(std::move(loop));
+    }
+}
+
+/**
+ * @brief Stops the IO threads and closes every remaining connection.
+ */
+Reactor::~Reactor()
+{
+    stop();
+    for (auto &loop : this->loops)
+    {
+        if (loop->thread.joinable())
+        {
+            loop->thread.join();
+        }
+        for (auto &entry : loop->connections)
+        {
+            abortPendingZeroCopy(*entry.second);
+            ::close(entry.first);
+        }
+        ::close(loop->wakeFd);
+        ::close(loop->epollFd);
+    }
+}
+
+/**
+ * @brief Registers the listening socket with every IO thread and runs loop 0 on the caller.
+ * @param listenFd A bound socket which is already in the listening state
+ */
+void Reactor::run(int listenFd)
+{
+    this->listenFd = listenFd;
+    setNonBlocking(listenFd);
+
+    // EPOLLEXCLUSIVE: only one IO thread is woken per incoming connection
+    for (auto &loop : this->loops)
+    {
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+        ev.data.fd = listenFd;
+        if (epoll_ctl(loop->epollFd, EPOLL_CTL_ADD, listenFd, &ev) < 0)
+        {
+            throw std::runtime_error("Reactor::ERROR: Could not register listening socket");
+        }
+    }
+
+    this->running.store(true);
+    for (size_t i = 1; i < this->loops.size(); i++)
+    {
+        this->loops.at(i)->thread = std::thread(&Reactor::loopBody, this, i);
+    }
+    loopBody(0);
+
+    for (size_t i = 1; i < this->loops.size(); i++)
+    {
+        if (this->loops.at(i)->thread.joinable())
+        {
+            this->loops.at(i)->thread.join();
+        }
+    }
+}
+
+/**
+ * @brief Asks every IO thread to exit after its current iteration.
+ */
+void Reactor::stop()
+{
+    this->running.store(false);
+    for (auto &loop : this->loops)
+    {
+        uint64_t one = 1;
+        [[maybe_unused]] ssize_t res = write(loop->wakeFd, &one, sizeof(one));
+    }
+}
+
+/**
+ * @brief Close connections which have neither read nor written for 'timeout'.
+ * @details Must be set before run(). Connections the handler reports as busy
+ *          (canExpire() false) are never reaped.
+ */
+void Reactor::setIdleTimeout(std::chrono::milliseconds timeout)
+{
+    this->idleTimeout = timeout;
+}
+
+/**
+ * @brief Bound the bytes a connection may have received but not consumed.
+ * @details Must be set before run(). Should hold the largest message the
+ *          handler accepts; a connection the handler cannot bring back under
+ *          the limit is closed.
+ */
+void Reactor::setInputLimit(size_t bytes)
+{
+    this->inputLimit = bytes;
+}
+
+/**
+ * @brief Hands a task to the connection's IO thread, e.g. a finished compute result.
+ */
+void Reactor::post(const std::shared_ptr<Connection> &conn, std::function<void()> task)
+{
+    EventLoop &loop = *this->loops.at(conn->loop);
+    {
+        std::lock_guard<std::mutex> lock(loop.postMutex);
+        loop.posted.push_back([conn, task = std::move(task)]()
+                              {
+            if( ! conn->closed ) task(); });
+    }
+    uint64_t one = 1;
+    [[maybe_unused]] ssize_t res = write(loop.wakeFd, &one, sizeof(one));
+}
+
+/**
+ * @brief Appends bytes to the connection's output queue and writes as much as the socket accepts.
+ */
+void Reactor::queue(const std::shared_ptr<Connection> &conn, OutChunk chunk)
+{
+    if (conn->closed || chunk.size == 0)
+    {
+        return;
+    }
+    bool idle = conn->outq.empty();
+    conn->outq.push_back(std::move(chunk));
+    if (idle)
+    {
+        flush(conn);
+    }
+}
+
+/**
+ * @brief Appends several chunks and writes them with a single gathered sendmsg().
+ */
+void Reactor::queue(const std::shared_ptr<Connection> &conn, std::vector<OutChunk> chunks)
+{
+    if (conn->closed)
+    {
+        return;
+    }
+    bool idle = conn->outq.empty();
+    for (auto &chunk : chunks)
+    {
+        if (chunk.size)
+        {
+            conn->outq.push_back(std::move(chunk));
+        }
+    }
+    if (idle && !conn->outq.empty())
+    {
+        flush(conn);
+    }
+}
+
+/**
+ * @brief Closes the connection once everything queued so far has been written
+ *        and the kernel has released every zero-copy buffer.
+ */
+void Reactor::closeWhenDrained(const std::shared_ptr<Connection> &conn)
+{
+    if (conn->closed)
+    {
+        return;
+    }
+    conn->closing = true;
+    if (conn->outq.empty() && conn->zcPending.empty())
+    {
+        close(conn);
+    }
+}
+
+/**
+ * @brief Snapshot of the send path counters across all IO threads.
+ */
+ReactorStats Reactor::getStats() const
+{
+    return ReactorStats{this->sendCalls.load(), this->bytesSent.load(), this->zerocopyCalls.load(), this->zerocopyCopied.load()};
+}
+
+/**
+ * @brief Immediately deregisters and closes the connection.
+ * @details Zero-copy batches already completed are released first; if any are
+ *          still in flight the connection is reset (see abortPendingZeroCopy).
+ */
+void Reactor::close(const std::shared_ptr<Connection> &conn)
+{
+    if (conn->closed)
+    {
+        return;
+    }
+    conn->closed = true;
+
+    EventLoop &loop = *this->loops.at(conn->loop);
+    epoll_ctl(loop.epollFd, EPOLL_CTL_DEL, conn->fd, nullptr);
+    if (!conn->zcPending.empty())
+    {
+        drainErrorQueue(conn);
+        abortPendingZeroCopy(*conn);
+    }
+    ::close(conn->fd);
+    conn->outq.clear();
+    conn->zcPending.clear();
+    loop.connections.erase(conn->fd);
+    this->connectionCount--;
+    this->handler.onClose(conn);
+}
+
+/**
+ * @brief IO thread body: wait for readiness, dispatch accept / read / write / posted tasks.
+ */
+void Reactor::loopBody(size_t index)
+{
+    EventLoop &loop = *this->loops.at(index);
+    epoll_event events[REACTOR_MAX_EVENTS];
+    auto lastSweep = std::chrono::steady_clock::now();
+    int waitMs = this->idleTimeout.count() ? REACTOR_SWEEP_MS : -1;
+
+    while (this->running.load())
+    {
+        if (waitMs > 0 && std::chrono::steady_clock::now() - lastSweep >= std::chrono::milliseconds(REACTOR_SWEEP_MS))
+        {
+            sweepIdle(loop);
+            lastSweep = std::chrono::steady_clock::now();
+        }
+
+        int count = epoll_wait(loop.epollFd, events, REACTOR_MAX_EVENTS, waitMs);
+        if (count < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            std::cerr << "Reactor::ERROR: epoll_wait failed" << std::endl;
+            break;
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            int fd = events[i].data.fd;
+            uint32_t flags = events[i].events;
+
+            if (fd == this->listenFd)
+            {
+                acceptAll(index);
+                continue;
+            }
+            if (fd == loop.wakeFd)
+            {
+                uint64_t drained;
+                while (read(loop.wakeFd, &drained, sizeof(drained)) > 0)
+                {
+                }
+                runPosted(loop);
+                continue;
+            }
+
+            auto found = loop.connections.find(fd);
+            if (found == loop.connections.end())
+            {
+                continue;
+            }
+            std::shared_ptr<Connection> conn = found->second;
+
+            if (flags & EPOLLERR)
+            {
+                // Zero-copy completions arrive on the error queue, real errors set SO_ERROR
+                drainErrorQueue(conn);
+                int error = 0;
+                socklen_t length = sizeof(error);
+                getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &error, &length);
+                if (error)
+                {
+                    close(conn);
+                    continue;
+                }
+            }
+            if (flags & EPOLLOUT)
+            {
+                flush(conn);
+            }
+            if (!conn->closed && (flags & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)))
+            {
+                readAll(conn);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Accepts every pending connection and registers it edge-triggered with this IO thread.
+ */
+void Reactor::acceptAll(size_t index)
+{
+    EventLoop &loop = *this->loops.at(index);
+    for (;;)
+    {
+        int fd = accept4(this->listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            // EAGAIN: backlog drained (or another IO thread won the race)
+            return;
+        }
+
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        std::shared_ptr<Connection> conn = this->handler.makeConnection(fd);
+        conn->loop = index;
+        conn->zerocopy = setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0;
+
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.fd = fd;
+        if (epoll_ctl(loop.epollFd, EPOLL_CTL_ADD, fd, &ev) < 0)
+        {
+            ::close(fd);
+            continue;
+        }
+        loop.connections[fd] = conn;
+        this->connectionCount++;
+    }
+}
+
+/**
+ * @brief Drains the socket until EAGAIN, then lets the handler consume the new bytes.
+ * @details At most inputLimit bytes are buffered: on reaching it the handler
+ *          consumes what it can before reading resumes, and a connection still
+ *          at the limit afterwards is closed.
+ */
+void Reactor::readAll(const std::shared_ptr<Connection> &conn)
+{
+    bool peerClosed = false;
+    bool received = false;
+    uint8_t chunk[REACTOR_READ_CHUNK];
+
+    for (;;)
+    {
+        if (conn->inbuf.size() >= this->inputLimit)
+        {
+            if (received)
+            {
+                this->handler.onData(conn);
+                received = false;
+            }
+            if (conn->closed)
+            {
+                return;
+            }
+            if (conn->inbuf.size() >= this->inputLimit)
+            {
+                close(conn);
+                return;
+            }
+        }
+
+        size_t room = std::min<size_t>(REACTOR_READ_CHUNK, this->inputLimit - conn->inbuf.size());
+        ssize_t n = recv(conn->fd, chunk, room, 0);
+
+        if (n > 0)
+        {
+            conn->inbuf.insert(conn->inbuf.end(), chunk, chunk + n);
+            received = true;
+            conn->lastActive = std::chrono::steady_clock::now();
+            continue;
+        }
+        if (n == 0)
+        {
+            peerClosed = true;
+        }
+        else if (errno == EINTR)
+        {
+            continue;
+        }
+        else if (errno != EAGAIN && errno != EWOULDBLOCK)
+        {
+            peerClosed = true;
+        }
+        break;
+    }
+
+    if (received)
+    {
+        this->handler.onData(conn);
+    }
+    if (peerClosed)
+    {
+        close(conn);
+    }
+}
+
+/**
+ * @brief Writes queued chunks with gathered sendmsg() calls until the queue
+ *        empties or the socket would block.
+ * @details Up to REACTOR_MAX_IOV chunks go out per syscall, so a frame header
+ *          and its payload share one call. Calls carrying a large buffer use
+ *          MSG_ZEROCOPY; their buffers stay referenced in zcPending until the
+ *          kernel reports completion. Partial writes resume mid-chunk.
+ */
+void Reactor::flush(const std::shared_ptr<Connection> &conn)
+{
+    bool wrote = false;
+    while (!conn->closed && !conn->outq.empty())
+    {
+        iovec iov[REACTOR_MAX_IOV];
+        size_t count = 0;
+        bool zerocopy = false;
+
+        for (auto it = conn->outq.begin(); it != conn->outq.end() && count < REACTOR_MAX_IOV; ++it, ++count)
+        {
+            size_t skip = (count == 0) ? conn->outOffset : 0;
+            iov[count].iov_base = const_cast<uint8_t *>(it->data + skip);
+            iov[count].iov_len = it->size - skip;
+            zerocopy |= (it->size - skip) >= ZEROCOPY_THRESHOLD;
+        }
+        zerocopy &= conn->zerocopy;
+
+        msghdr msg{};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+        ssize_t n = sendmsg(conn->fd, &msg, MSG_NOSIGNAL | (zerocopy ? MSG_ZEROCOPY : 0));
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return; // Resumed on the next EPOLLOUT edge
+            if (errno == ENOBUFS && zerocopy)
+            {
+                // Out of pinned-page budget, fall back to copying sends
+                conn->zerocopy = false;
+                continue;
+            }
+            close(conn);
+            return;
+        }
+
+        wrote = true;
+        conn->lastActive = std::chrono::steady_clock::now();
+        this->sendCalls++;
+        this->bytesSent += n;
+
+        ZeroCopyBatch batch{conn->zcNextSeq, {}};
+        if (zerocopy)
+        {
+            this->zerocopyCalls++;
+            conn->zcNextSeq++;
+        }
+
+        // Consume written bytes, pinning every buffer this call touched
+        size_t remaining = n;
+        while (!conn->outq.empty() && remaining)
+        {
+            OutChunk &chunk = conn->outq.front();
+            size_t left = chunk.size - conn->outOffset;
+            if (zerocopy)
+            {
+                batch.owners.push_back(chunk.owner);
+            }
+            if (remaining < left)
+            {
+                conn->outOffset += remaining;
+                remaining = 0;
+                break;
+            }
+            remaining -= left;
+            conn->outq.pop_front();
+            conn->outOffset = 0;
+        }
+        if (zerocopy)
+        {
+            conn->zcPending.push_back(std::move(batch));
+        }
+    }
+
+    if (conn->closed)
+    {
+        return;
+    }
+    if (conn->closing)
+    {
+        if (conn->zcPending.empty())
+        {
+            close(conn);
+        }
+        return;
+    }
+    if (wrote)
+    {
+        this->handler.onDrained(conn);
+    }
+}
+
+/**
+ * @brief Reads MSG_ZEROCOPY completion notifications and releases finished buffers.
+ * @details Each notification covers an inclusive range of sendmsg() sequence
+ *          numbers. If the kernel reports it had to copy anyway (e.g. loopback),
+ *          zero-copy is switched off for the connection since pinning is pure cost.
+ */
+void Reactor::drainErrorQueue(const std::shared_ptr<Connection> &conn)
+{
+    for (;;)
+    {
+        char control[128];
+        msghdr msg{};
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (recvmsg(conn->fd, &msg, MSG_ERRQUEUE) < 0)
+        {
+            break;
+        }
+
+        for (cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm))
+        {
+            bool recverr = (cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+                           (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR);
+            if (!recverr)
+            {
+                continue;
+            }
+
+            sock_extended_err *serr = reinterpret_cast<sock_extended_err *>(CMSG_DATA(cm));
+            if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+            {
+                continue;
+            }
+            if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+            {
+                this->zerocopyCopied++;
+                conn->zerocopy = false;
+            }
+
+            // Release batches in [ee_info, ee_data], sequence numbers may wrap
+            uint32_t lo = serr->ee_info;
+            uint32_t hi = serr->ee_data;
+            auto it = conn->zcPending.begin();
+            while (it != conn->zcPending.end())
+            {
+                if (it->seq - lo <= hi - lo)
+                    it = conn->zcPending.erase(it);
+                else
+                    ++it;
+            }
+        }
+    }
+
+    if (conn->closing && conn->outq.empty() && conn->zcPending.empty())
+    {
+        close(conn);
+    }
+}
+
+/**
+ * @brief Runs tasks other threads posted to this IO thread.
+ */
+void Reactor::runPosted(EventLoop &loop)
+{
+    std::vector<std::function<void()>> tasks;
+    {
+        std::lock_guard<std::mutex> lock(loop.postMutex);
+        tasks.swap(loop.posted);
+    }
+    for (auto &task : tasks)
+    {
+        task();
+    }
+}
+
+/**
+ * @brief Closes this IO thread's connections that have been idle past the timeout.
+ */
+void Reactor::sweepIdle(EventLoop &loop)
+{
+    auto now = std::chrono::steady_clock::now();
+    std::vector<std::shared_ptr<Connection>> expired;
+    for (auto &entry : loop.connections)
+    {
+        if (now - entry.second->lastActive > this->idleTimeout && this->handler.canExpire(entry.second))
+        {
+            expired.push_back(entry.second);
+        }
+    }
+    for (auto &conn : expired)
+    {
+        close(conn);
+    }
+}
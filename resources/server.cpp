@@ -74,12 +74,161 @@ void Server::setupServer()
     server_sin.sin_addr.s_addr = inet_addr(this->listenAddr.c_str());
 
     bind(this->serverSocket, (struct sockaddr *)&server_sin, sizeof(server_sin));
+
+    // Open camera once, capture thread keeps the ring buffer warm for all clients
+    if (!this->camera.start())
+    {
+        std::cerr << "Could not open Camera Feed, serving default image" << std::endl;
+    }
     this->state = RDY_STAGE;
     return;
 }
 
 /**
- *
+ * @brief Set the number of reactor IO threads used by serverLoop()
+ * @param threads Number of IO threads, must be at least one
+ */
+void Server::setIoThreads(size_t threads)
+{
+    if (this->state == REQ_STAGE)
+    {
+        throw ServerException("SETUP::ERROR: Cannot resize IO stage while serving", 0);
+    }
+    if (!threads)
+    {
+        throw ServerException("SETUP::ERROR: At least one IO thread is required", 0);
+    }
+    this->ioThreads = threads;
+    return;
+}
+
+/**
+ * @brief Configure admission control for the compute stage
+ * @param capacity Maximum number of requests queued for processing, 0 for 4 per core
+ * @param policy REJECT_WHEN_FULL answers excess requests with zero frames,
+ *               BLOCK_WHEN_FULL stalls the IO thread (and so TCP) until a slot frees
+ */
+void Server::setAdmission(size_t capacity, OverflowPolicy policy)
+{
+    if (this->state == REQ_STAGE)
+    {
+        throw ServerException("SETUP::ERROR: Cannot change admission policy while serving", 0);
+    }
+    this->queueCapacity = capacity;
+    this->overflowPolicy = policy;
+    return;
+}
+
+/**
+ * @brief Close binary sessions which stay idle between requests
+ * @param timeout Time without traffic before the session is closed, 0 keeps it open
+ */
+void Server::setIdleTimeout(std::chrono::milliseconds timeout)
+{
+    if (this->state == REQ_STAGE)
+    {
+        throw ServerException("SETUP::ERROR: Cannot change idle timeout while serving", 0);
+    }
+    this->idleTimeout = timeout;
+    return;
+}
+
+/**
+ * @brief Set the denoise applied to requests which do not choose one
+ */
+void Server::setDenoise(DenoiseMode mode)
+{
+    if (mode < 0 || mode >= DENOISE_MODES)
+    {
+        throw ServerException(std::format("SETUP::ERROR: Invalid denoise mode {}", static_cast<int>(mode)), 0);
+    }
+    this->denoise = mode;
+    return;
+}
+
+/**
+ * @brief Capture from a V4L2 device instead of the default cv::VideoCapture camera
+ * @param spec device[:YUYV|NV12|MJPG[:WIDTHxHEIGHT]], e.g. /dev/video0:NV12:1280x720
+ */
+void Server::setCaptureSource(const std::string &spec)
+{
+    if (this->state != IDLE_STAGE)
+    {
+        throw ServerException("SETUP::ERROR: Capture source must be set before setupServer()", 0);
+    }
+    std::string path;
+    CaptureFormat format;
+    if (!parseCaptureSource(spec, path, format))
+    {
+        throw ServerException(std::format("SETUP::ERROR: Invalid capture source {}", spec), 0);
+    }
+    this->camera.setSource(path, format);
+    return;
+}
+
+/**
+ * @brief Set how often delta sessions (WIRE_FLAG_DELTA) are sent full frames
+ * @param responses Longest run of responses between keyframes, 1 disables deltas
+ */
+void Server::setKeyframeInterval(size_t responses)
+{
+    if (responses < 1)
+    {
+        throw ServerException("SETUP::ERROR: Keyframe interval must be at least 1", 0);
+    }
+    this->keyframeInterval = responses;
+    return;
+}
+
+/**
+ * @brief Deliver frames requested with WIRE_FLAG_MULTICAST to a UDP multicast group
+ * @details Each computed frame set is sent to the group once, however many
+ *          receivers asked for it; sessions only receive an index of frame ids.
+ * @param group IPv4 multicast group
+ * @param port UDP destination port
+ * @param fecGroup Data chunks per XOR parity chunk, 0 disables FEC
+ */
+void Server::setMulticast(const std::string &group, int port, uint8_t fecGroup)
+{
+    if (this->state == REQ_STAGE)
+    {
+        throw ServerException("SETUP::ERROR: Cannot enable multicast while serving", 0);
+    }
+    if (!(port > 0 && port < 65536))
+    {
+        throw ServerException(std::format("SETUP::ERROR: Invalid multicast port {}", port), 0);
+    }
+    this->multicastGroup = group;
+    this->multicastPort = port;
+    this->multicastFec = fecGroup;
+    return;
+}
+
+/**
+ * @brief Queue depth, wait time and rejection counters of the compute stage
+ */
+PoolStats Server::getComputeStats()
+{
+    if (!this->compute)
+    {
+        return PoolStats{};
+    }
+    return this->compute->getStats();
+}
+
+/**
+ * @brief Hit, miss and memory counters of the pipeline's buffer pool
+ */
+BufferStats Server::getBufferStats()
+{
+    return this->buffers.getStats();
+}
+
+/**
+ * @brief Run the epoll reactor over the listening socket
+ * @details Client sockets are multiplexed on a small, fixed number of IO
+ *          threads. Parsed requests are handed to the compute stage, whose
+ *          results are posted back to the owning IO thread for transmission.
  */
 void Server::serverLoop()
 {
@@ -89,274 +238,1466 @@ void Server::serverLoop()
         throw std::runtime_error("Server is not in the ready state to start the loop.");
     }
 
+    // Listen once, the reactor accepts on every IO thread
+    if (listen(this->serverSocket, SOMAXCONN) < 0)
+    {
+        throw ServerException(std::format("SETUP::ERROR: Could not listen on socket {}", this->serverSocket), 0);
+    }
+
+    if (!this->multicastGroup.empty())
+    {
+        try {
+            this->multicast = std::make_unique<MulticastSender>(this->multicastGroup, this->multicastPort, this->multicastFec);
+        } catch (std::runtime_error &err) {
+            throw ServerException(err.what(), 0);
+        }
+    }
+
+    this->compute = std::make_unique<WorkerPool>(std::thread::hardware_concurrency(), this->queueCapacity, this->overflowPolicy);
+    this->reactor = std::make_unique<Reactor>(*this, this->ioThreads);
+    this->reactor->setIdleTimeout(this->idleTimeout);
+    this->reactor->setInputLimit(WIRE_MAX_REQUEST + WIRE_HEADER_SIZE);
+    this->state = REQ_STAGE;
+
     // Main Server Loop
     std::cout << std::format("Server Listening on: {}\n", ntohs(this->server_sin.sin_port) );
     std::cout << std::format("Server Socket: {}\n", this->serverSocket);
+    std::cout << std::format("IO Threads: {}, Compute Threads: {}, Queue Capacity: {}\n", this->reactor->getIoThreads(), this->compute->size(), this->compute->getCapacity());
+    if (this->multicast)
+    {
+        std::cout << std::format("Multicast Group: {}:{}, FEC: 1 parity per {} chunks\n", this->multicastGroup, this->multicastPort, this->multicastFec);
+    }
     std::cout << "-----------------------------\n";
     
+    this->streaming = true;
+    this->streamThread = std::thread(&Server::streamLoop, this);
+
     try {
         // Run Server Indefinitely
-        for (;;)
-        {
-            int clientSocket;
-            char buffer[1024] = {0};
-            
-            // Listen for Incoming Connections
-            listen(serverSocket, 5);
-            clientSocket = accept(serverSocket, nullptr, nullptr);
-            
-            // Create and Detach thread
-            std::thread thr(&Server::client_handle, this, clientSocket);
-            thr.detach(); // Detach the thread to allow it to run independently
-        }
+        this->reactor->run(this->serverSocket);
     }
     catch(ServerException& exc) {
         std::cerr << "Server Exception: " << exc.what() << std::endl;
     }    
+    {
+        std::lock_guard<std::mutex> lock(this->streamMutex);
+        this->streaming = false;
+    }
+    this->streamWake.notify_all();
+    this->streamThread.join();
+    this->compute->shutdown();
+    this->state = RDY_STAGE;
     return;
 }
 
 /**
- * @brief Retrieve a single camera frame from connected Camera at device 0
+ * @brief Reactor factory, attaches protocol state to every accepted socket
  */
-cv::Mat Server::getCameraFrame()
+std::shared_ptr<Connection> Server::makeConnection(int fd)
 {
-    cv::Mat img;
-    cv::Mat filtered;
+    return std::make_shared<ClientConnection>(fd);
+}
 
-    // Attempt to Open Camera, on failure throw error
-    auto cap = cv::VideoCapture(0);
-    if (!cap.isOpened())
-    {
+/**
+ * @brief Consume newly received bytes according to the connection's phase
+ * @details Runs on the connection's IO thread and never blocks: incomplete
+ *          requests stay buffered until the next readiness edge. The first
+ *          bytes select the protocol: binary v1 messages start with WIRE_MAGIC,
+ *          anything else is a legacy size-prefixed JSON request.
+ */
+void Server::onData(const std::shared_ptr<Connection> &base)
+{
+    auto conn = std::static_pointer_cast<ClientConnection>(base);
 
-        // Camera failed to open, send default.png
-        img = cv::imread("../assets/default.png");
-        std::cerr << "Could not open Camera Feed" << std::endl;
-        if( img.empty() ) throw ServerException("Could not open default image", 0);
-        return img;
-        // throw ServerException({"Camera::ERROR: Could not open media", 1});
-    } else {
+    if (conn->protocol == PROTO_UNKNOWN)
+    {
+        if (conn->inbuf.size() < sizeof(uint32_t))
+        {
+            return;
+        }
+        conn->protocol = isWireMessage(conn->inbuf.data(), conn->inbuf.size()) ? PROTO_BINARY : PROTO_LEGACY;
+    }
 
-        // Read Image and Filter
-        cap.read(img);
-        cap.release();
-        cv::bilateralFilter(img, filtered, 50, 25, 25);
+    if (conn->protocol == PROTO_BINARY)
+    {
+        onWireData(conn);
+    }
+    else
+    {
+        onLegacyData(conn);
+    }
+}
 
-        // Camera opened, but no image could be read
-        if( img.empty() ) {
-            img = cv::imread("../assets/default.png");
-            std::cerr << "Could not read frame from camera" << std::endl;
-            if( img.empty() ) throw ServerException("Could not open default image", 0);
-            return img;
+/**
+ * @brief Idle sweep may close a session unless its request is still being computed
+ */
+bool Server::canExpire(const std::shared_ptr<Connection> &base)
+{
+    return std::static_pointer_cast<ClientConnection>(base)->phase != PROCESSING;
+}
 
-        // Image Read, but filtered could not be produced
-        } else if( filtered.empty() ){
-            img = cv::imread("../assets/default.png");
-            std::cerr << "Could not produce filtered frame" << std::endl;
-            if( img.empty() ) throw ServerException("Could not open default image", 0);
-            return img;
-        }
+/**
+ * @brief Outgoing queue emptied: a subscriber which fell behind gets the newest pending set
+ */
+void Server::onDrained(const std::shared_ptr<Connection> &base)
+{
+    auto conn = std::static_pointer_cast<ClientConnection>(base);
+    if (conn->phase == STREAMING && conn->stream.pending)
+    {
+        FrameSet frames = std::move(conn->stream.pending);
+        conn->stream.pending.reset();
+        sendStreamSet(conn, std::move(frames));
     }
-    return filtered;
 }
 
 /**
- * @brief Handle Client connections to the server.
- * @details Process the client's request, generate the desired output,
- *          and send over sockets back to the user the requested data.
- * @return Nothing
+ * @brief Connection gone: the stream scheduler drops it on its next pass
  */
-void Server::client_handle(int client_socket) {
-    std::string buffer;
-    nlohmann::json request;
-    std::vector<uchar> imgBuff;
-    size_t buffer_size(0);
-    std::vector<Filter> colorFilters;
-    std::vector<std::pair<cv::Mat, std::string>> frames;
+void Server::onClose(const std::shared_ptr<Connection> &base)
+{
+    std::static_pointer_cast<ClientConnection>(base)->stream.active = false;
+}
 
+/**
+ * @brief Legacy protocol: size_t prefixed JSON request, raw int/size_t response fields
+ */
+void Server::onLegacyData(const std::shared_ptr<ClientConnection> &conn)
+{
     // Receive Request Size First, then receive request
-    recv(client_socket, &buffer_size, sizeof(size_t), 0);
-    buffer.resize(buffer_size);
-    recv(client_socket, buffer.data(), buffer_size, 0);
-    
-    // Parse Request, check integrity, and check for correct state
-    request = nlohmann::json::parse( buffer.begin(), buffer.end() );
-    if( ! checkHashJSON(request) ) {
-        throw ServerException("JSON hash incorrect");
-    }
-    if( request["state"] != "request" ) {
-        throw ServerException("Client not in request state");
-    }
-    colorFilters = buildFilterArray( request );
+    if (conn->phase == READ_REQUEST)
+    {
+        size_t buffer_size(0);
+        if (conn->inbuf.size() < sizeof(size_t))
+        {
+            return;
+        }
+        std::memcpy(&buffer_size, conn->inbuf.data(), sizeof(size_t));
+        if (buffer_size > WIRE_MAX_REQUEST)
+        {
+            std::cerr << "JSON::ERROR: Request exceeds " << WIRE_MAX_REQUEST << " bytes" << std::endl;
+            this->reactor->close(conn);
+            return;
+        }
+        if (conn->inbuf.size() < sizeof(size_t) + buffer_size)
+        {
+            return;
+        }
 
+        // Parse Request, check integrity, and check for correct state
+        auto begin = conn->inbuf.begin() + sizeof(size_t);
+        try {
+            conn->request = nlohmann::json::parse(begin, begin + buffer_size);
+        } catch (nlohmann::json::parse_error &err) {
+            std::cerr << "JSON::ERROR: " << err.what() << std::endl;
+            this->reactor->close(conn);
+            return;
+        }
+        conn->inbuf.erase(conn->inbuf.begin(), begin + buffer_size);
 
-    // Retrieve Camera Image and Process into Frames
-    cv::Mat img = getCameraFrame();
-    imageProc(img, colorFilters, frames);
-    
-    // Send Client Number of Frames to Accept
-    // nlohmann::json j;
-    // j["num_frames"] = frames.size();
-    // send(client_socket, j.dump().data(), j.dump().size(), 0);
-    int numberFrames(frames.size());
-
-    send(client_socket, &numberFrames, sizeof(int), 0);
-    int i = 0;
-    std::cout << "Frames Size: " << frames.size() << std::endl;
-    std::cout << "Request Frames Size: " << request["frames"].size() << std::endl;
-
-    for( auto pair : frames ) {
-        size_t img_buff_size(0);
-
-        // Encode Frame
-        cv::imencode( ".png", pair.first, imgBuff );
-        img_buff_size = imgBuff.size();
-
-        // Send Integer Indicating Saturation Color
-        send(client_socket, &i, sizeof(int), 0);
-
-        // Send Frame to Client
-        send(client_socket, &img_buff_size, sizeof(size_t), 0);
-        send(client_socket, imgBuff.data(), img_buff_size, 0);
-
-        std::cout << "Filter: " << request["frames"].at(i) << std::endl;
-        std::cout << "MD5 Hash: " << pair.second << std::endl;
-
-        // DEBUG
-        buffer.resize(10);
-        recv(client_socket, buffer.data(), sizeof(10), 0);
-        // std::cout << "Received: " << buffer << std::endl;
-        std::cout << "Count: " << i << " of 3" << std::endl; 
-        i++;
-    }
-    std::cout << "--------------------" << std::endl;
-
-    ///////////
-    // std::vector<std::pair<cv::Mat, std::string>> frames;
-    // imageProc(  )
-    close(client_socket);
-    return;
-}
+        if( ! checkHashJSON(conn->request) ) {
+            std::cerr << "JSON hash incorrect" << std::endl;
+            this->reactor->close(conn);
+            return;
+        }
+        if( conn->request["state"] != "request" ) {
+            std::cerr << "Client not in request state" << std::endl;
+            this->reactor->close(conn);
+            return;
+        }
 
+        // Older clients omit the field and keep per-frame acknowledgements
+        conn->pipelined = conn->request.contains("pipeline") && conn->request["pipeline"] == true;
 
+        CaptureRequest capture;
+        try {
+            capture = buildCaptureRequest( conn->request );
+        } catch( std::exception& exc ) {
+            std::cerr << "Std::Exception: " << exc.what() << std::endl;
+            this->reactor->close(conn);
+            return;
+        } catch( ServerException& exc ) {
+            std::cerr << "Server Exception: " << exc.what() << std::endl;
+            this->reactor->close(conn);
+            return;
+        }
+        startRequest(conn, capture);
+        return;
+    }
 
+    // Frame acknowledged by client, send next
+    if (conn->phase == WAIT_ACK && conn->inbuf.size() >= LEGACY_ACK_SIZE)
+    {
+        conn->inbuf.erase(conn->inbuf.begin(), conn->inbuf.begin() + LEGACY_ACK_SIZE);
+        std::cout << "Count: " << conn->nextFrame << " of " << conn->frames->size() << std::endl;
+        sendFrame(conn);
+        return;
+    }
 
+    // Single end-of-batch summary: number of frames the client received
+    if (conn->phase == WAIT_BATCH && conn->inbuf.size() >= sizeof(int))
+    {
+        int received(0);
+        std::memcpy(&received, conn->inbuf.data(), sizeof(int));
+        conn->inbuf.erase(conn->inbuf.begin(), conn->inbuf.begin() + sizeof(int));
+        finishBatch(conn, received);
+    }
+}
 
 /**
- * @brief Split Image into frames and compute MD5 hash for each frame, individually.
- * @param input Image to be processed by function call
- * @param filters Color vectors to be applied to input as filters
- * @param ret_val The final results of processing will be written here
- * @return bool indicating the success or failure of the operation
+ * @brief Binary protocol: fixed network-order headers parsed in place in the receive buffer
+ * @details A connection is a session: it returns to READ_REQUEST after every
+ *          response, so clients may issue any number of requests on one socket.
+ *          A request arriving while the previous one is still being answered
+ *          stays buffered until finishResponse() picks it up.
  */
-bool Server::imageProc(const cv::Mat &input, const std::vector<Filter> &filters, std::vector<std::pair<cv::Mat, std::string>> &ret_val)
+void Server::onWireData(const std::shared_ptr<ClientConnection> &conn)
 {
+    while (!conn->closed)
+    {
+        WireHeader header;
+        WireStatus status = parseHeader(conn->inbuf.data(), conn->inbuf.size(), header);
+        if (status == WIRE_INCOMPLETE)
+        {
+            return;
+        }
+        if (status != WIRE_OK)
+        {
+            std::cerr << "Wire::ERROR: Invalid message (status " << status << ")" << std::endl;
+            sendWireError(conn, header.seq, "invalid message");
+            this->reactor->closeWhenDrained(conn);
+            return;
+        }
 
-    // Check input and filters are NOT EMPTY
-    // if (this->state != REQ_STAGE)
-    // {
-    //     throw ServerException(std::format("Image::Proc: In state ({}) when expected was REQ_STAGE(3)", this->state), 0);
-    // }
-    // else if (input.empty())
-    // {
-    //     throw ServerException("ImageProc::ERROR: Passed input was empty", 0);
-    // }
-    // else if (!filters.size())
-    // {
-    //     throw ServerException("ImageProc::ERROR: Filters array is empty", 0);
-    // }
-
-    // NOTE: For now, only color vectors RGB are supported
-    assert(filters.at(0) == Filter(255, 0, 0));
-    assert(filters.at(1) == Filter(0, 255, 0));
-    assert(filters.at(2) == Filter(0, 0, 255));
+        const uint8_t *payload = conn->inbuf.data() + WIRE_HEADER_SIZE;
+        size_t consumed = WIRE_HEADER_SIZE + header.length;
 
-    for (auto filt : filters)
-    {
-        // Create a copy of the input image
-        cv::Mat filteredImage;
-        input.copyTo(filteredImage);
+        switch (header.type)
+        {
+        case MSG_CAPTURE_REQUEST:
+        {
+            // Payload: u8 count, then count SatColor bytes or color matrices
+            if (conn->phase == STREAMING)
+            {
+                sendWireError(conn, header.seq, "unsubscribe before requesting captures");
+                conn->inbuf.erase(conn->inbuf.begin(), conn->inbuf.begin() + consumed);
+                continue;
+            }
+            if (conn->phase != READ_REQUEST)
+            {
+                return;
+            }
+            conn->seq = header.seq;
+            conn->pipelined = (header.flags & WIRE_FLAG_PIPELINE) != 0;
+            conn->multicast = (header.flags & WIRE_FLAG_MULTICAST) != 0;
+            conn->planes = (header.flags & WIRE_FLAG_PLANES) != 0;
+            conn->lossless = (header.flags & WIRE_FLAG_LOSSLESS) != 0;
+            conn->keyframe = conn->keyframe || (header.flags & WIRE_FLAG_KEYFRAME) != 0;
+            conn->delta = (header.flags & WIRE_FLAG_DELTA) != 0 && !conn->multicast;
+            if (!conn->delta)
+            {
+                conn->reference.clear();
+                conn->referenceFilters.clear();
+            }
+            if (conn->multicast && !this->multicast)
+            {
+                conn->inbuf.erase(conn->inbuf.begin(), conn->inbuf.begin() + consumed);
+                sendWireError(conn, header.seq, "multicast delivery is not enabled");
+                continue;
+            }
 
-        // Apply the filter by zeroing out other channels
-        std::vector<cv::Mat> channels(3);
-        cv::split(filteredImage, channels);
+            // Parsed straight out of the receive buffer, which is only trimmed afterwards
+            CaptureRequest capture;
+            std::optional<std::string> error;
+            try {
+                capture = parseCaptureRequest( payload, header.length, header.flags );
+            } catch( std::exception& exc ) {
+                error = exc.what();
+            } catch( ServerException& exc ) {
+                error = exc.what();
+            }
+            conn->inbuf.erase(conn->inbuf.begin(), conn->inbuf.begin() + consumed);
+            if (error)
+            {
+                // Bad request, the session itself is still usable
+                sendWireError(conn, header.seq, *error);
+                continue;
+            }
+            startRequest(conn, capture);
+            continue;
+        }
 
-        if (filt == Filter(255, 0, 0)) // Red filter
+        case MSG_ACK:
         {
-            channels[1] = cv::Mat::zeros(channels[1].size(), channels[1].type()); // Zero out Green
-            channels[2] = cv::Mat::zeros(channels[2].size(), channels[2].type()); // Zero out Blue
+            uint32_t received(0);
+            if (header.length >= sizeof(uint32_t))
+            {
+                std::memcpy(&received, payload, sizeof(uint32_t));
+                received = ntohl(received);
+            }
+            conn->inbuf.erase(conn->inbuf.begin(), conn->inbuf.begin() + consumed);
+            if (conn->phase == WAIT_ACK)
+            {
+                sendFrame(conn);
+            }
+            else if (conn->phase == WAIT_BATCH)
+            {
+                finishBatch(conn, received);
+            }
+            continue;
         }
-        else if (filt == Filter(0, 255, 0)) // Green filter
+
+        case MSG_SUBSCRIBE:
         {
-            channels[0] = cv::Mat::zeros(channels[0].size(), channels[0].type()); // Zero out Red
-            channels[2] = cv::Mat::zeros(channels[2].size(), channels[2].type()); // Zero out Blue
+            // Wait for an in-progress response to finish, a live stream is simply re-configured
+            if (conn->phase != READ_REQUEST && conn->phase != STREAMING)
+            {
+                return;
+            }
+            subscribe(conn, header.seq, header.flags, payload, header.length);
+            conn->inbuf.erase(conn->inbuf.begin(), conn->inbuf.begin() + consumed);
+            continue;
         }
-        else if (filt == Filter(0, 0, 255)) // Blue filter
+
+        case MSG_UNSUBSCRIBE:
         {
-            channels[0] = cv::Mat::zeros(channels[0].size(), channels[0].type()); // Zero out Red
-            channels[1] = cv::Mat::zeros(channels[1].size(), channels[1].type()); // Zero out Green
+            conn->inbuf.erase(conn->inbuf.begin(), conn->inbuf.begin() + consumed);
+            if (conn->phase != STREAMING)
+            {
+                sendWireError(conn, header.seq, "not subscribed");
+                continue;
+            }
+            unsubscribe(conn, header.seq);
+            return;
         }
 
-        // Merge the channels back together
-        cv::merge(channels, filteredImage);
+        case MSG_NACK:
+        {
+            // Receivers may NACK between requests, independent of the session phase
+            handleNack(conn, header.seq, payload, header.length);
+            conn->inbuf.erase(conn->inbuf.begin(), conn->inbuf.begin() + consumed);
+            continue;
+        }
 
-        // Compute MD5 hash for the filtered image
-        std::vector<uchar> buffer;
-        cv::imencode(".png", filteredImage, buffer);
-        std::string hash = md5({reinterpret_cast<const char *>(buffer.data())});
+        case MSG_CONTROL:
+        {
+            std::string text(reinterpret_cast<const char *>(payload), header.length);
+            conn->inbuf.erase(conn->inbuf.begin(), conn->inbuf.begin() + consumed);
+            handleControl(conn, header.seq, text);
+            continue;
+        }
 
-        // Append the result to the return vector
-        ret_val.emplace_back(filteredImage, hash);
+        default:
+            sendWireError(conn, header.seq, "unsupported message type");
+            this->reactor->closeWhenDrained(conn);
+            return;
+        }
     }
-
-    // For each filter, apply to IMG and append to ret_val
-    // for( auto filt : filters ) {
-
-    // }
-    return true;
 }
 
 /**
- * @brief Generates Filters from Request
- * @param request the JSON object which contains the filters list
+ * @brief JSON control messages, kept off the capture hot path
+ * @details {"state": "stats"} answers with the IO, compute and coalescing counters.
  */
-std::vector<Filter> Server::buildFilterArray( nlohmann::json& request ) {
-    if( ! request.size() ) {
-        throw ServerException("FilterArr::ERROR: Passed request is of size 0", 0);
+void Server::handleControl(const std::shared_ptr<ClientConnection> &conn, uint32_t seq, const std::string &text)
+{
+    nlohmann::json request;
+    nlohmann::json reply;
+    try {
+        request = nlohmann::json::parse(text);
+    } catch (nlohmann::json::parse_error &err) {
+        sendWireError(conn, seq, "control message is not valid JSON");
+        return;
     }
-    
-    nlohmann::json::iterator it = request.end();
-    if( request.find("frames") == it ) {
-        throw ServerException("FilterArr::ERROR: Passed request is missing frames attribute", 0);
+
+    if (request.contains("state") && request["state"] == "multicast")
+    {
+        if (!this->multicast)
+        {
+            sendWireError(conn, seq, "multicast delivery is not enabled");
+            return;
+        }
+        reply["state"] = "multicast";
+        reply["group"] = this->multicast->getGroup();
+        reply["port"] = this->multicast->getPort();
+        reply["fec"] = this->multicast->getFecGroup();
     }
-    
-    std::vector<Filter> filters;
-    std::vector<int> frames = request["frames"];
-    if ( frames.at(0) == SatColor::RED)
+    else if (request.contains("state") && request["state"] == "stats")
     {
-        filters.push_back(Filter(255, 0, 0));
+        PoolStats pool = getComputeStats();
+        ReactorStats io = this->reactor->getStats();
+        reply["state"] = "stats";
+        reply["connections"] = this->reactor->getConnectionCount();
+        reply["queue_depth"] = pool.queueDepth;
+        reply["queue_peak"] = pool.peakQueueDepth;
+        reply["avg_wait_ms"] = pool.avgWaitMs;
+        reply["rejected"] = pool.rejected;
+        reply["completed"] = pool.completed;
+        reply["coalesced"] = this->inflight.getCoalesced();
+        {
+            std::lock_guard<std::mutex> lock(this->streamMutex);
+            reply["subscribers"] = this->subscribers.size();
+        }
+        reply["send_calls"] = io.sendCalls;
+        reply["bytes_sent"] = io.bytesSent;
+        reply["zerocopy_calls"] = io.zerocopyCalls;
+        reply["denoise_default"] = denoiseName(this->denoise);
+        for (int mode = 0; mode < DENOISE_MODES; mode++)
+        {
+            uint64_t frames = this->denoiseFrames[mode];
+            if (frames)
+            {
+                reply["denoise"][denoiseName(static_cast<DenoiseMode>(mode))] = {{"frames", frames}, {"avg_ms", this->denoiseMicros[mode] / 1000.0 / frames}};
+            }
+        }
+        BufferStats buffers = getBufferStats();
+        reply["buffer_hits"] = buffers.hits;
+        reply["buffer_misses"] = buffers.misses;
+        reply["buffer_bytes_in_use"] = buffers.bytesInUse;
+        reply["buffer_bytes_idle"] = buffers.bytesIdle;
+        reply["buffer_peak_bytes"] = buffers.peakBytes;
+        reply["keyframe_interval"] = this->keyframeInterval;
+        reply["delta_frames"] = this->deltaFrames.load();
+        reply["delta_bytes_saved"] = this->deltaBytesSaved.load();
+        reply["batches_acked"] = this->batchesAcked.load();
+        reply["batch_frames_missed"] = this->batchFramesMissed.load();
+        if (this->multicast)
+        {
+            McastStats mcast = this->multicast->getStats();
+            reply["multicast_frames"] = mcast.framesSent;
+            reply["multicast_datagrams"] = mcast.datagramsSent;
+            reply["multicast_parity"] = mcast.parityDatagrams;
+            reply["multicast_retransmitted"] = mcast.retransmitted;
+        }
     }
     else
     {
-        std::cout << "No Red" << std::endl;
+        sendWireError(conn, seq, "unknown control message");
+        return;
     }
 
-    if (frames.at(1) == SatColor::GREEN)
+    std::string body = reply.dump();
+    this->reactor->queue(conn, makeChunk(buildMessage(MSG_CONTROL, 0, seq, reinterpret_cast<const uint8_t *>(body.data()), body.size())));
+}
+
+/**
+ * @brief Re-multicast the chunks a receiver reported missing
+ * @details The retransmission goes to the whole group, so receivers which lost
+ *          the same chunk are repaired by one NACK.
+ */
+void Server::handleNack(const std::shared_ptr<ClientConnection> &conn, uint32_t seq, const uint8_t *payload, size_t length)
+{
+    uint32_t frameId;
+    std::vector<uint16_t> chunks;
+    if (!this->multicast || !readNack(payload, length, frameId, chunks))
     {
-        filters.push_back(Filter(0, 255, 0));
+        sendWireError(conn, seq, "invalid NACK");
+        return;
     }
-    else
+    // Not answered: the receiver times out on its own once its NACK rounds run out
+    if (!this->multicast->retransmit(frameId, chunks))
     {
-        std::cout << "No grn" << std::endl;
+        std::cerr << "Multicast frame " << frameId << " is no longer retained" << std::endl;
     }
+}
 
-    if (frames.at(2) == SatColor::BLUE)
+/**
+ * @brief Answer a multicast request with the ids of the frames sent to the group
+ */
+void Server::sendMulticastIndex(const std::shared_ptr<ClientConnection> &conn)
+{
+    std::vector<McastFrameRef> refs;
+    for (const EncodedFrame &frame : *conn->frames)
     {
-        filters.push_back(Filter(0, 0, 255));
+        refs.push_back(McastFrameRef{frame.multicastId, static_cast<uint32_t>(frame.data->size()), static_cast<uint8_t>(frame.color), frame.planes, {0, 0}});
     }
-    else
+    std::vector<uint8_t> index = buildMcastIndex(refs);
+    uint16_t flags = WIRE_FLAG_MULTICAST;
+    if (!conn->frames->empty() && conn->frames->front().region.scale)
     {
-        std::cout << "No Blu" << std::endl;
+        appendValue(index, makeRegionInfo(conn->frames->front().region));
+        flags |= WIRE_FLAG_REGION;
     }
-    return filters;
-}
\ No newline at end of file
+    this->reactor->queue(conn, makeChunk(buildMessage(MSG_MCAST_INDEX, flags, conn->seq, index.data(), index.size())));
+    finishResponse(conn);
+}
+
+/**
+ * @brief Queue a MSG_ERROR carrying a JSON description of the failure
+ */
+void Server::sendWireError(const std::shared_ptr<ClientConnection> &conn, uint32_t seq, const std::string &message)
+{
+    nlohmann::json error;
+    error["error"] = message;
+    std::string body = error.dump();
+    this->reactor->queue(conn, makeChunk(buildMessage(MSG_ERROR, 0, seq, reinterpret_cast<const uint8_t *>(body.data()), body.size())));
+}
+
+/**
+ * @brief Coalesce the parsed request with identical in-flight work, or start it
+ * @param request Filters and denoise requested by the client
+ */
+void Server::startRequest(const std::shared_ptr<ClientConnection> &conn, const CaptureRequest &request)
+{
+    FlightKey key = makeFlightKey(this->camera.getGeneration(), request, conn->multicast, conn->planes, conn->lossless);
+
+    // References are kept by position, a different frame set would be diffed against another filter's frames
+    if (conn->delta && (key.filters != conn->referenceFilters || key.region != conn->referenceRegion))
+    {
+        conn->keyframe = true;
+        conn->referenceFilters = key.filters;
+        conn->referenceRegion = key.region;
+    }
+
+    conn->phase = PROCESSING;
+    auto deliver = [this, conn](const FrameSet &frames)
+    { this->reactor->post(conn, [this, conn, frames]()
+                          { deliverFrames(conn, frames); }); };
+    runFlight(key, request, [this, conn, deliver](const FrameSet &frames)
+              {
+                  if (!conn->delta || !frames || frames->empty())
+                  {
+                      deliver(frames);
+                      return;
+                  }
+
+                  // Deltas are against each session's own previous frames. Encoded right here on the
+                  // compute worker: resubmitting could block a worker in a full BLOCK_WHEN_FULL pool
+                  deliver(encodeDeltas(conn, frames));
+              });
+}
+
+/**
+ * @brief CRC-32 of a MSG_FRAME payload: FrameInfo, RegionInfo when present, encoded image
+ */
+static uint32_t frameChecksum(const EncodedFrame &frame, uint16_t index, uint16_t count)
+{
+    FrameInfo info = makeFrameInfo(index, count, frame.color, frame.encoding, frame.planes);
+    uint32_t checksum = crc32(reinterpret_cast<const uint8_t *>(&info), sizeof(FrameInfo));
+    if (frame.region.scale)
+    {
+        RegionInfo region = makeRegionInfo(frame.region);
+        checksum = crc32(reinterpret_cast<const uint8_t *>(&region), sizeof(RegionInfo), checksum);
+    }
+    return crc32(frame.data->data(), frame.data->size(), checksum);
+}
+
+/**
+ * @brief Largest PNG of an image: every row stored uncompressed with its filter byte, plus zlib and chunk framing
+ * @details Pooled output buffers reserve this much, so an encode never regrows them.
+ */
+static size_t encodeBound(const cv::Mat &image)
+{
+    size_t raw = image.total() * image.elemSize() + image.rows;
+    return raw + raw / 256 + 1024;
+}
+
+/**
+ * @brief Encode a frame or residual with the native lossless codec if allowed, as PNG otherwise
+ * @details One encoder runs per frame. PNG is the fallback only for images the
+ *          codec cannot take, or whose container ends up larger than the raw pixels.
+ * @param output Replaced by the encoded bytes
+ * @return FRAME_LOSSLESS or FRAME_PNG, whichever the bytes are
+ */
+static uint8_t encodeImage(bool lossless, const cv::Mat &image, std::vector<uint8_t> &output)
+{
+    output.clear();
+    if (lossless && encodeLossless(image, output) && output.size() <= image.total() * image.elemSize())
+    {
+        return FRAME_LOSSLESS;
+    }
+    output.clear();
+    cv::imencode(".png", image, output);
+    return FRAME_PNG;
+}
+
+/**
+ * @brief Re-encode a shared frame set against the frames this session already holds
+ * @details Each frame becomes its residual against the previous frame at the
+ *          same index (see deltaEncode), coded like the frame itself (PNG or the
+ *          lossless codec), when that is smaller than the full frame. Keyframes
+ *          are sent on request, after keyframeInterval - 1 responses carrying
+ *          deltas, and whenever the filters or region changed (see startRequest),
+ *          since references are held by position in the response. The session's
+ *          references are replaced by this set, matching what the client will decode.
+ */
+FrameSet Server::encodeDeltas(const std::shared_ptr<ClientConnection> &conn, const FrameSet &frames)
+{
+    bool keyframe = conn->keyframe || conn->sinceKeyframe + 1 >= this->keyframeInterval;
+    auto encoded = std::make_shared<std::vector<EncodedFrame>>(*frames);
+    size_t deltas(0);
+
+    conn->reference.resize(frames->size());
+    for (size_t i = 0; i < encoded->size(); i++)
+    {
+        EncodedFrame &frame = (*encoded)[i];
+        cv::Mat residual = this->buffers.acquire();
+        std::shared_ptr<std::vector<uint8_t>> imgBuff;
+        uint8_t encoding(FRAME_DELTA_PNG);
+        if (!keyframe && deltaEncode(frame.pixels, conn->reference[i], residual))
+        {
+            // Sent only if smaller than the full frame, so that much is reserved
+            imgBuff = this->buffers.acquireBytes(frame.data->size());
+            encoding = encodeImage(frame.encoding == FRAME_LOSSLESS, residual, *imgBuff) == FRAME_LOSSLESS ? FRAME_DELTA_LOSSLESS : FRAME_DELTA_PNG;
+        }
+        if (imgBuff && !imgBuff->empty() && imgBuff->size() < frame.data->size())
+        {
+            this->deltaBytesSaved += frame.data->size() - imgBuff->size();
+            frame.data = std::move(imgBuff);
+            frame.encoding = encoding;
+            frame.checksum = frameChecksum(frame, i, encoded->size());
+            deltas++;
+        }
+        conn->reference[i] = frame.pixels;
+    }
+
+    this->deltaFrames += deltas;
+    conn->keyframe = false;
+
+    // Only responses carrying deltas count towards the next forced keyframe, a full set restarts the count
+    conn->sinceKeyframe = deltas ? conn->sinceKeyframe + 1 : 0;
+    return encoded;
+}
+
+/**
+ * @brief Key identifying interchangeable work: same capture, filters, region and encoding
+ * @details Matrices are compared at wire precision, so requests for the same
+ *          transform coalesce however the client spelled it.
+ * @param lossless Client accepts the native lossless codec, frames are coded with it instead of PNG
+ */
+FlightKey Server::makeFlightKey(uint64_t generation, const CaptureRequest &request, bool multicast, bool planes, bool lossless)
+{
+    const RegionInfo &region = request.region;
+    FlightKey key{generation, {}, lossless ? LOSSLESS_EXTENSION : ".png", multicast, planes, static_cast<uint8_t>(request.denoise),
+                  {region.x, region.y, region.width, region.height, region.scale}};
+    std::vector<uint8_t> wire;
+    for (const ColorMatrix &matrix : request.filters)
+    {
+        appendColorMatrix(wire, matrix);
+    }
+    key.filters.resize(wire.size() / sizeof(int32_t));
+    std::memcpy(key.filters.data(), wire.data(), wire.size());
+    return key;
+}
+
+/**
+ * @brief Join an in-flight computation, or lead a new one on the compute stage
+ * @param callback Receives the frame set, nullptr if the request was rejected
+ */
+void Server::runFlight(const FlightKey &key, const CaptureRequest &request, SingleFlight<FlightKey, FrameSet>::Callback callback)
+{
+    bool leader = this->inflight.join(key, std::move(callback));
+    if (leader && !this->compute->submit([this, key, request]()
+                                         { client_handle(key, request); }))
+    {
+        // Overloaded: every waiter gets zero frames rather than queueing unboundedly
+        std::cerr << "Compute stage full, rejecting request" << std::endl;
+        this->inflight.complete(key, nullptr);
+    }
+}
+
+/**
+ * @brief Start (or re-configure) a subscription: u16 target fps, then a capture request
+ * @param flags Header flags, WIRE_FLAG_COLOR_MATRIX selects the capture request layout
+ * @details Frame sets are pushed from the stream scheduler at most 'fps' times a
+ *          second, and never faster than the camera publishes new captures.
+ */
+void Server::subscribe(const std::shared_ptr<ClientConnection> &conn, uint32_t seq, uint16_t flags, const uint8_t *payload, size_t length)
+{
+    uint16_t fps(0);
+    if (length >= sizeof(fps))
+    {
+        std::memcpy(&fps, payload, sizeof(fps));
+        fps = ntohs(fps);
+    }
+    if (!fps || fps > STREAM_MAX_FPS)
+    {
+        sendWireError(conn, seq, std::format("invalid subscription, fps must be 1 to {}", STREAM_MAX_FPS));
+        return;
+    }
+
+    CaptureRequest capture;
+    try {
+        capture = parseCaptureRequest( payload + sizeof(fps), length - sizeof(fps), flags );
+    } catch( std::exception& exc ) {
+        sendWireError(conn, seq, exc.what());
+        return;
+    } catch( ServerException& exc ) {
+        sendWireError(conn, seq, exc.what());
+        return;
+    }
+
+    conn->phase = STREAMING;
+    conn->pipelined = true;
+    conn->stream.seq = seq;
+    conn->stream.pending.reset();
+    {
+        std::lock_guard<std::mutex> lock(this->streamMutex);
+        conn->stream.interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::seconds(1)) / fps;
+        conn->stream.due = std::chrono::steady_clock::now();
+        conn->stream.capture = capture;
+        conn->stream.planes = (flags & WIRE_FLAG_PLANES) != 0;
+        conn->stream.lossless = (flags & WIRE_FLAG_LOSSLESS) != 0;
+        if (!conn->stream.active.exchange(true))
+        {
+            this->subscribers.push_back(conn);
+        }
+    }
+    this->streamWake.notify_one();
+}
+
+/**
+ * @brief End a subscription with a final MSG_STREAM_STATUS carrying the unsubscribe's sequence number
+ */
+void Server::unsubscribe(const std::shared_ptr<ClientConnection> &conn, uint32_t seq)
+{
+    {
+        // Dropped from the scheduler now, so a quick resubscribe is not scheduled twice
+        std::lock_guard<std::mutex> lock(this->streamMutex);
+        conn->stream.active = false;
+        std::erase_if(this->subscribers, [&conn](const std::weak_ptr<ClientConnection> &entry)
+                      {
+                          std::shared_ptr<ClientConnection> subscriber = entry.lock();
+                          return !subscriber || subscriber == conn; });
+    }
+    conn->stream.pending.reset();
+
+    StreamStatus status = makeStreamStatus(conn->stream.delivered, conn->stream.dropped);
+    this->reactor->queue(conn, makeChunk(buildMessage(MSG_STREAM_STATUS, 0, seq, reinterpret_cast<const uint8_t *>(&status), sizeof(status))));
+
+    conn->pipelined = false;
+    finishResponse(conn);
+}
+
+/**
+ * @brief Stream scheduler: starts a computation for every subscriber whose next frame is due
+ * @details Subscribers asking for the same filters at the same capture share one
+ *          flight. A subscriber whose previous set is still being computed skips
+ *          the tick, which counts as a dropped frame rather than a queued one.
+ */
+void Server::streamLoop()
+{
+    std::unique_lock<std::mutex> lock(this->streamMutex);
+    while (this->streaming)
+    {
+        auto now = std::chrono::steady_clock::now();
+        auto wake = now + std::chrono::seconds(1);
+        uint64_t generation = this->camera.getGeneration();
+        std::vector<std::pair<std::shared_ptr<ClientConnection>, FlightKey>> due;
+
+        for (auto it = this->subscribers.begin(); it != this->subscribers.end();)
+        {
+            std::shared_ptr<ClientConnection> conn = it->lock();
+            if (!conn || !conn->stream.active)
+            {
+                it = this->subscribers.erase(it);
+                continue;
+            }
+            it++;
+
+            StreamState &stream = conn->stream;
+            if (now < stream.due)
+            {
+                wake = std::min(wake, stream.due);
+                continue;
+            }
+
+            // Live camera: only push captures the subscriber has not seen
+            if (this->camera.isOpened() && generation == stream.generation)
+            {
+                wake = std::min(wake, now + std::chrono::milliseconds(STREAM_POLL_MS));
+                continue;
+            }
+
+            stream.due += stream.interval;
+            if (stream.due < now)
+            {
+                stream.due = now + stream.interval;
+            }
+            wake = std::min(wake, stream.due);
+
+            if (stream.inflight.exchange(true))
+            {
+                stream.dropped++;
+                continue;
+            }
+            stream.generation = generation;
+
+            due.emplace_back(conn, makeFlightKey(generation, stream.capture, false, stream.planes, stream.lossless));
+        }
+
+        // Flights are started without the lock, rejected ones complete synchronously
+        std::vector<CaptureRequest> captures;
+        for (auto &entry : due)
+        {
+            captures.push_back(entry.first->stream.capture);
+        }
+        lock.unlock();
+        for (size_t i = 0; i < due.size(); i++)
+        {
+            std::shared_ptr<ClientConnection> conn = due[i].first;
+            runFlight(due[i].second, captures[i], [this, conn](const FrameSet &frames)
+                      { this->reactor->post(conn, [this, conn, frames]()
+                                            { deliverStream(conn, frames); }); });
+        }
+        lock.lock();
+
+        this->streamWake.wait_until(lock, wake);
+    }
+}
+
+/**
+ * @brief Computed set for a subscriber, on its IO thread: send now, or keep only the newest
+ * @details Anything still queued on the socket means the subscriber is behind.
+ *          The set then waits in a single pending slot until onDrained(); a newer
+ *          set replaces it and the stale one is counted as dropped.
+ */
+void Server::deliverStream(const std::shared_ptr<ClientConnection> &conn, const FrameSet &frames)
+{
+    conn->stream.inflight = false;
+    if (conn->phase != STREAMING || !conn->stream.active)
+    {
+        return;
+    }
+    if (!frames || frames->empty())
+    {
+        conn->stream.dropped++;
+        return;
+    }
+    if (!conn->outq.empty())
+    {
+        if (conn->stream.pending)
+        {
+            conn->stream.dropped++;
+        }
+        conn->stream.pending = frames;
+        return;
+    }
+    sendStreamSet(conn, frames);
+}
+
+/**
+ * @brief Queue a MSG_STREAM_STATUS and every frame of the set in one gathered write
+ */
+void Server::sendStreamSet(const std::shared_ptr<ClientConnection> &conn, FrameSet frames)
+{
+    conn->frames = std::move(frames);
+    conn->stream.delivered++;
+
+    StreamStatus status = makeStreamStatus(conn->stream.delivered, conn->stream.dropped);
+    std::vector<uint8_t> header = buildMessage(MSG_STREAM_STATUS, WIRE_FLAG_STREAM, conn->stream.seq,
+                                               reinterpret_cast<const uint8_t *>(&status), sizeof(status));
+    std::vector<OutChunk> chunks;
+    for (size_t index = 0; index < conn->frames->size(); index++)
+    {
+        const EncodedFrame &frame = conn->frames->at(index);
+        appendFrameHeader(conn, index, header);
+        chunks.push_back(makeChunk(std::move(header)));
+        chunks.push_back(OutChunk{frame.data, frame.data->data(), frame.data->size()});
+        header.clear();
+    }
+    this->reactor->queue(conn, std::move(chunks));
+}
+
+/**
+ * @brief End of a pipelined batch: count the client's summary and finish the response
+ */
+void Server::finishBatch(const std::shared_ptr<ClientConnection> &conn, size_t received)
+{
+    this->batchesAcked++;
+    if (received < conn->frames->size())
+    {
+        this->batchFramesMissed += conn->frames->size() - received;
+    }
+    finishResponse(conn);
+}
+
+/**
+ * @brief Response fully sent (and acknowledged where required)
+ * @details Binary sessions go back to READ_REQUEST and pick up any request the
+ *          client already queued behind this one. Legacy connections are one-shot.
+ */
+void Server::finishResponse(const std::shared_ptr<ClientConnection> &conn)
+{
+    conn->frames.reset();
+    conn->nextFrame = 0;
+    conn->served++;
+
+    if (conn->protocol != PROTO_BINARY)
+    {
+        conn->phase = DONE;
+        this->reactor->closeWhenDrained(conn);
+        return;
+    }
+    conn->phase = READ_REQUEST;
+    if (!conn->inbuf.empty())
+    {
+        onWireData(conn);
+    }
+}
+
+/**
+ * @brief Append the per-frame header in the connection's protocol
+ * @details Legacy: int saturation index, size_t length. Binary: WireHeader
+ *          followed by FrameInfo, and the RegionInfo delivered when a region was
+ *          requested; the checksum was computed once by the leader.
+ */
+void Server::appendFrameHeader(const std::shared_ptr<ClientConnection> &conn, size_t index, std::vector<uint8_t> &header)
+{
+    const EncodedFrame &frame = conn->frames->at(index);
+    size_t img_buff_size = frame.data->size();
+
+    if (conn->protocol == PROTO_BINARY)
+    {
+        FrameInfo info = makeFrameInfo(index, conn->frames->size(), frame.color, frame.encoding, frame.planes);
+        bool region = frame.region.scale != 0;
+        size_t offset = header.size();
+        header.resize(offset + WIRE_HEADER_SIZE);
+        uint16_t flags = (conn->pipelined ? WIRE_FLAG_PIPELINE : 0) | (conn->phase == STREAMING ? WIRE_FLAG_STREAM : 0) |
+                         (region ? WIRE_FLAG_REGION : 0);
+        writeHeader(header.data() + offset, MSG_FRAME, flags, conn->phase == STREAMING ? conn->stream.seq : conn->seq,
+                    sizeof(FrameInfo) + (region ? sizeof(RegionInfo) : 0) + img_buff_size, frame.checksum);
+        appendValue(header, info);
+        if (region)
+        {
+            appendValue(header, makeRegionInfo(frame.region));
+        }
+        return;
+    }
+
+    // Integer Indicating Saturation Color, then Frame Size
+    appendValue(header, frame.color);
+    appendValue(header, img_buff_size);
+}
+
+/**
+ * @brief Queue the next frame of the response, or finish the response
+ * @details Each frame is the saturation index, the encoded size and the PNG
+ *          payload; the client acknowledges every frame before the next one.
+ *          Header and payload go out in one gathered write, the payload is
+ *          referenced (not copied) and large payloads are sent zero-copy.
+ * @param prefix Bytes to send ahead of the frame header in the same write
+ */
+void Server::sendFrame(const std::shared_ptr<ClientConnection> &conn, std::vector<uint8_t> prefix)
+{
+    if (conn->nextFrame >= conn->frames->size())
+    {
+        std::cout << "--------------------" << std::endl;
+        this->reactor->queue(conn, makeChunk(std::move(prefix)));
+        finishResponse(conn);
+        return;
+    }
+
+    const EncodedFrame &frame = conn->frames->at(conn->nextFrame);
+    size_t img_buff_size = frame.data->size();
+
+    std::vector<uint8_t> header(std::move(prefix));
+    appendFrameHeader(conn, conn->nextFrame, header);
+
+    // Send Frame to Client
+    this->reactor->queue(conn, std::vector<OutChunk>{makeChunk(std::move(header)),
+                                                     OutChunk{frame.data, frame.data->data(), img_buff_size}});
+
+    std::cout << "Filter: " << frame.color << std::endl;
+
+    conn->nextFrame++;
+    conn->phase = WAIT_ACK;
+}
+
+/**
+ * @brief Retrieve the latest camera frame from the shared capture stream
+ * @details The device is owned by the capture thread started in setupServer(),
+ *          so a request only copies the newest ring slot instead of opening
+ *          the camera. Falls back to default.png when no camera is available.
+ *          The requested region is cut out first, so denoise and the filters
+ *          only touch the pixels being delivered.
+ * @param mode Denoise applied to the capture, its latency is recorded per mode
+ * @param region Requested crop/downscale, scale 0 for the full frame; receives the geometry delivered
+ */
+cv::Mat Server::getCameraFrame(DenoiseMode mode, RegionInfo &region)
+{
+    cv::Mat img = this->buffers.acquire();
+    cv::Mat filtered = this->buffers.acquire();
+    const RegionInfo requested = region;
+
+    // Camera failed to open, send default.png
+    if (!this->camera.isOpened())
+    {
+        img = cv::imread("../assets/default.png");
+        if( img.empty() ) throw ServerException("Could not open default image", 0);
+        return requested.scale ? regionOf(img, region) : img;
+    }
+
+    // Only the requested region is copied (or converted) out of the capture ring
+    cv::Rect rect;
+    if( requested.scale ) {
+        rect = regionRectOf(this->camera.getFrameSize(), region);
+    }
+
+    // Take newest frame, or wait one frame period if none has been published yet
+    if (!this->camera.latestFrame(img, rect) && !this->camera.waitNextFrame(0, img, std::chrono::milliseconds(1000), rect))
+    {
+        img.release();
+    }
+
+    // Camera opened, but no image could be read
+    if( img.empty() ) {
+        img = cv::imread("../assets/default.png");
+        std::cerr << "Could not read frame from camera" << std::endl;
+        if( img.empty() ) throw ServerException("Could not open default image", 0);
+        region = requested;
+        return requested.scale ? regionOf(img, region) : img;
+    }
+
+    if( requested.scale ) {
+        cv::Mat scaled = this->buffers.acquire();
+        scaleRegion(img, region, scaled);
+        img = scaled;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    if (!denoiseFrame(img, filtered, mode, &this->buffers))
+    {
+        filtered.release();
+    }
+    auto micros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    this->denoiseFrames[mode]++;
+    this->denoiseMicros[mode] += micros;
+
+    // Image Read, but filtered could not be produced
+    if( filtered.empty() ){
+        img = cv::imread("../assets/default.png");
+        std::cerr << "Could not produce filtered frame" << std::endl;
+        if( img.empty() ) throw ServerException("Could not open default image", 0);
+        region = requested;
+        return requested.scale ? regionOf(img, region) : img;
+    }
+    return filtered;
+}
+
+/**
+ * @brief Cut a requested region out of a capture (see cropRegion)
+ * @throws ServerException If the origin is outside the capture or the scale is out of range
+ */
+cv::Mat Server::regionOf(const cv::Mat &capture, RegionInfo &region)
+{
+    cv::Mat crop = this->buffers.acquire();
+    scaleRegion(capture(regionRectOf(capture.size(), region)), region, crop);
+    return crop;
+}
+
+/**
+ * @brief Clamp a requested region to a capture of the given size (see regionRect)
+ * @throws ServerException If the origin is outside the capture or the scale is out of range
+ */
+cv::Rect Server::regionRectOf(cv::Size capture, RegionInfo &region)
+{
+    cv::Rect rect;
+    if( ! regionRect(capture, region, rect) ) {
+        throw ServerException(std::format("Region::ERROR: ({}, {}) at scale {}/{} does not fit the {}x{} capture", static_cast<int>(region.x),
+                                          static_cast<int>(region.y), static_cast<int>(region.scale), REGION_SCALE_ONE, capture.width, capture.height), 0);
+    }
+    return rect;
+}
+
+/**
+ * @brief Queue every frame of the response back-to-back
+ * @details Used when the client negotiated pipelining: there is no per-frame
+ *          acknowledgement, TCP provides flow control and the client sends a
+ *          single summary once the whole batch has arrived.
+ * @param prefix Bytes to send ahead of the first frame header
+ */
+void Server::sendBatch(const std::shared_ptr<ClientConnection> &conn, std::vector<uint8_t> prefix)
+{
+    std::vector<OutChunk> chunks;
+    std::vector<uint8_t> header(std::move(prefix));
+
+    for (size_t index = 0; index < conn->frames->size(); index++)
+    {
+        const EncodedFrame &frame = conn->frames->at(index);
+        size_t img_buff_size = frame.data->size();
+        appendFrameHeader(conn, index, header);
+        chunks.push_back(makeChunk(std::move(header)));
+        chunks.push_back(OutChunk{frame.data, frame.data->data(), img_buff_size});
+        header.clear();
+    }
+    if (!header.empty())
+    {
+        chunks.push_back(makeChunk(std::move(header)));
+    }
+    conn->nextFrame = conn->frames->size();
+    this->reactor->queue(conn, std::move(chunks));
+
+    // Nothing to acknowledge when the request could not be served
+    if (conn->frames->empty())
+    {
+        finishResponse(conn);
+        return;
+    }
+    conn->phase = WAIT_BATCH;
+}
+
+/**
+ * @brief Start transmitting a (possibly shared) frame set to one connection
+ * @details Runs on the connection's IO thread. An empty or missing frame set
+ *          means the request could not be served and is answered with zero frames.
+ */
+void Server::deliverFrames(const std::shared_ptr<ClientConnection> &conn, const FrameSet &frames)
+{
+    conn->frames = frames ? frames : std::make_shared<const std::vector<EncodedFrame>>();
+    conn->nextFrame = 0;
+
+    // Binary responses carry index/count in every frame, an empty response is an error
+    if (conn->protocol == PROTO_BINARY)
+    {
+        if (conn->frames->empty())
+        {
+            sendWireError(conn, conn->seq, "request could not be served");
+            finishResponse(conn);
+            return;
+        }
+        if (conn->multicast)
+        {
+            sendMulticastIndex(conn);
+            return;
+        }
+        if (conn->pipelined)
+        {
+            sendBatch(conn, {});
+            return;
+        }
+        sendFrame(conn);
+        return;
+    }
+
+    // Send Client Number of Frames to Accept, then first frame
+    int numberFrames(conn->frames->size());
+    std::vector<uint8_t> prefix;
+
+    // "roi"/"scale" requests first get the geometry delivered, framed like a request
+    if (numberFrames && conn->frames->front().region.scale)
+    {
+        const RegionInfo &region = conn->frames->front().region;
+        nlohmann::json geometry;
+        geometry["roi"] = {region.x, region.y, region.width, region.height};
+        geometry["scale"] = static_cast<double>(region.scale) / REGION_SCALE_ONE;
+        geometry["capture"] = {region.captureWidth, region.captureHeight};
+        std::string body = geometry.dump();
+        appendValue(prefix, body.size());
+        prefix.insert(prefix.end(), body.begin(), body.end());
+    }
+    if (conn->pipelined)
+    {
+        appendValue(prefix, numberFrames | PIPELINE_ACCEPTED);
+        sendBatch(conn, std::move(prefix));
+        return;
+    }
+    appendValue(prefix, numberFrames);
+    sendFrame(conn, std::move(prefix));
+}
+
+/**
+ * @brief Handle Client connections to the server.
+ * @details Runs on the compute stage as the leader of a coalesced flight:
+ *          capture, filter and encode once, then hand the same encoded buffers
+ *          to every request which joined the flight. Only the requested
+ *          filters are computed, each distinct one once, and the response
+ *          has one frame per filter in request order.
+ * @param key Flight being computed
+ * @param request Color matrices to be applied to the captured frame, its denoise and region
+ * @return Nothing
+ */
+void Server::client_handle(FlightKey key, CaptureRequest request) {
+    const std::vector<ColorMatrix> &filters = request.filters;
+    std::vector<cv::Mat> frames;
+    auto encoded = std::make_shared<std::vector<EncodedFrame>>();
+
+    try {
+        // A filter named more than once is computed and encoded once
+        std::vector<ColorMatrix> distinct;
+        std::vector<size_t> source;
+        for( const ColorMatrix& matrix : filters ) {
+            auto found = std::find(distinct.begin(), distinct.end(), matrix);
+            source.push_back(found - distinct.begin());
+            if( found == distinct.end() ) {
+                distinct.push_back(matrix);
+            }
+        }
+
+        // Retrieve Camera Image and Process into Frames
+        RegionInfo region = request.region;
+        cv::Mat img = getCameraFrame(request.denoise, region);
+        imageProc(img, distinct, frames, key.planes);
+
+        // Encode Frames concurrently
+        std::vector<std::shared_ptr<std::vector<uint8_t>>> images(frames.size());
+        std::vector<uint8_t> encodings(frames.size());
+        cv::parallel_for_(cv::Range(0, static_cast<int>(frames.size())), [&](const cv::Range &range) {
+            for( int i = range.start; i < range.end; i++ ) {
+                images[i] = this->buffers.acquireBytes(encodeBound(frames[i]));
+                encodings[i] = encodeImage( key.encoding == LOSSLESS_EXTENSION, frames[i], *images[i] );
+            }
+        }, static_cast<double>(frames.size()));
+
+        // One response frame per requested filter, in request order; checksum FrameInfo + payload once for every waiter
+        encoded->resize(filters.size());
+        cv::parallel_for_(cv::Range(0, static_cast<int>(filters.size())), [&](const cv::Range &range) {
+            for( int i = range.start; i < range.end; i++ ) {
+                const cv::Mat &pixels = frames[source[i]];
+                int band;
+                uint8_t planes = pixels.channels() == 1 ? filters[i].bandChannels(band) : 0;
+                EncodedFrame &frame = (*encoded)[i];
+                frame = {i, images[source[i]], 0, 0, planes, region, encodings[source[i]], pixels};
+                frame.checksum = frameChecksum(frame, i, filters.size());
+            }
+        }, static_cast<double>(filters.size()));
+
+        // Sent once to the group, every waiter is answered with the same frame ids
+        if( key.multicast && this->multicast ) {
+            for( EncodedFrame &frame : *encoded ) {
+                frame.multicastId = this->multicast->send(frame.color, frame.data);
+            }
+        }
+    }
+    catch( ServerException& exc ) {
+        std::cerr << "Server Exception: " << exc.what() << std::endl;
+        encoded->clear();
+    }
+    catch( std::exception& exc ) {
+        std::cerr << "Std::Exception: " << exc.what() << std::endl;
+        encoded->clear();
+    }
+
+    // Coalescing and queue figures are reported by the stats control message
+    this->inflight.complete(key, encoded);
+    return;
+}
+
+/**
+ * @brief Split Image into frames, one per filter.
+ * @details The kernels run tile-parallel on OpenCV's thread pool,
+ *          frames come back in filter order whatever the thread count.
+ * @param input Image to be processed by function call
+ * @param filters Color matrices to be applied to input, one output frame each
+ * @param ret_val The final results of processing will be written here
+ * @param planes Produce single-band filters as one 8-bit plane instead of a BGR frame
+ * @return bool indicating the success or failure of the operation
+ */
+bool Server::imageProc(const cv::Mat &input, const std::vector<ColorMatrix> &filters, std::vector<cv::Mat> &ret_val, bool planes)
+{
+
+    // Check input and filters are NOT EMPTY
+    // if (this->state != REQ_STAGE)
+    // {
+    //     throw ServerException(std::format("Image::Proc: In state ({}) when expected was REQ_STAGE(3)", this->state), 0);
+    // }
+    if (input.empty())
+    {
+        throw ServerException("ImageProc::ERROR: Passed input was empty", 0);
+    }
+    else if (!filters.size())
+    {
+        throw ServerException("ImageProc::ERROR: Filters array is empty", 0);
+    }
+
+    // Plane transport: single-band filters only need their band, the rest stay BGR frames
+    std::vector<ColorMatrix> bands, colors;
+    std::vector<bool> isPlane;
+    for (const ColorMatrix &matrix : filters)
+    {
+        int row;
+        isPlane.push_back(planes && matrix.bandChannels(row));
+        (isPlane.back() ? bands : colors).push_back(matrix);
+    }
+
+    // Sets which only keep or drop channels take the cheaper masking kernel
+    std::vector<Filter> masks;
+    for (const ColorMatrix &matrix : colors)
+    {
+        Filter mask;
+        if (!asChannelMask(matrix, mask))
+        {
+            break;
+        }
+        masks.push_back(mask);
+    }
+
+    // One fused pass over the input per kind of output, into pooled buffers
+    std::vector<cv::Mat> colorOutputs(colors.size(), this->buffers.acquire());
+    std::vector<cv::Mat> planeOutputs(bands.size(), this->buffers.acquire());
+    bool done = true;
+    if (!colors.empty())
+    {
+        done = masks.size() == colors.size() ? separateChannels(input, masks, colorOutputs)
+                                             : transformColors(input, colors, colorOutputs);
+    }
+    if (done && !bands.empty())
+    {
+        done = extractPlanes(input, bands, planeOutputs);
+    }
+    if (!done)
+    {
+        throw ServerException(std::format("ImageProc::ERROR: Expected an 8-bit BGR image (type {}) and in-range color matrices", input.type()), 0);
+    }
+
+    for (size_t i = 0, c = 0, p = 0; i < filters.size(); i++)
+    {
+        ret_val.push_back(isPlane[i] ? planeOutputs[p++] : colorOutputs[c++]);
+    }
+
+    // For each filter, apply to IMG and append to ret_val
+    // for( auto filt : filters ) {
+
+    // }
+    return true;
+}
+
+/**
+ * @brief Generates Filters from Request
+ * @details Accepts, in order of precedence:
+ *            "matrices": [[9 or 12 numbers], ...]  row-major 3x3 or 3x4 color matrices
+ *            "filters":  [[r, g, b], ...]          per-channel weights, 0-255
+ *            "frames":   [SatColor, ...]
+ * @param request the JSON object which contains the filters list
+ */
+std::vector<ColorMatrix> Server::buildFilterArray( nlohmann::json& request ) {
+    if( ! request.size() ) {
+        throw ServerException("FilterArr::ERROR: Passed request is of size 0", 0);
+    }
+
+    std::vector<ColorMatrix> filters;
+    if( request.contains("matrices") ) {
+        for( const std::vector<float>& values : request["matrices"].get<std::vector<std::vector<float>>>() ) {
+            if( values.size() != 9 && values.size() != 12 ) {
+                throw ServerException(std::format("FilterArr::ERROR: Color matrix has {} values, expected 9 or 12", values.size()), 0);
+            }
+            size_t cols = values.size() / 3;
+            ColorMatrix matrix{};
+            for( size_t i = 0; i < values.size(); i++ ) {
+                matrix.m[i / cols][i % cols] = values[i];
+            }
+            filters.push_back(matrix);
+        }
+    }
+    else if( request.contains("filters") ) {
+        for( const std::vector<int>& weights : request["filters"].get<std::vector<std::vector<int>>>() ) {
+            if( weights.size() != 3 || std::any_of(weights.begin(), weights.end(), [](int w) { return w < 0 || w > UINT8_MAX; }) ) {
+                throw ServerException("FilterArr::ERROR: Filter must be three weights from 0 to 255", 0);
+            }
+            filters.push_back(ColorMatrix::scale(weights[0], weights[1], weights[2]));
+        }
+    }
+    else if( request.contains("frames") ) {
+        filters = buildFilterArray( request["frames"].get<std::vector<int>>() );
+    }
+    else {
+        throw ServerException("FilterArr::ERROR: Passed request is missing frames attribute", 0);
+    }
+
+    if( filters.empty() || filters.size() > MAX_REQUEST_FILTERS ) {
+        throw ServerException(std::format("FilterArr::ERROR: Requested {} frames, expected 1 to {}", filters.size(), MAX_REQUEST_FILTERS), 0);
+    }
+    for( const ColorMatrix& matrix : filters ) {
+        if( ! matrix.inRange() ) {
+            throw ServerException("FilterArr::ERROR: Color matrix coefficient out of range", 0);
+        }
+    }
+    return filters;
+}
+
+/**
+ * @brief Generates Filters from a list of requested SatColor frames
+ * @param frames SatColor indices as sent by the client, one frame each
+ */
+std::vector<ColorMatrix> Server::buildFilterArray( const std::vector<int>& frames ) {
+    std::vector<ColorMatrix> filters;
+    for( int frame : frames ) {
+        switch( frame ) {
+        case SatColor::RED:
+            filters.push_back(ColorMatrix::scale(255, 0, 0));
+            break;
+        case SatColor::GREEN:
+            filters.push_back(ColorMatrix::scale(0, 255, 0));
+            break;
+        case SatColor::BLUE:
+            filters.push_back(ColorMatrix::scale(0, 0, 255));
+            break;
+        default:
+            throw ServerException(std::format("FilterArr::ERROR: Unknown frame color {}", frame), 0);
+        }
+    }
+    return filters;
+}
+
+/**
+ * @brief Reads a JSON capture request: the filters (see buildFilterArray), an
+ *        optional "denoise" mode name (the server default otherwise), and an
+ *        optional region:
+ *            "roi":   [x, y, width, height]  capture pixels, 0 width/height reach the edge
+ *            "scale": 0 < scale <= 1         output size relative to the crop
+ */
+CaptureRequest Server::buildCaptureRequest( nlohmann::json& request ) {
+    CaptureRequest capture{buildFilterArray( request ), this->denoise, {}};
+    if( request.contains("denoise") && ! parseDenoiseMode(request["denoise"].get<std::string>(), capture.denoise) ) {
+        throw ServerException(std::format("FilterArr::ERROR: Unknown denoise mode {}", request["denoise"].dump()), 0);
+    }
+    if( ! request.contains("roi") && ! request.contains("scale") ) {
+        return capture;
+    }
+
+    std::vector<int> roi = request.contains("roi") ? request["roi"].get<std::vector<int>>() : std::vector<int>{0, 0, 0, 0};
+    double scale = request.contains("scale") ? request["scale"].get<double>() : 1.0;
+    if( roi.size() != 4 || std::any_of(roi.begin(), roi.end(), [](int v) { return v < 0 || v > UINT16_MAX; }) ) {
+        throw ServerException(std::format("FilterArr::ERROR: \"roi\" must be 4 integers from 0 to {}", UINT16_MAX), 0);
+    }
+    if( ! (scale > 0.0 && scale <= 1.0) ) {
+        throw ServerException(std::format("FilterArr::ERROR: Scale {} is not within (0, 1]", scale), 0);
+    }
+    capture.region = RegionInfo{static_cast<uint16_t>(roi[0]), static_cast<uint16_t>(roi[1]), static_cast<uint16_t>(roi[2]),
+                                static_cast<uint16_t>(roi[3]), static_cast<uint16_t>(std::max(1L, std::lround(scale * REGION_SCALE_ONE))), 0, 0};
+    return capture;
+}
+
+/**
+ * @brief Decodes a binary capture request: u8 count, then count SatColor bytes,
+ *        or with WIRE_FLAG_COLOR_MATRIX count serialized color matrices, then
+ *        with WIRE_FLAG_DENOISE a u8 DenoiseMode, then with WIRE_FLAG_REGION a RegionInfo
+ * @throws ServerException If the payload is malformed or a matrix or the region is out of range
+ */
+CaptureRequest Server::parseCaptureRequest( const uint8_t *payload, size_t length, uint16_t flags ) {
+    size_t entry = (flags & WIRE_FLAG_COLOR_MATRIX) ? COLOR_MATRIX_WIRE_SIZE : 1;
+    size_t region = (flags & WIRE_FLAG_REGION) ? sizeof(RegionInfo) : 0;
+    size_t trailer = ((flags & WIRE_FLAG_DENOISE) ? 1 : 0) + region;
+    if( length < 1 + trailer || ! payload[0] || length != 1 + payload[0] * entry + trailer ) {
+        throw ServerException("FilterArr::ERROR: Malformed capture request", 0);
+    }
+
+    CaptureRequest capture{{}, this->denoise, {}};
+    if( flags & WIRE_FLAG_DENOISE ) {
+        uint8_t mode = payload[length - trailer];
+        if( mode >= DENOISE_MODES ) {
+            throw ServerException(std::format("FilterArr::ERROR: Unknown denoise mode {}", mode), 0);
+        }
+        capture.denoise = static_cast<DenoiseMode>(mode);
+    }
+    if( region ) {
+        capture.region = readRegionInfo(payload + length - region);
+        if( capture.region.scale == 0 || capture.region.scale > REGION_SCALE_ONE ) {
+            throw ServerException(std::format("FilterArr::ERROR: Region scale {}/{} is out of range", static_cast<int>(capture.region.scale), REGION_SCALE_ONE), 0);
+        }
+        capture.region.captureWidth = 0;
+        capture.region.captureHeight = 0;
+    }
+
+    if( ! (flags & WIRE_FLAG_COLOR_MATRIX) ) {
+        capture.filters = buildFilterArray( std::vector<int>(payload + 1, payload + 1 + payload[0]) );
+        return capture;
+    }
+
+    for( size_t i = 0; i < payload[0]; i++ ) {
+        capture.filters.push_back(readColorMatrix(payload + 1 + i * COLOR_MATRIX_WIRE_SIZE));
+        if( ! capture.filters.back().inRange() ) {
+            throw ServerException("FilterArr::ERROR: Color matrix coefficient out of range", 0);
+        }
+    }
+    return capture;
+}
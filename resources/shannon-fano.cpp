@@ -10,22 +10,23 @@ ShannonFano::ShannonFano(const std::map<char, double> &frequencies) : frequencie
     return;
 }
 
-void ShannonFano::encode() {
-
-}
-
-void ShannonFano::decode(const std::string &encoded) {
+std::string ShannonFano::decode(const std::string &encoded) const {
     std::string decoded;
     std::string currentCode;
 
     for( char c : encoded ) {
         currentCode += c;
-        if( this->reverseCodes.find(currentCode) != this->reverseCodes.end() ) {
-            decoded += this->reverseCodes[currentCode];
+        auto symbol = this->reverseCodes.find(currentCode);
+        if( symbol != this->reverseCodes.end() ) {
+            decoded += symbol->second;
             currentCode = "";
         }
     }
-    std::cout << "Decoded: " << decoded << std::endl;
+    return decoded;
+}
+
+void ShannonFano::printDecoded(const std::string &encoded) const {
+    std::cout << "Decoded: " << decode(encoded) << std::endl;
 }
 
 std::map<char, std::string> ShannonFano::getCodes() const {
@@ -104,3 +105,49 @@ void ShannonFano::buildCodesRecursive( std::vector<std::pair<char, double>> &fre
     buildCodesRecursive(freqs, code + "0", start, split - 1);
     buildCodesRecursive(freqs, code + "1", split, end);
 }
+
+/**
+ * @brief Shannon-Fano code lengths, symbols sorted by count (ties by byte value) and split recursively.
+ */
+int ShannonFano::buildLengths( const std::array<uint64_t, CODER_SYMBOLS> &counts, std::array<uint8_t, CODER_SYMBOLS> &lengths ) const {
+    std::vector<std::pair<uint8_t, uint64_t>> symbols;
+    for( int symbol = 0; symbol < CODER_SYMBOLS; symbol++ ) {
+        if( counts[symbol] ) {
+            symbols.emplace_back(static_cast<uint8_t>(symbol), counts[symbol]);
+        }
+    }
+
+    // Sort By Count, Greatest to Least
+    std::stable_sort(symbols.begin(), symbols.end(), [](const auto &a, const auto &b) {
+        return a.second > b.second;
+    });
+    return splitLengths(symbols, 0, symbols.size() - 1, 0, lengths);
+}
+
+/**
+ * @brief Gives symbols[start..end] their depth below a common prefix.
+ * @return Longest code length assigned
+ */
+int ShannonFano::splitLengths( const std::vector<std::pair<uint8_t, uint64_t>> &symbols, size_t start, size_t end, int depth, std::array<uint8_t, CODER_SYMBOLS> &lengths ) const {
+    if( start == end ) {
+        lengths[symbols[start].first] = static_cast<uint8_t>(depth);
+        return depth;
+    }
+
+    // Find the split point, the left half takes at least half the count
+    uint64_t total = 0;
+    for( size_t i = start; i <= end; i++ ) {
+        total += symbols[i].second;
+    }
+
+    uint64_t sum = 0;
+    size_t split = start;
+    while( split < end && sum * 2 < total ) {
+        sum += symbols[split].second;
+        split++;
+    }
+
+    int left = splitLengths(symbols, start, split - 1, depth + 1, lengths);
+    int right = splitLengths(symbols, split, end, depth + 1, lengths);
+    return std::max(left, right);
+}
@@ -0,0 +1,370 @@
+#include "v4l2-device.h"
+#include <algorithm>
+#include <cerrno>
+#include <cctype>
+#include <cstdio>
+#include <iostream>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <opencv4/opencv2/imgproc.hpp>
+#include <opencv4/opencv2/imgcodecs.hpp>
+
+namespace
+{
+    int xioctl(int fd, unsigned long request, void *arg)
+    {
+        int result;
+        do
+        {
+            result = ioctl(fd, request, arg);
+        } while (result < 0 && errno == EINTR);
+        return result;
+    }
+
+    // Capabilities of the opened node rather than of the whole driver
+    uint32_t deviceCaps(const v4l2_capability &caps)
+    {
+        return (caps.capabilities & V4L2_CAP_DEVICE_CAPS) ? caps.device_caps : caps.capabilities;
+    }
+
+    // Smallest rectangle around roi whose corners fall on multiples of (x, y)
+    cv::Rect alignOut(const cv::Rect &roi, int x, int y)
+    {
+        int left = roi.x / x * x;
+        int top = roi.y / y * y;
+        int right = (roi.x + roi.width + x - 1) / x * x;
+        int bottom = (roi.y + roi.height + y - 1) / y * y;
+        return cv::Rect(left, top, right - left, bottom - top);
+    }
+}
+
+bool parseCaptureSource(const std::string &spec, std::string &path, CaptureFormat &format)
+{
+    format = {V4L2_DEFAULT_FORMAT, V4L2_DEFAULT_WIDTH, V4L2_DEFAULT_HEIGHT, 0};
+    size_t colon = spec.find(':');
+    path = spec.substr(0, colon);
+    if (path.empty())
+    {
+        return false;
+    }
+    if (colon == std::string::npos)
+    {
+        return true;
+    }
+
+    std::string rest = spec.substr(colon + 1);
+    size_t next = rest.find(':');
+    std::string name = rest.substr(0, next);
+    for (char &c : name)
+    {
+        c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+    }
+    if (name == "YUYV")
+    {
+        format.pixelFormat = V4L2_PIX_FMT_YUYV;
+    }
+    else if (name == "NV12")
+    {
+        format.pixelFormat = V4L2_PIX_FMT_NV12;
+    }
+    else if (name == "MJPG" || name == "MJPEG")
+    {
+        format.pixelFormat = V4L2_PIX_FMT_MJPEG;
+    }
+    else
+    {
+        return false;
+    }
+    if (next == std::string::npos)
+    {
+        return true;
+    }
+
+    int width, height;
+    char extra;
+    if (std::sscanf(rest.c_str() + next + 1, "%dx%d%c", &width, &height, &extra) != 2 || width <= 0 || height <= 0)
+    {
+        return false;
+    }
+    format.width = width;
+    format.height = height;
+    return true;
+}
+
+std::string pixelFormatName(uint32_t pixelFormat)
+{
+    std::string name(4, ' ');
+    for (int i = 0; i < 4; i++)
+    {
+        name[i] = static_cast<char>((pixelFormat >> (8 * i)) & 0xFF);
+    }
+    return name;
+}
+
+bool convertCapture(const cv::Mat &raw, const CaptureFormat &format, const cv::Rect &roi, cv::Mat &bgr)
+{
+    const cv::Rect frame(0, 0, format.width, format.height);
+    const cv::Rect region = roi.area() ? roi : frame;
+    if (raw.empty() || (region & frame) != region)
+    {
+        return false;
+    }
+
+    // Converted straight from the driver buffer into the caller's allocator
+    cv::Mat full;
+    full.allocator = bgr.allocator;
+    switch (format.pixelFormat)
+    {
+    case V4L2_PIX_FMT_YUYV:
+    {
+        // Pixel pairs share their chroma, start on an even column
+        cv::Rect even = alignOut(region, 2, 1);
+        cv::cvtColor(raw(even), full, cv::COLOR_YUV2BGR_YUYV);
+        bgr = full(region - even.tl());
+        return true;
+    }
+    case V4L2_PIX_FMT_NV12:
+    {
+        // Chroma is shared by 2x2 blocks and stored as a half resolution plane after the luma
+        cv::Rect even = alignOut(region, 2, 2);
+        cv::Mat luma = raw.rowRange(0, format.height);
+        cv::Mat chroma(format.height / 2, format.width / 2, CV_8UC2, const_cast<uint8_t *>(raw.ptr<uint8_t>(format.height)), raw.step);
+        cv::cvtColorTwoPlane(luma(even), chroma(cv::Rect(even.x / 2, even.y / 2, even.width / 2, even.height / 2)), full,
+                             cv::COLOR_YUV2BGR_NV12);
+        bgr = full(region - even.tl());
+        return true;
+    }
+    case V4L2_PIX_FMT_MJPEG:
+        cv::imdecode(raw, cv::IMREAD_COLOR, &full);
+        if (full.size() != frame.size())
+        {
+            return false;
+        }
+        bgr = full(region);
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief Stops streaming and unmaps the buffers on destruction.
+ */
+V4l2Device::~V4l2Device()
+{
+    close();
+}
+
+/**
+ * @brief Opens a capture node, negotiates the format and starts streaming.
+ * @details The driver may round the resolution; a different pixel format is
+ *          refused rather than silently converted. Every buffer is queued to
+ *          the driver on return.
+ * @param path Device node, e.g. /dev/video0
+ * @param format Requested format, receives the negotiated resolution and stride
+ * @param count Buffers to request, the driver may grant more (at least V4L2_MIN_BUFFERS)
+ * @return false if the device cannot capture in that format or streaming fails
+ */
+bool V4l2Device::open(const std::string &path, CaptureFormat &format, size_t count)
+{
+    close();
+    auto fail = [&](const std::string &message)
+    {
+        std::cerr << "V4L2::ERROR: " << path << ": " << message << std::endl;
+        close();
+        return false;
+    };
+
+    this->fd = ::open(path.c_str(), O_RDWR | O_NONBLOCK);
+    if (this->fd < 0)
+    {
+        return fail("could not open device");
+    }
+
+    v4l2_capability caps{};
+    if (xioctl(this->fd, VIDIOC_QUERYCAP, &caps) < 0 || !(deviceCaps(caps) & V4L2_CAP_VIDEO_CAPTURE) ||
+        !(deviceCaps(caps) & V4L2_CAP_STREAMING))
+    {
+        return fail("not a streaming capture device");
+    }
+
+    v4l2_format fmt{};
+    fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    fmt.fmt.pix.width = format.width;
+    fmt.fmt.pix.height = format.height;
+    fmt.fmt.pix.pixelformat = format.pixelFormat;
+    fmt.fmt.pix.field = V4L2_FIELD_NONE;
+    if (xioctl(this->fd, VIDIOC_S_FMT, &fmt) < 0 || fmt.fmt.pix.pixelformat != format.pixelFormat)
+    {
+        return fail("does not offer " + pixelFormatName(format.pixelFormat));
+    }
+    format.width = fmt.fmt.pix.width;
+    format.height = fmt.fmt.pix.height;
+    format.stride = fmt.fmt.pix.bytesperline;
+    this->format = format;
+
+    v4l2_requestbuffers request{};
+    request.count = count;
+    request.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    request.memory = V4L2_MEMORY_MMAP;
+    if (xioctl(this->fd, VIDIOC_REQBUFS, &request) < 0 || request.count < V4L2_MIN_BUFFERS)
+    {
+        return fail("could not allocate mmap buffers");
+    }
+
+    for (uint32_t i = 0; i < request.count; i++)
+    {
+        v4l2_buffer buffer{};
+        buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buffer.memory = V4L2_MEMORY_MMAP;
+        buffer.index = i;
+        if (xioctl(this->fd, VIDIOC_QUERYBUF, &buffer) < 0)
+        {
+            return fail("could not query buffer");
+        }
+        void *start = mmap(nullptr, buffer.length, PROT_READ | PROT_WRITE, MAP_SHARED, this->fd, buffer.m.offset);
+        if (start == MAP_FAILED)
+        {
+            return fail("could not map buffer");
+        }
+        this->buffers.push_back({start, buffer.length});
+    }
+
+    for (size_t i = 0; i < this->buffers.size(); i++)
+    {
+        if (!queue(static_cast<int>(i)))
+        {
+            return fail("could not queue buffer");
+        }
+    }
+    int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (xioctl(this->fd, VIDIOC_STREAMON, &type) < 0)
+    {
+        return fail("could not start streaming");
+    }
+    return true;
+}
+
+/**
+ * @brief Stops streaming, unmaps and frees every buffer and closes the device.
+ */
+void V4l2Device::close()
+{
+    if (this->fd < 0)
+    {
+        return;
+    }
+
+    int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    xioctl(this->fd, VIDIOC_STREAMOFF, &type);
+    for (const Mapping &mapping : this->buffers)
+    {
+        munmap(mapping.start, mapping.length);
+    }
+    this->buffers.clear();
+
+    v4l2_requestbuffers request{};
+    request.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    request.memory = V4L2_MEMORY_MMAP;
+    xioctl(this->fd, VIDIOC_REQBUFS, &request);
+    ::close(this->fd);
+    this->fd = -1;
+}
+
+/**
+ * @brief Waits for the driver to fill a buffer and takes ownership of it.
+ * @param bytes Receives the bytes of frame data in the buffer
+ * @param timeout Longest wait for a frame
+ * @return Buffer index, -1 on timeout or if the frame was corrupt (the buffer is then requeued)
+ */
+int V4l2Device::dequeue(size_t &bytes, std::chrono::milliseconds timeout)
+{
+    pollfd ready{this->fd, POLLIN, 0};
+    if (poll(&ready, 1, static_cast<int>(timeout.count())) <= 0)
+    {
+        return -1;
+    }
+
+    v4l2_buffer buffer{};
+    buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buffer.memory = V4L2_MEMORY_MMAP;
+    if (xioctl(this->fd, VIDIOC_DQBUF, &buffer) < 0)
+    {
+        return -1;
+    }
+    if (buffer.flags & V4L2_BUF_FLAG_ERROR)
+    {
+        queue(buffer.index);
+        return -1;
+    }
+    bytes = buffer.bytesused;
+    return buffer.index;
+}
+
+bool V4l2Device::queue(int index)
+{
+    v4l2_buffer buffer{};
+    buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buffer.memory = V4L2_MEMORY_MMAP;
+    buffer.index = index;
+    return xioctl(this->fd, VIDIOC_QBUF, &buffer) == 0;
+}
+
+/**
+ * @brief Wraps a dequeued buffer as a matrix, for convertCapture().
+ * @details YUYV is CV_8UC2 of the frame size; NV12 is CV_8UC1 with the chroma
+ *          rows below the luma; MJPEG is the compressed bytes as one row.
+ * @return Empty if the buffer holds fewer bytes than a full frame
+ */
+cv::Mat V4l2Device::view(int index, size_t bytes) const
+{
+    const Mapping &mapping = this->buffers.at(index);
+    bytes = std::min(bytes, mapping.length);
+    switch (this->format.pixelFormat)
+    {
+    case V4L2_PIX_FMT_YUYV:
+        if (bytes < this->format.stride * this->format.height)
+        {
+            return cv::Mat();
+        }
+        return cv::Mat(this->format.height, this->format.width, CV_8UC2, mapping.start, this->format.stride);
+    case V4L2_PIX_FMT_NV12:
+        if (bytes < this->format.stride * this->format.height * 3 / 2)
+        {
+            return cv::Mat();
+        }
+        return cv::Mat(this->format.height * 3 / 2, this->format.width, CV_8UC1, mapping.start, this->format.stride);
+    default:
+        return bytes ? cv::Mat(1, static_cast<int>(bytes), CV_8UC1, mapping.start) : cv::Mat();
+    }
+}
+
+/**
+ * @brief Looks for a streaming capture node served by a driver.
+ * @param driver Driver name as reported by VIDIOC_QUERYCAP, e.g. "vivid"
+ * @return Device path, empty if no such device exists
+ */
+std::string V4l2Device::findDevice(const std::string &driver)
+{
+    for (int i = 0; i < 64; i++)
+    {
+        std::string path = "/dev/video" + std::to_string(i);
+        int node = ::open(path.c_str(), O_RDWR | O_NONBLOCK);
+        if (node < 0)
+        {
+            continue;
+        }
+        v4l2_capability caps{};
+        bool match = xioctl(node, VIDIOC_QUERYCAP, &caps) == 0 && driver == reinterpret_cast<const char *>(caps.driver) &&
+                     (deviceCaps(caps) & V4L2_CAP_VIDEO_CAPTURE) && (deviceCaps(caps) & V4L2_CAP_STREAMING);
+        ::close(node);
+        if (match)
+        {
+            return path;
+        }
+    }
+    return "";
+}
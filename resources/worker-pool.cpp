@@ -0,0 +1,209 @@
+#include "worker-pool.h"
+
+namespace
+{
+    // Identifies the pool / worker running on the current thread, for local submits
+    thread_local const WorkerPool *currentPool = nullptr;
+    thread_local size_t currentWorker = 0;
+}
+
+/**
+ * @brief Launches a fixed number of workers, each with its own deque.
+ * @param threads Number of threads, at least one is always created
+ * @param capacity Maximum number of queued jobs, 0 selects DEFAULT_QUEUE_PER_WORKER per thread
+ * @param policy What submit() does when the queue is full
+ */
+WorkerPool::WorkerPool(size_t threads, size_t capacity, OverflowPolicy policy)
+    : capacity(capacity), policy(policy), pending(0), running(true), nextQueue(0), peakPending(0),
+      submitted(0), rejected(0), completed(0), stolen(0), totalWaitUs(0), maxWaitUs(0)
+{
+    if (threads == 0)
+    {
+        threads = 1;
+    }
+    if (this->capacity == 0)
+    {
+        this->capacity = threads * DEFAULT_QUEUE_PER_WORKER;
+    }
+
+    for (size_t i = 0; i < threads; i++)
+    {
+        this->queues.push_back(std::make_unique<WorkerQueue>());
+    }
+    for (size_t i = 0; i < threads; i++)
+    {
+        this->workers.emplace_back(&WorkerPool::workerLoop, this, i);
+    }
+}
+
+/**
+ * @brief Drains outstanding jobs and joins every worker.
+ */
+WorkerPool::~WorkerPool()
+{
+    shutdown();
+}
+
+/**
+ * @brief Admits a job into the bounded queue.
+ * @param job Callable to run on a worker thread
+ * @return true if queued; false if the queue was full under REJECT_WHEN_FULL,
+ *         or the pool is shutting down
+ */
+bool WorkerPool::submit(std::function<void()> job)
+{
+    // Admission control, then the push, under one lock
+    {
+        std::unique_lock<std::mutex> lock(this->stateMutex);
+        if (this->policy == BLOCK_WHEN_FULL)
+        {
+            this->spaceFreed.wait(lock, [this]()
+                                  { return !this->running || this->pending < this->capacity; });
+        }
+        if (!this->running || this->pending >= this->capacity)
+        {
+            this->rejected++;
+            return false;
+        }
+
+        // The job is in a deque before pending announces it, so a woken worker always finds it.
+        // Jobs spawned by a worker stay local, external jobs are spread round-robin
+        size_t target = (currentPool == this) ? currentWorker : this->nextQueue++ % this->queues.size();
+        {
+            std::lock_guard<std::mutex> queueLock(this->queues.at(target)->mutex);
+            this->queues.at(target)->jobs.push_back({std::move(job), std::chrono::steady_clock::now(), target});
+        }
+        this->pending++;
+        this->peakPending = std::max(this->peakPending, this->pending);
+    }
+    this->submitted++;
+    this->jobReady.notify_one();
+    return true;
+}
+
+/**
+ * @brief Stops accepting work, lets queued jobs finish and joins the threads.
+ */
+void WorkerPool::shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->stateMutex);
+        if (!this->running)
+        {
+            return;
+        }
+        this->running = false;
+    }
+    this->jobReady.notify_all();
+    this->spaceFreed.notify_all();
+    for (auto &thr : this->workers)
+    {
+        if (thr.joinable())
+        {
+            thr.join();
+        }
+    }
+}
+
+/**
+ * @brief Snapshot of queue depth, throughput and wait-time counters.
+ */
+PoolStats WorkerPool::getStats()
+{
+    PoolStats stats{};
+    {
+        std::lock_guard<std::mutex> lock(this->stateMutex);
+        stats.queueDepth = this->pending;
+        stats.peakQueueDepth = this->peakPending;
+    }
+    stats.threads = this->workers.size();
+    stats.capacity = this->capacity;
+    stats.submitted = this->submitted.load();
+    stats.rejected = this->rejected.load();
+    stats.completed = this->completed.load();
+    stats.stolen = this->stolen.load();
+    stats.avgWaitMs = stats.completed ? (this->totalWaitUs.load() / 1000.0) / stats.completed : 0.0;
+    stats.maxWaitMs = this->maxWaitUs.load() / 1000.0;
+    return stats;
+}
+
+/**
+ * @brief Takes the oldest job from the worker's own deque, else steals the newest from a sibling.
+ */
+bool WorkerPool::popJob(size_t index, Job &job)
+{
+    {
+        WorkerQueue &own = *this->queues.at(index);
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.jobs.empty())
+        {
+            job = std::move(own.jobs.front());
+            own.jobs.pop_front();
+            return true;
+        }
+    }
+
+    for (size_t step = 1; step < this->queues.size(); step++)
+    {
+        WorkerQueue &victim = *this->queues.at((index + step) % this->queues.size());
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.jobs.empty())
+        {
+            job = std::move(victim.jobs.back());
+            victim.jobs.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Worker body: run local or stolen jobs, sleep while the whole pool is empty.
+ */
+void WorkerPool::workerLoop(size_t index)
+{
+    currentPool = this;
+    currentWorker = index;
+
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(this->stateMutex);
+            this->jobReady.wait(lock, [this]()
+                                { return !this->running || this->pending > 0; });
+            if (!this->running && this->pending == 0)
+            {
+                return;
+            }
+        }
+
+        Job job;
+        if (!popJob(index, job))
+        {
+            // Another worker took it between the wakeup and the pop
+            std::this_thread::yield();
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(this->stateMutex);
+            this->pending--;
+        }
+        this->spaceFreed.notify_one();
+
+        // Record queue wait
+        uint64_t waited = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - job.queued).count();
+        this->totalWaitUs += waited;
+        uint64_t seen = this->maxWaitUs.load();
+        while (waited > seen && !this->maxWaitUs.compare_exchange_weak(seen, waited))
+        {
+        }
+        if (job.owner != index)
+        {
+            this->stolen++;
+        }
+
+        job.fn();
+        this->completed++;
+    }
+}
@@ -0,0 +1,380 @@
+#include <iostream>
+#include <format>
+#include <chrono>
+#include <functional>
+#include <opencv4/opencv2/core.hpp>
+#include <opencv4/opencv2/imgcodecs.hpp>
+
+#include "camera.h"
+#include "image-kernels.h"
+#include "denoise.h"
+#include "entropy-coder.h"
+#include "lossless-codec.h"
+
+#define BENCH_ITERATIONS 20
+#define BENCH_REFERENCE_ITERATIONS 2 // The reference bilateral filter takes seconds per frame
+#define BENCH_RATIO_TARGET 1.10        // Compression a coder must reach to be picked for recorded frames
+
+/**
+ * @brief Per-filter copy, split, zero planes and merge, as imageProc did before the fused kernel.
+ */
+static void legacySeparate(const cv::Mat &input, const std::vector<Filter> &filters, std::vector<cv::Mat> &outputs)
+{
+    outputs.clear();
+    for (const Filter &filt : filters)
+    {
+        cv::Mat filteredImage;
+        input.copyTo(filteredImage);
+
+        std::vector<cv::Mat> channels(3);
+        cv::split(filteredImage, channels);
+        if (!filt._blu)
+            channels[0] = cv::Mat::zeros(channels[0].size(), channels[0].type());
+        if (!filt._grn)
+            channels[1] = cv::Mat::zeros(channels[1].size(), channels[1].type());
+        if (!filt._red)
+            channels[2] = cv::Mat::zeros(channels[2].size(), channels[2].type());
+        cv::merge(channels, filteredImage);
+        outputs.push_back(filteredImage);
+    }
+}
+
+/**
+ * @brief Straightforward per-pixel floating point color matrix, what a custom band costs without the kernel.
+ */
+static void naiveTransform(const cv::Mat &input, const std::vector<ColorMatrix> &matrices, std::vector<cv::Mat> &outputs)
+{
+    outputs.resize(matrices.size());
+    for (size_t k = 0; k < matrices.size(); k++)
+    {
+        const ColorMatrix &m = matrices[k];
+        outputs[k].create(input.size(), CV_8UC3);
+        for (int y = 0; y < input.rows; y++)
+        {
+            for (int x = 0; x < input.cols; x++)
+            {
+                cv::Vec3b in = input.at<cv::Vec3b>(y, x);
+                cv::Vec3b &out = outputs[k].at<cv::Vec3b>(y, x);
+                for (int c = 0; c < 3; c++)
+                {
+                    float value = m.m[c][0] * in[2] + m.m[c][1] * in[1] + m.m[c][2] * in[0] + m.m[c][3];
+                    out[2 - c] = cv::saturate_cast<uint8_t>(value);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Average milliseconds per call, after one warm-up call.
+ */
+static double timeMs(const std::function<void()> &body, int iterations = BENCH_ITERATIONS)
+{
+    body();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+    {
+        body();
+    }
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+/**
+ * @brief Bytes in and out and time spent coding a set of planes with one coder.
+ */
+struct CoderTotals
+{
+    size_t input = 0;
+    size_t output = 0;
+    double encodeMs = 0;
+    double decodeMs = 0;
+
+    double ratio() const { return static_cast<double>(input) / output; }
+};
+
+/**
+ * @brief Times entropy frames of every plane, table building and serialization included.
+ */
+static CoderTotals timeCoder(CoderId id, const std::vector<std::span<const uint8_t>> &planes)
+{
+    std::unique_ptr<EntropyCoder> coder = makeEntropyCoder(id);
+    CoderTotals totals;
+    for (std::span<const uint8_t> plane : planes)
+    {
+        std::vector<uint8_t> frame, decoded;
+        totals.encodeMs += timeMs([&]()
+                                  {
+                                      frame.clear();
+                                      packEntropyFrame(*coder, plane, frame); });
+        totals.decodeMs += timeMs([&]()
+                                  { unpackEntropyFrame(frame, decoded); });
+        totals.input += plane.size();
+        totals.output += frame.size();
+    }
+    return totals;
+}
+
+/**
+ * @brief One row per residual coder of the lossless codec, then PNG, for one image; ratios against the raw pixels.
+ */
+static void compareLossless(const std::string &name, const cv::Mat &image)
+{
+    const double megabytes = image.total() * image.elemSize() / 1e6;
+    for (int id = 0; id < CODERS; id++)
+    {
+        std::vector<uint8_t> container;
+        cv::Mat decoded;
+        double encodeMs = timeMs([&]()
+                                 {
+                                     container.clear();
+                                     encodeLossless(image, container, static_cast<CoderId>(id)); });
+        double decodeMs = timeMs([&]()
+                                 { decodeLossless(container, decoded); });
+        std::cout << std::format("{:<8}{:<14}{:>12.1f}{:>12.1f}{:>9.2f}x\n", name, std::format("voyl-{}", coderName(static_cast<CoderId>(id))),
+                                 megabytes / (encodeMs / 1000), megabytes / (decodeMs / 1000), megabytes * 1e6 / container.size());
+    }
+
+    std::vector<uchar> png;
+    double encodeMs = timeMs([&]()
+                             { cv::imencode(".png", image, png); }, BENCH_REFERENCE_ITERATIONS);
+    double decodeMs = timeMs([&]()
+                             { cv::imdecode(png, cv::IMREAD_UNCHANGED); }, BENCH_REFERENCE_ITERATIONS);
+    std::cout << std::format("{:<8}{:<14}{:>12.1f}{:>12.1f}{:>9.2f}x\n", name, "png", megabytes / (encodeMs / 1000),
+                             megabytes / (decodeMs / 1000), megabytes * 1e6 / png.size());
+}
+
+int main(int argc, char **argv)
+{
+    // Benchmark [ratio-target [frame.png ...]], frames default to the served default image
+    const double ratioTarget = argc > 1 ? std::stod(argv[1]) : BENCH_RATIO_TARGET;
+    std::vector<std::string> frames(argv + std::min(argc, 2), argv + argc);
+    if (frames.empty())
+    {
+        frames.push_back("../assets/default.png");
+    }
+
+    const std::vector<std::pair<std::string, cv::Size>> resolutions = {
+        {"720p", cv::Size(1280, 720)},
+        {"1080p", cv::Size(1920, 1080)},
+        {"4K", cv::Size(3840, 2160)}};
+    const std::vector<Filter> filters = {Filter(255, 0, 0), Filter(0, 255, 0), Filter(0, 0, 255)};
+    const std::vector<std::pair<std::string, KernelIsa>> kernels = {
+        {"scalar", ISA_SCALAR}, {"sse2", ISA_SSE2}, {"avx2", ISA_AVX2}};
+
+    std::cout << std::format("Channel separation, {} filters, {} iterations, best ISA: {}\n",
+                             filters.size(), BENCH_ITERATIONS, static_cast<int>(detectKernelIsa()));
+    std::cout << std::format("{:<8}{:<14}{:>12}{:>10}\n", "Size", "Kernel", "ms/frame", "Speedup");
+
+    for (const auto &[name, size] : resolutions)
+    {
+        cv::Mat input(size, CV_8UC3);
+        cv::randu(input, cv::Scalar::all(0), cv::Scalar::all(256));
+        std::vector<cv::Mat> outputs;
+
+        double legacy = timeMs([&]()
+                               { legacySeparate(input, filters, outputs); });
+        std::cout << std::format("{:<8}{:<14}{:>12.3f}{:>10}\n", name, "split/merge", legacy, "1.00x");
+
+        for (const auto &[kernel, isa] : kernels)
+        {
+            if (isa > detectKernelIsa())
+            {
+                continue;
+            }
+            double fused = timeMs([&]()
+                                  { separateChannels(input, filters, outputs, isa); });
+            std::cout << std::format("{:<8}{:<14}{:>12.3f}{:>9.2f}x\n", name, "fused-" + kernel, fused, legacy / fused);
+        }
+    }
+
+    // Custom bands: luma, a red/near-IR style ratio band and a false-color mix
+    const std::vector<ColorMatrix> matrices = {
+        {{{0.299f, 0.587f, 0.114f, 0.0f}, {0.299f, 0.587f, 0.114f, 0.0f}, {0.299f, 0.587f, 0.114f, 0.0f}}},
+        {{{1.5f, -0.5f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f, 0.0f}, {-0.25f, 0.0f, 1.25f, 16.0f}}},
+        {{{0.0f, 1.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 1.0f, 0.0f}, {1.0f, 0.0f, 0.0f, 0.0f}}}};
+    const std::vector<std::pair<std::string, KernelIsa>> transforms = {{"scalar", ISA_SCALAR}, {"sse4.1", ISA_SSE41}};
+
+    std::cout << std::format("\nColor matrix transform, {} matrices\n", matrices.size());
+    std::cout << std::format("{:<8}{:<14}{:>12}{:>10}\n", "Size", "Kernel", "ms/frame", "Speedup");
+
+    for (const auto &[name, size] : resolutions)
+    {
+        cv::Mat input(size, CV_8UC3);
+        cv::randu(input, cv::Scalar::all(0), cv::Scalar::all(256));
+        std::vector<cv::Mat> outputs;
+
+        double naive = timeMs([&]()
+                              { naiveTransform(input, matrices, outputs); });
+        std::cout << std::format("{:<8}{:<14}{:>12.3f}{:>10}\n", name, "naive-float", naive, "1.00x");
+
+        for (const auto &[kernel, isa] : transforms)
+        {
+            if (isa > detectKernelIsa())
+            {
+                continue;
+            }
+            double fixed = timeMs([&]()
+                                  { transformColors(input, matrices, outputs, isa); });
+            std::cout << std::format("{:<8}{:<14}{:>12.3f}{:>9.2f}x\n", name, "fixed-" + kernel, fixed, naive / fixed);
+        }
+    }
+
+    // Noisy capture: smooth gradient plus gaussian noise, what the denoise stage sees
+    std::cout << "\nDenoise\n";
+    std::cout << std::format("{:<8}{:<14}{:>12}{:>10}\n", "Size", "Mode", "ms/frame", "Speedup");
+    for (const auto &[name, size] : resolutions)
+    {
+        cv::Mat input(size, CV_32FC3), noise(size, CV_32FC3);
+        for (int y = 0; y < input.rows; y++)
+        {
+            input.row(y).setTo(cv::Scalar::all(255.0 * y / input.rows));
+        }
+        cv::randn(noise, cv::Scalar::all(0), cv::Scalar::all(8));
+        cv::add(input, noise, input);
+        input.convertTo(input, CV_8UC3);
+        cv::Mat output;
+
+        double reference = timeMs([&]()
+                                  { denoiseFrame(input, output, DENOISE_BILATERAL); }, BENCH_REFERENCE_ITERATIONS);
+        std::cout << std::format("{:<8}{:<14}{:>12.3f}{:>10}\n", name, denoiseName(DENOISE_BILATERAL), reference, "1.00x");
+        for (DenoiseMode mode : {DENOISE_GRID, DENOISE_GUIDED, DENOISE_PYRAMID, DENOISE_NONE})
+        {
+            double ms = timeMs([&]()
+                               { denoiseFrame(input, output, mode); });
+            std::cout << std::format("{:<8}{:<14}{:>12.3f}{:>9.1f}x\n", name, denoiseName(mode), ms, reference / std::max(ms, 1e-3));
+        }
+    }
+
+    // Compute stage of one request: fused filters, tiled digests, one PNG per output
+    const int threads = cv::getNumThreads();
+    std::cout << std::format("\nFrame set, {} filters, tiles of {} bytes\n", filters.size(), KERNEL_TILE_BYTES);
+    std::cout << std::format("{:<8}{:<14}{:>12}{:>10}\n", "Size", "Threads", "ms/frame", "Speedup");
+    for (const auto &[name, size] : resolutions)
+    {
+        cv::Mat input(size, CV_8UC3);
+        cv::randu(input, cv::Scalar::all(0), cv::Scalar::all(256));
+        std::vector<cv::Mat> outputs;
+        std::vector<std::vector<uchar>> buffers(filters.size());
+        auto frameSet = [&]()
+        {
+            separateChannels(input, filters, outputs);
+            for (const cv::Mat &output : outputs)
+            {
+                frameDigest(output);
+            }
+            cv::parallel_for_(cv::Range(0, static_cast<int>(outputs.size())), [&](const cv::Range &range)
+                              {
+                                  for (int i = range.start; i < range.end; i++)
+                                  {
+                                      cv::imencode(".png", outputs[i], buffers[i]);
+                                  }
+                              });
+        };
+
+        cv::setNumThreads(1);
+        double serial = timeMs(frameSet, BENCH_REFERENCE_ITERATIONS);
+        cv::setNumThreads(threads);
+        double parallel = timeMs(frameSet, BENCH_REFERENCE_ITERATIONS);
+        std::cout << std::format("{:<8}{:<14}{:>12.3f}{:>10}\n", name, 1, serial, "1.00x");
+        std::cout << std::format("{:<8}{:<14}{:>12.3f}{:>9.2f}x\n", name, threads, parallel, serial / parallel);
+    }
+
+    // Entropy coding of one band of a denoised capture, what a filtered output plane holds
+    std::vector<std::pair<std::string, cv::Mat>> captures;
+    std::cout << "\nEntropy coding, one plane\n";
+    std::cout << std::format("{:<8}{:<14}{:>12}{:>12}{:>10}\n", "Size", "Coder", "enc MB/s", "dec MB/s", "Ratio");
+    for (const auto &[name, size] : resolutions)
+    {
+        cv::Mat input(size, CV_32FC3), noise(size, CV_32FC3);
+        for (int y = 0; y < input.rows; y++)
+        {
+            input.row(y).setTo(cv::Scalar::all(255.0 * y / input.rows));
+        }
+        cv::randn(noise, cv::Scalar::all(0), cv::Scalar::all(8));
+        cv::add(input, noise, input);
+        input.convertTo(input, CV_8UC3);
+        cv::Mat denoised, plane;
+        denoiseFrame(input, denoised, DENOISE_GUIDED);
+        cv::extractChannel(denoised, plane, 2);
+
+        const std::span<const uint8_t> bytes(plane.ptr<uint8_t>(), plane.total());
+        const double megabytes = bytes.size() / 1e6;
+        for (int id = 0; id < CODERS; id++)
+        {
+            CoderTotals totals = timeCoder(static_cast<CoderId>(id), {bytes});
+            std::cout << std::format("{:<8}{:<14}{:>12.1f}{:>12.1f}{:>9.2f}x\n", name, coderName(static_cast<CoderId>(id)),
+                                     megabytes / (totals.encodeMs / 1000), megabytes / (totals.decodeMs / 1000), totals.ratio());
+        }
+
+        std::vector<uchar> png;
+        double encodeMs = timeMs([&]()
+                                 { cv::imencode(".png", plane, png); }, BENCH_REFERENCE_ITERATIONS);
+        double decodeMs = timeMs([&]()
+                                 { cv::imdecode(png, cv::IMREAD_UNCHANGED); }, BENCH_REFERENCE_ITERATIONS);
+        std::cout << std::format("{:<8}{:<14}{:>12.1f}{:>12.1f}{:>9.2f}x\n", name, "png", megabytes / (encodeMs / 1000),
+                                 megabytes / (decodeMs / 1000), static_cast<double>(bytes.size()) / png.size());
+        captures.emplace_back(name, denoised);
+    }
+
+    // Whole frames through the lossless codec, what WIRE_FLAG_LOSSLESS sessions receive instead of PNG
+    std::cout << "\nLossless codec, denoised BGR frame and its red plane\n";
+    std::cout << std::format("{:<8}{:<14}{:>12}{:>12}{:>10}\n", "Size", "Codec", "enc MB/s", "dec MB/s", "Ratio");
+    for (const auto &[name, denoised] : captures)
+    {
+        cv::Mat plane;
+        cv::extractChannel(denoised, plane, 2);
+        compareLossless(name, denoised);
+        compareLossless(name, plane);
+    }
+
+    // Every plane of the recorded frames, and the fastest coder meeting the ratio target
+    std::vector<cv::Mat> recorded, planes;
+    std::vector<std::span<const uint8_t>> spans;
+    for (const std::string &path : frames)
+    {
+        cv::Mat frame = cv::imread(path);
+        if (frame.empty())
+        {
+            std::cerr << "Could not read frame " << path << std::endl;
+            continue;
+        }
+        recorded.push_back(frame);
+        std::vector<cv::Mat> channels;
+        cv::split(frame, channels);
+        planes.insert(planes.end(), channels.begin(), channels.end());
+    }
+    for (const cv::Mat &plane : planes)
+    {
+        spans.emplace_back(plane.ptr<uint8_t>(), plane.total());
+    }
+    if (spans.empty())
+    {
+        return RETURN_OK;
+    }
+
+    std::cout << std::format("\nEntropy coding, {} planes of {} recorded frames, ratio target {:.2f}x\n", spans.size(), frames.size(), ratioTarget);
+    std::cout << std::format("{:<22}{:>12}{:>12}{:>10}\n", "Coder", "enc MB/s", "dec MB/s", "Ratio");
+    int pick = -1;
+    double pickMs = 0;
+    for (int id = 0; id < CODERS; id++)
+    {
+        CoderTotals totals = timeCoder(static_cast<CoderId>(id), spans);
+        const double megabytes = totals.input / 1e6;
+        std::cout << std::format("{:<22}{:>12.1f}{:>12.1f}{:>9.2f}x\n", coderName(static_cast<CoderId>(id)),
+                                 megabytes / (totals.encodeMs / 1000), megabytes / (totals.decodeMs / 1000), totals.ratio());
+        if (totals.ratio() >= ratioTarget && (pick < 0 || totals.encodeMs + totals.decodeMs < pickMs))
+        {
+            pick = id;
+            pickMs = totals.encodeMs + totals.decodeMs;
+        }
+    }
+    std::cout << "Fastest coder meeting the target: " << (pick < 0 ? "none" : coderName(static_cast<CoderId>(pick))) << std::endl;
+
+    std::cout << "\nLossless codec, recorded frames\n";
+    std::cout << std::format("{:<8}{:<14}{:>12}{:>12}{:>10}\n", "Frame", "Codec", "enc MB/s", "dec MB/s", "Ratio");
+    for (size_t i = 0; i < recorded.size(); i++)
+    {
+        compareLossless(std::to_string(i), recorded[i]);
+    }
+    return RETURN_OK;
+}
@@ -15,12 +15,13 @@ int main(int argc, char **argv)
     int port(39554);
 
     std::string ipAddress;
+    std::vector<int> colors{SatColor::RED, SatColor::GREEN, SatColor::BLUE};
     try {
 
         switch( argc ) {
             // User Passed NO Arguments to CLI
             case 1:
-                std::cerr << "usage: CamClient <ip-address> [port]" << std::endl;
+                std::cerr << "usage: CamClient <ip-address> [port] [frames, e.g. rgb or g]" << std::endl;
                 return RETURN_USR_ERR;
 
             // User Passed One Argument to CLI
@@ -38,22 +39,31 @@ int main(int argc, char **argv)
                 clientObject.setServerPort( port );
                 break;
 
+            // User also picked the frames, only those are computed
+            case 4:
+                ipAddress = argv[1];
+                port = std::stoi(argv[2]);
+                colors = Client::parseColors(argv[3]);
+                clientObject.setServerAddress( ipAddress );
+                clientObject.setServerPort( port );
+                break;
+
             // User likely passed more than 2 Arguments
             default:
-                std::cerr << "usage: CamClient <ip-address> [port]" << std::endl;
+                std::cerr << "usage: CamClient <ip-address> [port] [frames, e.g. rgb or g]" << std::endl;
                 return RETURN_USR_ERR;
         }
 
     // Client Exception Thrown
     } catch ( ClientException& exc ) {
         std::cerr << "Error: " << exc.what() << "\n";
-        std::cerr << "usage: CamClient <ip-address> [port]" << std::endl;
+        std::cerr << "usage: CamClient <ip-address> [port] [frames, e.g. rgb or g]" << std::endl;
     }  
 
     // Standard Exception thrown
     catch ( std::exception& exc ) {
         std::cerr << "Error: " << exc.what() << "\n";
-        std::cerr << "usage: CamClient <ip-address> [port]" << std::endl;
+        std::cerr << "usage: CamClient <ip-address> [port] [frames, e.g. rgb or g]" << std::endl;
     }
 
     std::cout << std::format("Server Address: {}\n", clientObject.getServerAddress() );
@@ -61,8 +71,11 @@ int main(int argc, char **argv)
 
     try
     {
+        // Single-band frames travel as one plane and are re-tinted locally, coded losslessly in place of PNG
+        clientObject.setPlaneTransport(true);
+        clientObject.setLosslessCodec(true);
         clientObject.connectToServer();
-        clientObject.sendRequestSrv();
+        clientObject.sendRequestSrv(colors);
     }
     catch (std::exception &exc)
     {
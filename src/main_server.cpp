@@ -15,7 +15,7 @@ int main(int argc, char **argv)
     try {
         switch( argc ) {
             case 1:
-                std::cerr << "usage: CamServer <ip-address> [port]" << std::endl;
+                std::cerr << "usage: CamServer <ip-address> [port] [device[:YUYV|NV12|MJPG[:WxH]]]" << std::endl;
                 return RETURN_USR_ERR;
                 break;
             
@@ -33,10 +33,19 @@ int main(int argc, char **argv)
                 serverObject.setListeningAddress(ipAddress);
                 serverObject.setListeningPort(port);
                 break;
+
+            // User enters IP, PORT and a V4L2 capture source
+            case 4:
+                ipAddress = argv[1];
+                port = std::stoi(argv[2]);
+                serverObject.setListeningAddress(ipAddress);
+                serverObject.setListeningPort(port);
+                serverObject.setCaptureSource(argv[3]);
+                break;
                 
             // Default Case
             default:
-                std::cerr << "usage: CamServer <ip-address> [port]" << std::endl;
+                std::cerr << "usage: CamServer <ip-address> [port] [device[:YUYV|NV12|MJPG[:WxH]]]" << std::endl;
                 return RETURN_USR_ERR;
                 break;
 
@@ -13,6 +13,12 @@
 #include "shannon-fano.h"
 #include "camera.h"
 #include "client.h"
+#include "worker-pool.h"
+#include "buffer-pool.h"
+#include "single-flight.h"
+#include "image-kernels.h"
+#include "denoise.h"
+#include "capture.h"
 // #include "md5.h"
 
 std::string convertHashToString(const uint8_t *digest);
@@ -325,6 +331,374 @@ TEST(SFComp, SFComp_SingleChar)
     EXPECT_EQ(frequencies['a'], 1.0);
 }
 
+TEST(SFComp, SFComp_Encode_Bit_Packed)
+{
+    ShannonFano sf;
+    const std::string text = "aaaabbc";
+    const std::vector<uint8_t> input(text.begin(), text.end());
+    EXPECT_ANY_THROW(sf.buildTable(std::span<const uint8_t>()));
+    sf.buildTable(input);
+
+    // a: 0, b: 10, c: 11 -> 0000 10 10 11, zero padded
+    EXPECT_EQ(sf.getTable()['a'].length, 1);
+    EXPECT_EQ(sf.getTable()['c'].bits, 3u);
+    std::vector<uint8_t> packed;
+    EXPECT_EQ(sf.encode(input, packed), 10u);
+    EXPECT_EQ(packed, (std::vector<uint8_t>{0x0A, 0xC0}));
+
+    // Appends, and refuses bytes outside the table
+    EXPECT_EQ(sf.encode(std::vector<uint8_t>{'a', 'c'}, packed), 3u);
+    EXPECT_EQ(packed.size(), 3u);
+    EXPECT_ANY_THROW(sf.encode(std::vector<uint8_t>{'d'}, packed));
+    EXPECT_EQ(packed.size(), 3u);
+}
+
+TEST(SFComp, SFComp_Table_Is_Prefix_Free_And_Bounded)
+{
+    // Doubling counts would need a code per symbol count, deeper than PREFIX_MAX_CODE_BITS
+    std::vector<uint8_t> input;
+    for (int symbol = 0; symbol < 26; symbol++)
+    {
+        input.insert(input.end(), size_t(1) << symbol, static_cast<uint8_t>(symbol));
+    }
+    ShannonFano sf;
+    sf.buildTable(input);
+
+    double kraft = 0;
+    for (const SymbolCode &code : sf.getTable())
+    {
+        EXPECT_LE(code.length, PREFIX_MAX_CODE_BITS);
+        kraft += code.length ? std::ldexp(1.0, -code.length) : 0.0;
+    }
+    EXPECT_DOUBLE_EQ(kraft, 1.0);
+    for (int symbol = 0; symbol < 26; symbol++)
+    {
+        ASSERT_GT(sf.getTable()[symbol].length, 0);
+        for (int other = 0; other < symbol; other++)
+        {
+            SymbolCode a = sf.getTable()[symbol], b = sf.getTable()[other];
+            uint8_t shorter = std::min(a.length, b.length);
+            EXPECT_NE(a.bits >> (a.length - shorter), b.bits >> (b.length - shorter));
+        }
+    }
+}
+
+TEST(SFComp, SFComp_Decode_Round_Trip)
+{
+    // Geometric bytes, like residuals: short codes for the common values, long ones for the tail
+    cv::RNG rng(7);
+    std::vector<uint8_t> input(1 << 16);
+    for (uint8_t &byte : input)
+    {
+        byte = static_cast<uint8_t>(std::min(255.0, std::floor(std::log(1.0 - rng.uniform(0.0, 1.0)) / std::log(0.9))));
+    }
+    ShannonFano sf;
+    sf.buildTable(input);
+    std::vector<uint8_t> packed, output(input.size());
+    sf.encode(input, packed);
+    ASSERT_TRUE(sf.decode(packed, output));
+    EXPECT_EQ(output, input);
+
+    // Runs out of bits
+    packed.pop_back();
+    EXPECT_FALSE(sf.decode(packed, output));
+    EXPECT_TRUE(sf.decode(packed, std::span<uint8_t>()));
+}
+
+TEST(SFComp, SFComp_Decode_Long_Codes)
+{
+    // Doubling counts give codes past PREFIX_LOOKUP_BITS, decoded through secondary tables
+    std::vector<uint8_t> input;
+    for (int symbol = 0; symbol < 16; symbol++)
+    {
+        input.insert(input.end(), size_t(1) << symbol, static_cast<uint8_t>(symbol * 7));
+    }
+    cv::randShuffle(input);
+    ShannonFano sf;
+    sf.buildTable(input);
+    EXPECT_GT(sf.getTable()[0].length, PREFIX_LOOKUP_BITS);
+    std::vector<uint8_t> packed, output(input.size());
+    sf.encode(input, packed);
+    ASSERT_TRUE(sf.decode(packed, output));
+    EXPECT_EQ(output, input);
+
+    // A lone symbol leaves half the code space unused
+    const std::vector<uint8_t> single(5, 'q');
+    sf.buildTable(single);
+    packed.clear();
+    sf.encode(single, packed);
+    output.assign(5, 0);
+    ASSERT_TRUE(sf.decode(packed, output));
+    EXPECT_EQ(output, single);
+    EXPECT_FALSE(sf.decode(std::vector<uint8_t>{0xFF}, output));
+}
+
+TEST(SFComp, SFComp_Canonical_Table_Serialization)
+{
+    // Bell shaped plane histogram, every byte value in use
+    cv::RNG rng(11);
+    std::vector<uint8_t> input(1 << 18);
+    for (uint8_t &byte : input)
+    {
+        byte = cv::saturate_cast<uint8_t>(128 + rng.gaussian(40));
+    }
+    ShannonFano encoder, decoder;
+    encoder.buildTable(input);
+    std::vector<uint8_t> table;
+    encoder.writeTable(table);
+    EXPECT_LT(table.size(), 96u);
+
+    // The lengths alone rebuild identical codes
+    ASSERT_EQ(decoder.readTable(table), table.size());
+    EXPECT_EQ(decoder.getLengths(), encoder.getLengths());
+    for (int symbol = 0; symbol < CODER_SYMBOLS; symbol++)
+    {
+        EXPECT_EQ(decoder.getTable()[symbol].bits, encoder.getTable()[symbol].bits);
+    }
+    std::vector<uint8_t> packed, output(input.size());
+    encoder.encode(input, packed);
+    ASSERT_TRUE(decoder.decode(packed, output));
+    EXPECT_EQ(output, input);
+
+    // Sparse tables are mostly runs
+    const std::string text = "aaaabbc";
+    encoder.buildTable(std::vector<uint8_t>(text.begin(), text.end()));
+    table.clear();
+    encoder.writeTable(table);
+    EXPECT_LE(table.size(), 12u);
+
+    // Truncated or not a prefix code
+    EXPECT_EQ(decoder.readTable(std::span<const uint8_t>(table.data(), 2)), 0u);
+    std::array<uint8_t, CODER_SYMBOLS> lengths{};
+    EXPECT_FALSE(decoder.setLengths(lengths));
+    lengths[0] = lengths[1] = lengths[2] = 1;
+    EXPECT_FALSE(decoder.setLengths(lengths));
+    lengths[2] = 0;
+    EXPECT_TRUE(decoder.setLengths(lengths));
+}
+
+/* Test Entropy Coders */
+TEST(EntropyCoder, Frames_Round_Trip_With_Every_Coder)
+{
+    cv::RNG rng(12);
+    std::vector<uint8_t> plane(1 << 16), single(1000, 7);
+    for (uint8_t &byte : plane)
+    {
+        byte = cv::saturate_cast<uint8_t>(128 + rng.gaussian(20));
+    }
+    for (int id = 0; id < CODERS; id++)
+    {
+        std::unique_ptr<EntropyCoder> coder = makeEntropyCoder(static_cast<CoderId>(id));
+        ASSERT_NE(coder, nullptr);
+        for (const std::vector<uint8_t> &input : {plane, single})
+        {
+            std::vector<uint8_t> frame, output;
+            packEntropyFrame(*coder, input, frame);
+            EXPECT_EQ(frame[0], id);
+            ASSERT_EQ(unpackEntropyFrame(frame, output), frame.size()) << coderName(coder->id());
+            EXPECT_EQ(output, input) << coderName(coder->id());
+
+            // Truncated anywhere
+            for (size_t length : {size_t(0), size_t(ENTROPY_FRAME_HEADER), frame.size() / 2, frame.size() - 1})
+            {
+                EXPECT_EQ(unpackEntropyFrame(std::span<const uint8_t>(frame.data(), length), output), 0u);
+            }
+        }
+        EXPECT_THROW(coder->buildTable({}), std::invalid_argument);
+    }
+
+    // Unknown coder
+    std::vector<uint8_t> frame, output;
+    HuffmanCoder huffman;
+    packEntropyFrame(huffman, plane, frame);
+    frame[0] = CODERS;
+    EXPECT_EQ(unpackEntropyFrame(frame, output), 0u);
+    EXPECT_EQ(makeEntropyCoder(CODERS), nullptr);
+}
+
+TEST(EntropyCoder, Huffman_Is_Optimal)
+{
+    // Textbook counts, the optimal code takes 224 bits
+    const std::vector<std::pair<char, int>> counts = {{'a', 45}, {'b', 13}, {'c', 12}, {'d', 16}, {'e', 9}, {'f', 5}};
+    std::vector<uint8_t> input;
+    for (const auto &[symbol, count] : counts)
+    {
+        input.insert(input.end(), count, symbol);
+    }
+    HuffmanCoder huffman;
+    ShannonFano shannonFano;
+    huffman.buildTable(input);
+    shannonFano.buildTable(input);
+    std::vector<uint8_t> packed;
+    EXPECT_EQ(huffman.encode(input, packed), 224u);
+    EXPECT_LE(huffman.encode(input, packed), shannonFano.encode(input, packed));
+}
+
+TEST(EntropyCoder, Tans_Approaches_Entropy)
+{
+    // Skewed source: one value most of the time, where a prefix code spends at least a bit per byte
+    cv::RNG rng(13);
+    std::vector<uint8_t> input(1 << 18);
+    std::array<uint64_t, CODER_SYMBOLS> counts{};
+    for (uint8_t &byte : input)
+    {
+        byte = rng.uniform(0.0, 1.0) < 0.9 ? 0 : static_cast<uint8_t>(rng.uniform(1, 16));
+        counts[byte]++;
+    }
+    double entropy = 0;
+    for (uint64_t count : counts)
+    {
+        if (count)
+        {
+            double p = static_cast<double>(count) / input.size();
+            entropy -= count * std::log2(p);
+        }
+    }
+
+    std::vector<uint8_t> tans, huffman, output;
+    TansCoder tansCoder;
+    HuffmanCoder huffmanCoder;
+    packEntropyFrame(tansCoder, input, tans);
+    packEntropyFrame(huffmanCoder, input, huffman);
+    EXPECT_LT(tans.size(), entropy / 8 * 1.02);
+    EXPECT_LT(tans.size(), huffman.size());
+    ASSERT_EQ(unpackEntropyFrame(tans, output), tans.size());
+    EXPECT_EQ(output, input);
+}
+
+TEST(EntropyCoder, Coder_Names_Round_Trip)
+{
+    for (int id = 0; id < CODERS; id++)
+    {
+        CoderId parsed;
+        ASSERT_TRUE(parseCoderName(coderName(static_cast<CoderId>(id)), parsed));
+        EXPECT_EQ(parsed, id);
+    }
+    CoderId parsed;
+    EXPECT_FALSE(parseCoderName("lzw", parsed));
+}
+
+/* Lossless Codec */
+/**
+ * @brief Vertical gradient with gaussian noise, roughly what a filtered capture plane holds.
+ */
+static cv::Mat noisyGradient(int rows, int cols, int type, double sigma, uint64_t seed)
+{
+    cv::RNG rng(seed);
+    cv::Mat image(rows, cols, type);
+    for (int y = 0; y < rows; y++)
+    {
+        uint8_t *row = image.ptr<uint8_t>(y);
+        for (int x = 0; x < cols * image.channels(); x++)
+        {
+            row[x] = cv::saturate_cast<uint8_t>(255.0 * y / rows + 0.1 * (x / image.channels()) + rng.gaussian(sigma));
+        }
+    }
+    return image;
+}
+
+TEST(LosslessCodec, Round_Trip_With_Every_Coder)
+{
+    cv::Mat gray = noisyGradient(300, 257, CV_8UC1, 3, 21);
+    cv::Mat bgr = noisyGradient(300, 257, CV_8UC3, 3, 22);
+    const std::vector<cv::Mat> images = {
+        gray, bgr, gray(cv::Rect(0, 0, 1, 1)), bgr(cv::Rect(5, 7, 1, 1)),
+        gray(cv::Rect(3, 0, 200, 1)), bgr(cv::Rect(0, 2, 1, 290)),
+        gray(cv::Rect(13, 9, 101, 150)), bgr(cv::Rect(1, 140, 255, 129)),
+        cv::Mat(40, 33, CV_8UC3, cv::Scalar(9, 200, 77))};
+    for (int id = 0; id < CODERS; id++)
+    {
+        for (const cv::Mat &image : images)
+        {
+            std::vector<uint8_t> container;
+            cv::Mat decoded;
+            ASSERT_TRUE(encodeLossless(image, container, static_cast<CoderId>(id)));
+            EXPECT_TRUE(isLosslessImage(container));
+            ASSERT_TRUE(decodeLossless(container, decoded)) << coderName(static_cast<CoderId>(id)) << " " << image.cols << "x" << image.rows;
+            ASSERT_EQ(decoded.type(), image.type());
+            ASSERT_EQ(decoded.size(), image.size());
+            EXPECT_EQ(cv::norm(decoded, image, cv::NORM_INF), 0) << coderName(static_cast<CoderId>(id)) << " " << image.cols << "x" << image.rows;
+        }
+    }
+
+    // Appended to what the buffer already holds
+    std::vector<uint8_t> container = {1, 2, 3};
+    ASSERT_TRUE(encodeLossless(gray, container));
+    cv::Mat decoded;
+    EXPECT_TRUE(decodeLossless(std::span<const uint8_t>(container).subspan(3), decoded));
+
+    EXPECT_FALSE(encodeLossless(cv::Mat(), container));
+    EXPECT_FALSE(encodeLossless(cv::Mat(8, 8, CV_32FC1), container));
+    EXPECT_FALSE(encodeLossless(cv::Mat(8, 8, CV_8UC2), container));
+}
+
+TEST(LosslessCodec, Rejects_Truncated_And_Corrupt_Input)
+{
+    cv::Mat image = noisyGradient(200, 150, CV_8UC3, 4, 23);
+    std::vector<uint8_t> container;
+    ASSERT_TRUE(encodeLossless(image, container));
+
+    cv::Mat decoded;
+    for (size_t length : {size_t(0), size_t(4), size_t(LOSSLESS_HEADER), container.size() / 2, container.size() - 1})
+    {
+        EXPECT_FALSE(decodeLossless(std::span<const uint8_t>(container.data(), length), decoded)) << length;
+    }
+
+    // Header fields out of range
+    for (size_t offset : {size_t(4), size_t(5), size_t(6), size_t(10), size_t(11)})
+    {
+        std::vector<uint8_t> corrupt = container;
+        corrupt[offset] = 0xFF;
+        EXPECT_FALSE(decodeLossless(corrupt, decoded)) << offset;
+    }
+
+    // Payload damage is caught by the entropy frames or the slice sizes, never read past the input
+    cv::RNG rng(24);
+    for (int trial = 0; trial < 50; trial++)
+    {
+        std::vector<uint8_t> corrupt = container;
+        size_t offset = rng.uniform(LOSSLESS_HEADER, static_cast<int>(corrupt.size()));
+        corrupt[offset] ^= static_cast<uint8_t>(rng.uniform(1, 256));
+        cv::Mat damaged;
+        if (decodeLossless(corrupt, damaged))
+        {
+            EXPECT_EQ(damaged.size(), image.size());
+        }
+    }
+}
+
+TEST(LosslessCodec, Told_Apart_From_PNG)
+{
+    cv::Mat image = noisyGradient(32, 32, CV_8UC1, 2, 25);
+    std::vector<uint8_t> container, png;
+    ASSERT_TRUE(encodeLossless(image, container));
+    cv::imencode(".png", image, png);
+    EXPECT_TRUE(isLosslessImage(container));
+    EXPECT_FALSE(isLosslessImage(png));
+    EXPECT_FALSE(isLosslessImage({}));
+
+    cv::Mat decoded;
+    EXPECT_FALSE(decodeLossless(png, decoded));
+}
+
+TEST(LosslessCodec, Smaller_Than_PNG_On_Noisy_Frames)
+{
+    for (int type : {CV_8UC1, CV_8UC3})
+    {
+        cv::Mat image = noisyGradient(480, 640, type, 1, 26);
+        std::vector<uint8_t> container, png;
+        ASSERT_TRUE(encodeLossless(image, container));
+        cv::imencode(".png", image, png);
+        EXPECT_LT(container.size(), png.size()) << image.channels() << " channel(s)";
+    }
+}
+
+TEST(LosslessCodec, Predictor_Names)
+{
+    EXPECT_STREQ(predictorName(PREDICT_PAETH), "paeth");
+    EXPECT_STREQ(predictorName(PREDICT_MED), "med");
+}
+
 /* Test JSON Serialization */
 TEST(JSON, Generic_JSON_Serialization)
 {
@@ -430,6 +804,727 @@ TEST(Client_setServerPort, Invalid_Addresses)
     EXPECT_ANY_THROW(clientObject.setServerPort(65536));
 }
 
+/* Binary Wire Protocol */
+TEST(Protocol, CRC32_Known_Value)
+{
+    std::string input = "123456789";
+    EXPECT_EQ(crc32(reinterpret_cast<const uint8_t *>(input.data()), input.size()), 0xCBF43926u);
+
+    // Checksumming in pieces matches one pass
+    uint32_t whole = crc32(reinterpret_cast<const uint8_t *>(input.data()), input.size());
+    uint32_t parts = crc32(reinterpret_cast<const uint8_t *>(input.data()), 4);
+    parts = crc32(reinterpret_cast<const uint8_t *>(input.data()) + 4, input.size() - 4, parts);
+    EXPECT_EQ(whole, parts);
+}
+
+TEST(Protocol, Header_Round_Trip)
+{
+    uint8_t payload[] = {3, SatColor::RED, SatColor::GREEN, SatColor::BLUE};
+    std::vector<uint8_t> message = buildMessage(MSG_CAPTURE_REQUEST, WIRE_FLAG_PIPELINE, 42, payload, sizeof(payload));
+    WireHeader header;
+
+    EXPECT_EQ(message.size(), WIRE_HEADER_SIZE + sizeof(payload));
+    EXPECT_TRUE(isWireMessage(message.data(), message.size()));
+    EXPECT_EQ(parseHeader(message.data(), message.size(), header), WIRE_OK);
+    EXPECT_EQ(header.type, MSG_CAPTURE_REQUEST);
+    EXPECT_EQ(header.flags, WIRE_FLAG_PIPELINE);
+    EXPECT_EQ(header.seq, 42u);
+    EXPECT_EQ(header.length, sizeof(payload));
+
+    // Network byte order on the wire
+    EXPECT_EQ(message.at(0), 'V');
+    EXPECT_EQ(message.at(11), 42);
+}
+
+TEST(Protocol, Header_Rejects_Invalid)
+{
+    uint8_t payload[] = {1, 2, 3, 4};
+    std::vector<uint8_t> message = buildMessage(MSG_ACK, 0, 1, payload, sizeof(payload));
+    WireHeader header;
+
+    EXPECT_EQ(parseHeader(message.data(), WIRE_HEADER_SIZE - 1, header), WIRE_INCOMPLETE);
+    EXPECT_EQ(parseHeader(message.data(), message.size() - 1, header), WIRE_INCOMPLETE);
+    EXPECT_EQ(parseHeader(message.data(), message.size(), header, 2), WIRE_TOO_LARGE);
+
+    message.back() ^= 0xFF;
+    EXPECT_EQ(parseHeader(message.data(), message.size(), header), WIRE_BAD_CHECKSUM);
+
+    message.at(4) = WIRE_VERSION + 1;
+    EXPECT_EQ(parseHeader(message.data(), message.size(), header), WIRE_BAD_VERSION);
+
+    // A legacy size_t prefixed JSON request is never mistaken for a wire message
+    size_t legacySize = 96;
+    EXPECT_FALSE(isWireMessage(reinterpret_cast<const uint8_t *>(&legacySize), sizeof(legacySize)));
+}
+
+TEST(Protocol, FrameInfo_Round_Trip)
+{
+    FrameInfo wire = makeFrameInfo(2, 3, SatColor::BLUE, 0, CHANNEL_BLUE);
+    FrameInfo host = readFrameInfo(reinterpret_cast<const uint8_t *>(&wire));
+    EXPECT_EQ(host.index, 2);
+    EXPECT_EQ(host.count, 3);
+    EXPECT_EQ(host.color, SatColor::BLUE);
+    EXPECT_EQ(host.planes, CHANNEL_BLUE);
+}
+
+TEST(Protocol, StreamStatus_Round_Trip)
+{
+    StreamStatus wire = makeStreamStatus(120, 7);
+    StreamStatus host = readStreamStatus(reinterpret_cast<const uint8_t *>(&wire));
+    EXPECT_EQ(host.delivered, 120u);
+    EXPECT_EQ(host.dropped, 7u);
+}
+
+TEST(Protocol, ColorMatrix_Round_Trip)
+{
+    ColorMatrix matrix{{{0.299f, 0.587f, 0.114f, 0.0f}, {-0.5f, 1.25f, -7.75f, 16.0f}, {0.0f, 0.0f, 1.0f, -128.5f}}};
+    std::vector<uint8_t> wire;
+    appendColorMatrix(wire, matrix);
+    ASSERT_EQ(wire.size(), COLOR_MATRIX_WIRE_SIZE);
+
+    ColorMatrix decoded = readColorMatrix(wire.data());
+    for (int row = 0; row < 3; row++)
+    {
+        for (int col = 0; col < 4; col++)
+        {
+            EXPECT_NEAR(decoded.m[row][col], matrix.m[row][col], 1.0 / 65536);
+        }
+    }
+}
+
+TEST(Protocol, RegionInfo_Round_Trip)
+{
+    RegionInfo wire = makeRegionInfo(640, 360, 1280, 720, REGION_SCALE_ONE / 4, 3840, 2160);
+    RegionInfo host = readRegionInfo(reinterpret_cast<const uint8_t *>(&wire));
+    EXPECT_EQ(host.x, 640);
+    EXPECT_EQ(host.y, 360);
+    EXPECT_EQ(host.width, 1280);
+    EXPECT_EQ(host.height, 720);
+    EXPECT_EQ(host.scale, REGION_SCALE_ONE / 4);
+    EXPECT_EQ(host.captureWidth, 3840);
+    EXPECT_EQ(host.captureHeight, 2160);
+}
+
+/* Region of Interest */
+TEST(Region, Crops_Clamps_And_Downscales)
+{
+    cv::Mat capture(120, 200, CV_8UC3);
+    cv::randu(capture, cv::Scalar::all(0), cv::Scalar::all(256));
+    cv::Mat crop;
+
+    // Full resolution crops are views of the capture
+    RegionInfo region{20, 10, 50, 40, REGION_SCALE_ONE, 0, 0};
+    ASSERT_TRUE(cropRegion(capture, region, crop));
+    EXPECT_EQ(crop.size(), cv::Size(50, 40));
+    EXPECT_EQ(cv::norm(crop, capture(cv::Rect(20, 10, 50, 40)), cv::NORM_INF), 0);
+    EXPECT_EQ(region.captureWidth, 200);
+    EXPECT_EQ(region.captureHeight, 120);
+
+    // Past the edge or 0 is clamped to the capture
+    region = RegionInfo{150, 100, 100, 0, REGION_SCALE_ONE, 0, 0};
+    ASSERT_TRUE(cropRegion(capture, region, crop));
+    EXPECT_EQ(crop.size(), cv::Size(50, 20));
+    EXPECT_EQ(region.width, 50);
+    EXPECT_EQ(region.height, 20);
+
+    // Thumbnail of the whole capture
+    region = RegionInfo{0, 0, 0, 0, REGION_SCALE_ONE / 4, 0, 0};
+    ASSERT_TRUE(cropRegion(capture, region, crop));
+    EXPECT_EQ(crop.size(), cv::Size(50, 30));
+
+    region = RegionInfo{200, 0, 0, 0, REGION_SCALE_ONE, 0, 0};
+    EXPECT_FALSE(cropRegion(capture, region, crop));
+    region = RegionInfo{0, 0, 0, 0, REGION_SCALE_ONE + 1, 0, 0};
+    EXPECT_FALSE(cropRegion(capture, region, crop));
+}
+
+TEST(Client_setRegion, Input_Validation)
+{
+    Client client;
+    EXPECT_NO_THROW(client.setRegion(0, 0, 640, 480, 0.5));
+    EXPECT_ANY_THROW(client.setRegion(-1, 0));
+    EXPECT_ANY_THROW(client.setRegion(0, 0, 70000, 10));
+    EXPECT_ANY_THROW(client.setRegion(0, 0, 0, 0, 0.0));
+    EXPECT_ANY_THROW(client.setRegion(0, 0, 0, 0, 1.5));
+    EXPECT_EQ(client.getDeliveredRegion().scale, 0);
+}
+
+TEST(Client_parseColors, Subsets_And_Order)
+{
+    EXPECT_EQ(Client::parseColors("rgb"), (std::vector<int>{SatColor::RED, SatColor::GREEN, SatColor::BLUE}));
+    EXPECT_EQ(Client::parseColors("G"), (std::vector<int>{SatColor::GREEN}));
+    EXPECT_EQ(Client::parseColors("bgg"), (std::vector<int>{SatColor::BLUE, SatColor::GREEN, SatColor::GREEN}));
+    EXPECT_ANY_THROW(Client::parseColors(""));
+    EXPECT_ANY_THROW(Client::parseColors("rgx"));
+    EXPECT_ANY_THROW(Client::parseColors(std::string(256, 'r')));
+}
+
+/* Multicast Distribution */
+TEST(Multicast, FEC_Repairs_Single_Loss_Per_Group)
+{
+    std::vector<uint8_t> frame(MCAST_CHUNK_PAYLOAD * 20 + 123);
+    for (size_t i = 0; i < frame.size(); i++)
+    {
+        frame[i] = static_cast<uint8_t>(i * 31 + 7);
+    }
+    std::vector<std::vector<uint8_t>> datagrams = chunkFrame(9, SatColor::GREEN, frame.data(), frame.size(), 8);
+    ASSERT_EQ(datagrams.size(), 21u + 3u); // 21 data chunks, 3 parity chunks
+
+    // Drop the first data chunk of every group, parity rebuilds each of them
+    FrameAssembler assembler;
+    std::vector<uint8_t> out;
+    for (size_t i = 0; i < datagrams.size(); i++)
+    {
+        if (i % 9 != 0)
+        {
+            assembler.accept(datagrams[i].data(), datagrams[i].size());
+        }
+    }
+    EXPECT_TRUE(assembler.isComplete(9));
+    EXPECT_EQ(assembler.getRepaired(), 3u);
+    ASSERT_TRUE(assembler.takeFrame(9, out));
+    EXPECT_EQ(out, frame);
+}
+
+TEST(Multicast, Reports_Missing_Chunks_For_NACK)
+{
+    std::vector<uint8_t> frame(MCAST_CHUNK_PAYLOAD * 4, 0x5A);
+    std::vector<std::vector<uint8_t>> datagrams = chunkFrame(3, SatColor::RED, frame.data(), frame.size(), 0);
+    ASSERT_EQ(datagrams.size(), 4u);
+
+    FrameAssembler assembler;
+    assembler.expect(3, frame.size(), SatColor::RED);
+    assembler.accept(datagrams[0].data(), datagrams[0].size());
+    assembler.accept(datagrams[3].data(), datagrams[3].size());
+    EXPECT_EQ(assembler.missing(3), (std::vector<uint16_t>{1, 2}));
+
+    // Corrupt chunks are rejected by their checksum
+    datagrams[1].back() ^= 0xFF;
+    EXPECT_EQ(assembler.accept(datagrams[1].data(), datagrams[1].size()), FrameAssembler::CHUNK_REJECTED);
+    EXPECT_EQ(assembler.getCorrupt(), 1u);
+
+    // NACK payload survives the round trip
+    uint32_t frameId;
+    std::vector<uint16_t> chunks;
+    std::vector<uint8_t> nack = buildNack(3, assembler.missing(3));
+    ASSERT_TRUE(readNack(nack.data(), nack.size(), frameId, chunks));
+    EXPECT_EQ(frameId, 3u);
+    EXPECT_EQ(chunks, (std::vector<uint16_t>{1, 2}));
+}
+
+/* Image Kernels */
+TEST(ImageKernels, Fused_Matches_Split_Merge)
+{
+    // Odd width exercises the scalar tail after the vector loop
+    cv::Mat input(37, 101, CV_8UC3);
+    cv::randu(input, cv::Scalar::all(0), cv::Scalar::all(256));
+    std::vector<Filter> filters = {Filter(255, 0, 0), Filter(0, 255, 0), Filter(0, 0, 255)};
+
+    for (KernelIsa isa : {ISA_SCALAR, ISA_SSE2, ISA_AVX2})
+    {
+        std::vector<cv::Mat> outputs;
+        ASSERT_TRUE(separateChannels(input, filters, outputs, isa));
+        ASSERT_EQ(outputs.size(), filters.size());
+
+        for (int keep = 0; keep < 3; keep++)
+        {
+            // Red keeps BGR channel 2, blue keeps channel 0
+            std::vector<cv::Mat> channels(3);
+            cv::Mat expected;
+            cv::split(input, channels);
+            for (int c = 0; c < 3; c++)
+            {
+                if (c != 2 - keep)
+                {
+                    channels[c] = cv::Mat::zeros(channels[c].size(), channels[c].type());
+                }
+            }
+            cv::merge(channels, expected);
+            EXPECT_EQ(cv::norm(outputs[keep], expected, cv::NORM_INF), 0) << "isa " << isa << " filter " << keep;
+        }
+    }
+}
+
+TEST(ImageKernels, Rejects_Unsupported_Input)
+{
+    std::vector<cv::Mat> outputs;
+    cv::Mat gray(8, 8, CV_8UC1);
+    EXPECT_FALSE(separateChannels(gray, {Filter(255, 0, 0)}, outputs));
+
+    cv::Mat color(8, 8, CV_8UC3);
+    EXPECT_FALSE(separateChannels(color, {Filter(128, 0, 0)}, outputs));
+}
+
+TEST(ImageKernels, Transform_Matches_Reference)
+{
+    cv::Mat input(23, 101, CV_8UC3);
+    cv::randu(input, cv::Scalar::all(0), cv::Scalar::all(256));
+
+    cv::RNG rng(12);
+    std::vector<ColorMatrix> matrices = {ColorMatrix::identity()};
+    for (int k = 0; k < 4; k++)
+    {
+        ColorMatrix matrix;
+        for (int row = 0; row < 3; row++)
+        {
+            for (int col = 0; col < 3; col++)
+            {
+                matrix.m[row][col] = rng.uniform(-2.0f, 2.0f);
+            }
+            matrix.m[row][3] = rng.uniform(-100.0f, 100.0f);
+        }
+        matrices.push_back(matrix);
+    }
+
+    // Every ISA is bit-identical to the scalar kernel
+    std::vector<cv::Mat> reference;
+    ASSERT_TRUE(transformColors(input, matrices, reference, ISA_SCALAR));
+    for (KernelIsa isa : {ISA_SSE2, ISA_SSE41, ISA_AVX2})
+    {
+        std::vector<cv::Mat> outputs;
+        ASSERT_TRUE(transformColors(input, matrices, outputs, isa));
+        for (size_t k = 0; k < matrices.size(); k++)
+        {
+            EXPECT_EQ(cv::norm(outputs[k], reference[k], cv::NORM_INF), 0) << "isa " << isa << " matrix " << k;
+        }
+    }
+    EXPECT_EQ(cv::norm(reference[0], input, cv::NORM_INF), 0);
+
+    // ... and within a quantization step of the floating point transform
+    for (size_t k = 1; k < matrices.size(); k++)
+    {
+        const ColorMatrix &m = matrices[k];
+        for (int y = 0; y < input.rows; y++)
+        {
+            for (int x = 0; x < input.cols; x++)
+            {
+                cv::Vec3b in = input.at<cv::Vec3b>(y, x);
+                cv::Vec3b out = reference[k].at<cv::Vec3b>(y, x);
+                for (int c = 0; c < 3; c++)
+                {
+                    float value = m.m[c][0] * in[2] + m.m[c][1] * in[1] + m.m[c][2] * in[0] + m.m[c][3];
+                    ASSERT_NEAR(out[2 - c], std::clamp(value, 0.0f, 255.0f), 1.0f) << "matrix " << k << " at " << x << "," << y;
+                }
+            }
+        }
+    }
+}
+
+TEST(ImageKernels, Channel_Matrices_Match_Masks)
+{
+    cv::Mat input(16, 48, CV_8UC3);
+    cv::randu(input, cv::Scalar::all(0), cv::Scalar::all(256));
+
+    std::vector<cv::Mat> masked, transformed;
+    ASSERT_TRUE(separateChannels(input, {Filter(255, 0, 0), Filter(0, 255, 255)}, masked));
+    ASSERT_TRUE(transformColors(input, {ColorMatrix::scale(255, 0, 0), ColorMatrix::scale(0, 255, 255)}, transformed));
+    for (size_t k = 0; k < masked.size(); k++)
+    {
+        EXPECT_EQ(cv::norm(masked[k], transformed[k], cv::NORM_INF), 0);
+    }
+
+    Filter filter;
+    EXPECT_TRUE(asChannelMask(ColorMatrix::scale(0, 255, 255), filter));
+    EXPECT_TRUE(filter == Filter(0, 255, 255));
+    EXPECT_FALSE(asChannelMask(ColorMatrix::scale(128, 0, 0), filter));
+
+    ColorMatrix tooLarge = ColorMatrix::identity();
+    tooLarge.m[0][1] = 9.0f;
+    EXPECT_FALSE(transformColors(input, {tooLarge}, transformed));
+}
+
+TEST(ImageKernels, Planes_Rebuild_Full_Frames)
+{
+    cv::Mat input(19, 67, CV_8UC3);
+    cv::randu(input, cv::Scalar::all(0), cv::Scalar::all(256));
+
+    ColorMatrix luma{{{0.299f, 0.587f, 0.114f, 0.0f}, {0.299f, 0.587f, 0.114f, 0.0f}, {0.299f, 0.587f, 0.114f, 0.0f}}};
+    ColorMatrix band{{{0.0f, 0.0f, 0.0f, 0.0f}, {1.5f, -0.5f, 0.25f, -8.0f}, {0.0f, 0.0f, 0.0f, 0.0f}}};
+    std::vector<ColorMatrix> matrices = {ColorMatrix::scale(255, 0, 0), ColorMatrix::scale(0, 0, 255), luma, band};
+
+    int row;
+    EXPECT_EQ(matrices[0].bandChannels(row), CHANNEL_RED);
+    EXPECT_EQ(matrices[2].bandChannels(row), CHANNEL_RED | CHANNEL_GREEN | CHANNEL_BLUE);
+    EXPECT_EQ(matrices[3].bandChannels(row), CHANNEL_GREEN);
+    EXPECT_EQ(row, 1);
+    EXPECT_EQ(ColorMatrix::scale(255, 255, 0).bandChannels(row), 0);
+
+    std::vector<cv::Mat> frames;
+    ASSERT_TRUE(transformColors(input, matrices, frames, ISA_SCALAR));
+    for (KernelIsa isa : {ISA_SCALAR, ISA_SSE41, ISA_AVX2})
+    {
+        std::vector<cv::Mat> planes;
+        ASSERT_TRUE(extractPlanes(input, matrices, planes, isa));
+        for (size_t k = 0; k < matrices.size(); k++)
+        {
+            ASSERT_EQ(planes[k].type(), CV_8UC1);
+            cv::Mat rebuilt = Client::expandPlane(planes[k], matrices[k].bandChannels(row));
+            EXPECT_EQ(cv::norm(rebuilt, frames[k], cv::NORM_INF), 0) << "isa " << isa << " matrix " << k;
+        }
+    }
+
+    // Red + green + blue views composite back into the capture
+    std::vector<cv::Mat> rgb;
+    ASSERT_TRUE(extractPlanes(input, {ColorMatrix::scale(255, 0, 0), ColorMatrix::scale(0, 255, 0), ColorMatrix::scale(0, 0, 255)}, rgb));
+    cv::Mat view = Client::compositeFrames({Client::expandPlane(rgb[0], CHANNEL_RED), Client::expandPlane(rgb[1], CHANNEL_GREEN),
+                                            Client::expandPlane(rgb[2], CHANNEL_BLUE)});
+    EXPECT_EQ(cv::norm(view, input, cv::NORM_INF), 0);
+
+    EXPECT_FALSE(extractPlanes(input, {ColorMatrix::scale(255, 255, 0)}, rgb));
+}
+
+TEST(ImageKernels, Tiles_Independent_Of_Thread_Count)
+{
+    // Rows wider than a tile are cut, the ROI is not continuous
+    cv::Mat capture(6, 24001, CV_8UC3);
+    cv::randu(capture, cv::Scalar::all(0), cv::Scalar::all(256));
+    cv::Mat input = capture(cv::Rect(1, 0, 24000, 6));
+    ColorMatrix luma{{{0.299f, 0.587f, 0.114f, 0.0f}, {0.299f, 0.587f, 0.114f, 0.0f}, {0.299f, 0.587f, 0.114f, 0.0f}}};
+    std::vector<ColorMatrix> matrices = {luma, ColorMatrix::scale(0, 255, 0)};
+
+    int threads = cv::getNumThreads();
+    std::vector<cv::Mat> serial, serialPlanes;
+    cv::setNumThreads(1);
+    ASSERT_TRUE(transformColors(input, matrices, serial, ISA_SCALAR));
+    ASSERT_TRUE(extractPlanes(input, matrices, serialPlanes, ISA_SCALAR));
+    std::string digest = frameDigest(input);
+    cv::setNumThreads(threads);
+
+    std::vector<cv::Mat> parallel, parallelPlanes;
+    ASSERT_TRUE(transformColors(input, matrices, parallel));
+    ASSERT_TRUE(extractPlanes(input, matrices, parallelPlanes));
+    for (size_t k = 0; k < matrices.size(); k++)
+    {
+        EXPECT_EQ(cv::norm(serial[k], parallel[k], cv::NORM_INF), 0) << "matrix " << k;
+        EXPECT_EQ(cv::norm(serialPlanes[k], parallelPlanes[k], cv::NORM_INF), 0) << "plane " << k;
+    }
+
+    // Digest follows the pixels, not the thread count or the row padding
+    EXPECT_EQ(digest.size(), 32u);
+    EXPECT_EQ(frameDigest(input), digest);
+    cv::Mat copy = input.clone();
+    EXPECT_EQ(frameDigest(copy), digest);
+    copy.at<cv::Vec3b>(5, 23999)[0] ^= 1;
+    EXPECT_NE(frameDigest(copy), digest);
+}
+
+TEST(ImageKernels, Delta_Round_Trip)
+{
+    cv::Mat previous(40, 90, CV_8UC3);
+    cv::randu(previous, cv::Scalar::all(0), cv::Scalar::all(256));
+    cv::Mat current = previous.clone();
+    cv::Mat changed = current(cv::Rect(10, 5, 30, 20));
+    cv::randu(changed, cv::Scalar::all(0), cv::Scalar::all(256));
+
+    // Unchanged pixels cost nothing, the rest is rebuilt exactly
+    cv::Mat residual, rebuilt;
+    ASSERT_TRUE(deltaEncode(current, previous, residual));
+    cv::Mat outside = residual.clone();
+    outside(cv::Rect(10, 5, 30, 20)).setTo(cv::Scalar::all(0));
+    EXPECT_EQ(cv::countNonZero(outside.reshape(1)), 0);
+    ASSERT_TRUE(applyDelta(previous, residual, rebuilt));
+    EXPECT_EQ(cv::norm(rebuilt, current, cv::NORM_INF), 0);
+
+    // Planes and views work the same way, in place
+    cv::Mat plane(previous.size(), CV_8UC1);
+    cv::randu(plane, cv::Scalar::all(0), cv::Scalar::all(256));
+    cv::Mat view = plane(cv::Rect(1, 1, 60, 30));
+    cv::Mat brighter;
+    cv::add(view, cv::Scalar::all(3), brighter);
+    ASSERT_TRUE(deltaEncode(brighter, view, residual));
+    ASSERT_TRUE(applyDelta(view, residual, residual));
+    EXPECT_EQ(cv::norm(residual, brighter, cv::NORM_INF), 0);
+
+    EXPECT_FALSE(deltaEncode(current, plane, residual));
+    EXPECT_FALSE(deltaEncode(current, cv::Mat(), residual));
+}
+
+/* Denoise */
+TEST(Denoise, Modes_Smooth_Noise_And_Keep_Edges)
+{
+    // Two flat halves 130 levels apart, plus noise
+    cv::Mat input(96, 128, CV_32FC3), noise(96, 128, CV_32FC3);
+    input(cv::Rect(0, 0, 64, 96)).setTo(cv::Scalar::all(60));
+    input(cv::Rect(64, 0, 64, 96)).setTo(cv::Scalar::all(190));
+    cv::randn(noise, cv::Scalar::all(0), cv::Scalar::all(8));
+    cv::add(input, noise, input);
+    input.convertTo(input, CV_8UC3);
+
+    cv::Scalar mean, noisy;
+    cv::meanStdDev(input(cv::Rect(8, 8, 48, 80)), mean, noisy);
+
+    for (DenoiseMode mode : {DENOISE_BILATERAL, DENOISE_GRID, DENOISE_GUIDED, DENOISE_PYRAMID})
+    {
+        cv::Mat output;
+        ASSERT_TRUE(denoiseFrame(input, output, mode)) << denoiseName(mode);
+        ASSERT_EQ(output.size(), input.size());
+        ASSERT_EQ(output.type(), CV_8UC3);
+
+        cv::Scalar left, right, leftDev, rightDev;
+        cv::meanStdDev(output(cv::Rect(8, 8, 48, 80)), left, leftDev);
+        cv::meanStdDev(output(cv::Rect(72, 8, 48, 80)), right, rightDev);
+        EXPECT_LT(leftDev[1], noisy[1] / 2) << denoiseName(mode);
+        EXPECT_NEAR(left[1], 60, 6) << denoiseName(mode);
+        EXPECT_NEAR(right[1], 190, 6) << denoiseName(mode);
+    }
+}
+
+TEST(Denoise, None_Passes_Through)
+{
+    cv::Mat input(8, 8, CV_8UC3), output;
+    cv::randu(input, cv::Scalar::all(0), cv::Scalar::all(256));
+    ASSERT_TRUE(denoiseFrame(input, output, DENOISE_NONE));
+    EXPECT_EQ(cv::norm(output, input, cv::NORM_INF), 0);
+
+    cv::Mat gray(8, 8, CV_8UC1);
+    EXPECT_FALSE(denoiseFrame(gray, output, DENOISE_GRID));
+    EXPECT_FALSE(denoiseFrame(input, output, DENOISE_MODES));
+}
+
+TEST(Denoise, Mode_Names_Round_Trip)
+{
+    for (int i = 0; i < DENOISE_MODES; i++)
+    {
+        DenoiseMode mode;
+        ASSERT_TRUE(parseDenoiseMode(denoiseName(static_cast<DenoiseMode>(i)), mode));
+        EXPECT_EQ(mode, i);
+    }
+    DenoiseMode mode;
+    EXPECT_FALSE(parseDenoiseMode("median", mode));
+}
+
+/* Buffer Pool */
+TEST(BufferPool, Recycles_Buffers_By_Size)
+{
+    BufferPool pool;
+    const uint8_t *first;
+    {
+        cv::Mat frame = pool.acquire(cv::Size(64, 48), CV_8UC3);
+        cv::Mat shared = frame;
+        first = frame.data;
+    }
+    BufferStats stats = pool.getStats();
+    EXPECT_EQ(stats.misses, 1u);
+    EXPECT_EQ(stats.bytesInUse, 0u);
+    EXPECT_EQ(stats.bytesIdle, 64u * 48 * 3);
+
+    // Any OpenCV output of the same footprint reuses the buffer, other sizes allocate
+    cv::Mat input(48, 64, CV_8UC3, cv::Scalar(1, 2, 3));
+    cv::Mat copy = pool.acquire();
+    input.copyTo(copy);
+    EXPECT_EQ(copy.data, first);
+    EXPECT_EQ(cv::norm(copy, input, cv::NORM_INF), 0);
+    cv::Mat other = pool.acquire(cv::Size(16, 16), CV_8UC1);
+    stats = pool.getStats();
+    EXPECT_EQ(stats.hits, 1u);
+    EXPECT_EQ(stats.misses, 2u);
+    EXPECT_EQ(stats.bytesInUse, 64u * 48 * 3 + 16 * 16);
+    EXPECT_EQ(stats.peakBytes, 64u * 48 * 3 + 16 * 16);
+
+    // Byte buffers come back empty with their capacity
+    const uint8_t *bytes;
+    {
+        std::shared_ptr<std::vector<uint8_t>> buffer = pool.acquireBytes(1000);
+        buffer->resize(10);
+        bytes = buffer->data();
+    }
+    std::shared_ptr<std::vector<uint8_t>> again = pool.acquireBytes(500);
+    EXPECT_TRUE(again->empty());
+    EXPECT_GE(again->capacity(), 1000u);
+    EXPECT_EQ(again->data(), bytes);
+}
+
+TEST(BufferPool, Evicts_Oldest_Beyond_Idle_Limit)
+{
+    BufferPool pool(1000);
+    pool.acquire(cv::Size(20, 20), CV_8UC1); // 400 bytes, returned first
+    pool.acquire(cv::Size(30, 10), CV_8UC1);
+    pool.acquire(cv::Size(50, 10), CV_8UC1);
+    BufferStats stats = pool.getStats();
+    EXPECT_EQ(stats.evicted, 1u);
+    EXPECT_EQ(stats.bytesIdle, 800u);
+
+    pool.acquire(cv::Size(20, 20), CV_8UC1);
+    EXPECT_EQ(pool.getStats().hits, 0u);
+    pool.trim();
+    EXPECT_EQ(pool.getStats().bytesIdle, 0u);
+}
+
+TEST(BufferPool, Denoise_Scratch_Matches_Default)
+{
+    BufferPool pool;
+    cv::Mat input(64, 80, CV_8UC3);
+    cv::randu(input, cv::Scalar::all(0), cv::Scalar::all(256));
+    for (DenoiseMode mode : {DENOISE_GRID, DENOISE_GUIDED, DENOISE_PYRAMID})
+    {
+        cv::Mat expected, output = pool.acquire();
+        ASSERT_TRUE(denoiseFrame(input, expected, mode));
+        ASSERT_TRUE(denoiseFrame(input, output, mode, &pool));
+        EXPECT_EQ(cv::norm(output, expected, cv::NORM_INF), 0) << denoiseName(mode);
+    }
+
+    // Second pass runs on recycled buffers only
+    uint64_t misses = pool.getStats().misses;
+    for (DenoiseMode mode : {DENOISE_GRID, DENOISE_GUIDED, DENOISE_PYRAMID})
+    {
+        cv::Mat output = pool.acquire();
+        ASSERT_TRUE(denoiseFrame(input, output, mode, &pool));
+    }
+    EXPECT_EQ(pool.getStats().misses, misses);
+}
+
+/* V4L2 Capture */
+TEST(V4l2Capture, Parses_Sources)
+{
+    std::string path;
+    CaptureFormat format;
+    ASSERT_TRUE(parseCaptureSource("/dev/video2", path, format));
+    EXPECT_EQ(path, "/dev/video2");
+    EXPECT_EQ(format.pixelFormat, static_cast<uint32_t>(V4L2_DEFAULT_FORMAT));
+    EXPECT_EQ(format.width, V4L2_DEFAULT_WIDTH);
+
+    ASSERT_TRUE(parseCaptureSource("/dev/video0:nv12:1280x720", path, format));
+    EXPECT_EQ(format.pixelFormat, static_cast<uint32_t>(V4L2_PIX_FMT_NV12));
+    EXPECT_EQ(format.width, 1280);
+    EXPECT_EQ(format.height, 720);
+    EXPECT_EQ(pixelFormatName(format.pixelFormat), "NV12");
+    ASSERT_TRUE(parseCaptureSource("/dev/video0:MJPG", path, format));
+    EXPECT_EQ(format.pixelFormat, static_cast<uint32_t>(V4L2_PIX_FMT_MJPEG));
+
+    EXPECT_FALSE(parseCaptureSource("", path, format));
+    EXPECT_FALSE(parseCaptureSource("/dev/video0:RGB3", path, format));
+    EXPECT_FALSE(parseCaptureSource("/dev/video0:YUYV:640", path, format));
+    EXPECT_FALSE(parseCaptureSource("/dev/video0:YUYV:640x480p", path, format));
+}
+
+TEST(V4l2Capture, Region_Conversion_Matches_Full_Frame)
+{
+    const int width = 64, height = 48;
+    cv::Mat yuyv(height, width, CV_8UC2), nv12(height * 3 / 2, width, CV_8UC1);
+    cv::randu(yuyv, cv::Scalar::all(0), cv::Scalar::all(256));
+    cv::randu(nv12, cv::Scalar::all(0), cv::Scalar::all(256));
+
+    for (auto [raw, pixelFormat] : {std::pair(yuyv, V4L2_PIX_FMT_YUYV), std::pair(nv12, V4L2_PIX_FMT_NV12)})
+    {
+        CaptureFormat format{static_cast<uint32_t>(pixelFormat), width, height, static_cast<size_t>(raw.step)};
+        cv::Mat full, region;
+        ASSERT_TRUE(convertCapture(raw, format, cv::Rect(), full));
+        EXPECT_EQ(full.size(), cv::Size(width, height));
+        EXPECT_EQ(full.type(), CV_8UC3);
+
+        // Odd origins and sizes still convert exactly the pixels of the full frame
+        for (cv::Rect roi : {cv::Rect(0, 0, width, height), cv::Rect(5, 3, 17, 11), cv::Rect(10, 20, 1, 1), cv::Rect(33, 0, 31, 48)})
+        {
+            ASSERT_TRUE(convertCapture(raw, format, roi, region));
+            EXPECT_EQ(region.size(), roi.size());
+            EXPECT_EQ(cv::norm(region, full(roi), cv::NORM_INF), 0) << pixelFormatName(pixelFormat);
+        }
+        EXPECT_FALSE(convertCapture(raw, format, cv::Rect(60, 0, 8, 8), region));
+    }
+    CaptureFormat unsupported{V4L2_PIX_FMT_RGB24, width, height, 0};
+    cv::Mat output;
+    EXPECT_FALSE(convertCapture(yuyv, unsupported, cv::Rect(), output));
+}
+
+TEST(V4l2Capture, Streams_From_Vivid)
+{
+    // Needs the virtual test driver: modprobe vivid
+    std::string path = V4l2Device::findDevice("vivid");
+    if (path.empty())
+    {
+        GTEST_SKIP() << "vivid is not loaded";
+    }
+
+    CameraCapture capture;
+    capture.setSource(path, CaptureFormat{V4L2_PIX_FMT_YUYV, 640, 480, 0});
+    ASSERT_TRUE(capture.start());
+    cv::Size size = capture.getFrameSize();
+    EXPECT_EQ(size, cv::Size(capture.getFormat().width, capture.getFormat().height));
+
+    cv::Mat frame, region;
+    uint64_t generation = capture.latestFrame(frame);
+    ASSERT_GT(generation, 0u);
+    EXPECT_EQ(frame.size(), size);
+    EXPECT_EQ(frame.type(), CV_8UC3);
+
+    // Buffers cycle back to the driver while frames keep coming
+    for (int i = 0; i < 10; i++)
+    {
+        uint64_t next = capture.waitNextFrame(generation, region, std::chrono::milliseconds(1000), cv::Rect(3, 5, 101, 49));
+        ASSERT_GT(next, generation);
+        EXPECT_EQ(region.size(), cv::Size(101, 49));
+        generation = next;
+    }
+    capture.stop();
+    EXPECT_FALSE(capture.isOpened());
+}
+
+/* Worker Pool */
+TEST(WorkerPool, Runs_All_Jobs)
+{
+    std::atomic<int> count(0);
+    {
+        WorkerPool pool(4, 1000, BLOCK_WHEN_FULL);
+        for (int i = 0; i < 500; i++)
+        {
+            EXPECT_TRUE(pool.submit([&count]() { count++; }));
+        }
+        pool.shutdown();
+        EXPECT_EQ(pool.getStats().completed, 500);
+    }
+    EXPECT_EQ(count.load(), 500);
+}
+
+TEST(WorkerPool, Rejects_When_Full)
+{
+    std::mutex gate;
+    gate.lock();
+    WorkerPool pool(1, 2, REJECT_WHEN_FULL);
+
+    // First job occupies the only worker, next two fill the queue
+    EXPECT_TRUE(pool.submit([&gate]() { std::lock_guard<std::mutex> hold(gate); }));
+    while (pool.getStats().queueDepth != 0)
+    {
+        std::this_thread::yield();
+    }
+    EXPECT_TRUE(pool.submit([]() {}));
+    EXPECT_TRUE(pool.submit([]() {}));
+    EXPECT_FALSE(pool.submit([]() {}));
+
+    PoolStats stats = pool.getStats();
+    EXPECT_EQ(stats.rejected, 1);
+    EXPECT_EQ(stats.queueDepth, 2);
+    gate.unlock();
+}
+
+TEST(WorkerPool, Rejects_After_Shutdown)
+{
+    WorkerPool pool(2);
+    pool.shutdown();
+    EXPECT_FALSE(pool.submit([]() {}));
+}
+
+/* Single-Flight Request Coalescing */
+TEST(SingleFlight, Coalesces_Concurrent_Joins)
+{
+    SingleFlight<int, std::string> flight;
+    std::vector<std::string> results;
+
+    EXPECT_TRUE(flight.join(7, [&results](const std::string &val) { results.push_back(val); }));
+    EXPECT_FALSE(flight.join(7, [&results](const std::string &val) { results.push_back(val); }));
+    EXPECT_FALSE(flight.join(7, [&results](const std::string &val) { results.push_back(val); }));
+    EXPECT_TRUE(flight.join(8, [](const std::string &) {}));
+
+    EXPECT_EQ(flight.complete(7, "frame"), 3);
+    EXPECT_EQ(results, std::vector<std::string>({"frame", "frame", "frame"}));
+    EXPECT_EQ(flight.getFlights(), 2);
+    EXPECT_EQ(flight.getCoalesced(), 2);
+
+    // Flight has landed, the next join leads a new one
+    EXPECT_TRUE(flight.join(7, [](const std::string &) {}));
+    EXPECT_EQ(flight.complete(9, "none"), 0);
+}
+
 /* Utility Functions */
 std::string convertHashToString(const uint8_t *digest)
 {